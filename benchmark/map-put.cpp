@@ -7,36 +7,49 @@
 
 #include <rbs/rbs.hpp>
 
+#include <hz_client/capture.hpp>
 #include <hz_client/connection.hpp>
 #include <hz_client/message/ping.hpp>
+#include <hz_client/pipeline.hpp>
 
 std::string map_name = "map";
 
 static constexpr int MIN_CONCURRENT_INVOCATIONS = 50000;
-std::atomic<int> n_concurrent_invocations = 0;
 std::atomic<int> n_executed = 0;
 
-void benchmark(std::shared_ptr<hz_client::connection> connection)
+using map_put_pipeline = hz_client::pipeline<hz_client::message::map_put>;
+
+std::unique_ptr<map_put_pipeline> pipeline;
+std::unique_ptr<hz_client::capture_writer> capture;
+
+hz_client::message::request<hz_client::message::map_put>
+random_put(const hz_client::connection& connection)
 {
-    while (n_concurrent_invocations < MIN_CONCURRENT_INVOCATIONS)
-    {
-        connection->invoke(
-            hz_client::message::request<hz_client::message::map_put>{ {}, { map_name, rand() % 50000, rand() % 50000 } },
-            [connection, start = std::chrono::steady_clock::now()](const boost::system::error_code& code, std::vector<char>)
-            {
-                n_concurrent_invocations--;
-                n_executed++;
+    hz_client::message::request<hz_client::message::map_put> req { {}, { map_name, rand() % 50000, rand() % 50000 } };
 
-                using namespace std::chrono;
+    req.header.partition_id = hz_client::message::partition_id(
+        req.entity.key,
+        connection.partition_count()
+    );
+
+    return req;
+}
 
-                auto elapsed = steady_clock::now() - start;
+void benchmark(std::shared_ptr<hz_client::connection> connection)
+{
+    pipeline = std::make_unique<map_put_pipeline>(
+        *connection,
+        MIN_CONCURRENT_INVOCATIONS,
+        [connection](std::size_t, const boost::system::error_code& code, std::vector<char>)
+        {
+            n_executed++;
 
-                benchmark(connection);
-            }
-        );
+            pipeline->add(random_put(*connection));
+        }
+    );
 
-        n_concurrent_invocations++;
-    }
+    for (int i = 0; i < MIN_CONCURRENT_INVOCATIONS; ++i)
+        pipeline->add(random_put(*connection));
 }
 
 void connect(boost::asio::io_context& ctx)
@@ -45,6 +58,12 @@ void connect(boost::asio::io_context& ctx)
 
     auto conn = std::make_shared<hz_client::connection>(ctx);
 
+    if (auto path = std::getenv("CAPTURE_FILE"))
+    {
+        capture = std::make_unique<hz_client::capture_writer>(path);
+        conn->set_capture(capture.get());
+    }
+
     conn->async_connect(
         endpoint
         {
@@ -87,7 +106,7 @@ void print_speed(
     boost::asio::steady_timer& timer
 )
 {
-    std::cout << "Ongoing invocations : " << n_concurrent_invocations
+    std::cout << "Ongoing invocations : " << (pipeline ? pipeline->in_flight() : 0)
               << " IPS :" << n_executed
               << std::endl;
 
@@ -0,0 +1,285 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/endian/conversion.hpp>
+
+#include <rbs/rbs.hpp>
+
+#include <hz_client/capture.hpp>
+#include <hz_client/connection.hpp>
+#include <hz_client/pipeline.hpp>
+#include <hz_client/message/raw_message.hpp>
+#include <hz_client/message/response.hpp>
+
+// Replays a capture recorded with `connection::set_capture` at full speed.
+// Every captured request is sent again through a connection to an in
+// process stand-in member, which answers it with the response captured for
+// it. The responses therefore go through the same framing, dispatch and
+// decoding as they did when they were recorded.
+
+using raw_pipeline = hz_client::pipeline<hz_client::message::raw_message>;
+
+struct exchange
+{
+    std::vector<char> request;
+    std::vector<char> response;
+};
+
+std::vector<exchange> load(const std::string& path)
+{
+    hz_client::capture_reader reader {path};
+    hz_client::capture_record record;
+
+    std::vector<exchange>                          exchanges;
+    std::unordered_map<std::uint64_t, std::size_t> awaiting;
+
+    while (reader.next(record))
+    {
+        auto correlation_id = hz_client::message::read_correlation_id(record.message);
+
+        if (record.direction == hz_client::capture_direction::outgoing)
+        {
+            awaiting[correlation_id] = exchanges.size();
+            exchanges.push_back({std::move(record.message), {}});
+
+            continue;
+        }
+
+        auto it = awaiting.find(correlation_id);
+
+        if (it == end(awaiting))
+            continue;
+
+        exchanges[it->second].response = std::move(record.message);
+        awaiting.erase(it);
+    }
+
+    std::erase_if(
+        exchanges,
+        [](const exchange& x) { return x.response.empty(); }
+    );
+
+    return exchanges;
+}
+
+void write_correlation_id(std::vector<char>& message, std::uint64_t id)
+{
+    static constexpr std::size_t CORRELATION_ID_OFFSET = 10;
+
+    boost::endian::native_to_little_inplace(id);
+
+    std::memcpy(message.data() + CORRELATION_ID_OFFSET, &id, sizeof(id));
+}
+
+template<typename T>
+bool decode_as(const std::vector<char>& message)
+{
+    hz_client::message::response<T> res;
+
+    return !hz_client::message::decode_response(message, res);
+}
+
+// Decodes the responses of the messages the client has codecs for, the
+// others only go through the framing and the dispatch.
+bool decode(const std::vector<char>& message)
+{
+    using namespace hz_client::message;
+
+    frame_reader reader {message};
+
+    if (!reader.has_next() || reader.peek().size < RESPONSE_FIXED_OFFSET)
+        return false;
+
+    switch (read_fixed<std::int32_t>(reader.peek(), RESPONSE_TYPE_OFFSET))
+    {
+        case 65793:
+            return decode_as<map_put>(message);
+        case 66049:
+            return decode_as<map_get>(message);
+        case 77313:
+            return decode_as<execute_on_key>(message);
+        case 79617:
+            return decode_as<fetch_keys>(message);
+        case 79873:
+            return decode_as<fetch_entries>(message);
+        default:
+            return true;
+    }
+}
+
+// Answers the k-th request it receives with the k-th captured response.
+class stand_in_member
+{
+public:
+
+    stand_in_member(
+        boost::asio::ip::tcp::socket sck,
+        const std::vector<exchange>& exchanges
+    )
+        :   m_sck {std::move(sck)}
+        ,   m_exchanges {exchanges}
+    {}
+
+    void run()
+    {
+        char protocol[3];
+
+        boost::asio::read(m_sck, boost::asio::buffer(protocol));
+
+        std::vector<char> received;
+        std::vector<char> responses;
+        std::size_t       message_begin {0};
+        std::size_t       next {0};
+        char              chunk[1 << 16];
+
+        boost::system::error_code err;
+
+        while (next < m_exchanges.size())
+        {
+            auto n = m_sck.read_some(boost::asio::buffer(chunk), err);
+
+            if (err)
+                return;
+
+            received.insert(end(received), chunk, chunk + n);
+
+            std::size_t pos {message_begin};
+
+            while (received.size() - pos >= hz_client::message::frame_header::HEADER_SIZE)
+            {
+                std::int32_t  length;
+                std::uint16_t flags;
+
+                std::memcpy(&length, received.data() + pos, sizeof(length));
+                std::memcpy(&flags, received.data() + pos + 4, sizeof(flags));
+
+                boost::endian::little_to_native_inplace(length);
+                boost::endian::little_to_native_inplace(flags);
+
+                if (received.size() - pos < std::size_t(length))
+                    break;
+
+                pos += length;
+
+                if (!(flags & hz_client::message::frame_header::IS_FINAL_FLAG))
+                    continue;
+
+                std::vector<char> request {
+                    received.begin() + message_begin,
+                    received.begin() + pos
+                };
+
+                auto response = m_exchanges[next++].response;
+
+                write_correlation_id(response, hz_client::message::read_correlation_id(request));
+                responses.insert(end(responses), response.begin(), response.end());
+
+                message_begin = pos;
+            }
+
+            received.erase(received.begin(), received.begin() + message_begin);
+            message_begin = 0;
+
+            boost::asio::write(m_sck, boost::asio::buffer(responses));
+            responses.clear();
+        }
+    }
+
+private:
+
+    boost::asio::ip::tcp::socket m_sck;
+    const std::vector<exchange>& m_exchanges;
+};
+
+int main(int argc, char** argv)
+{
+    using namespace std::chrono;
+    using boost::asio::ip::tcp;
+
+    if (argc < 2)
+    {
+        std::cerr << "Usage: replay <capture file> [pipeline depth]" << std::endl;
+
+        return 1;
+    }
+
+    auto exchanges = load(argv[1]);
+    auto depth     = argc > 2 ? std::stoul(argv[2]) : 1000;
+
+    std::cout << "Replaying " << exchanges.size() << " invocations." << std::endl;
+
+    if (exchanges.empty())
+        return 0;
+
+    boost::asio::io_context member_ctx;
+    tcp::acceptor           acceptor {member_ctx, {boost::asio::ip::address_v4::loopback(), 0}};
+
+    std::thread member {
+        [&]
+        {
+            stand_in_member {acceptor.accept(), exchanges}.run();
+        }
+    };
+
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    std::size_t n_completed {0};
+    std::size_t n_failed {0};
+    std::size_t n_bytes {0};
+
+    std::unique_ptr<raw_pipeline> pipeline;
+    steady_clock::time_point      started;
+
+    conn.async_connect(
+        acceptor.local_endpoint(),
+        [&](const boost::system::error_code& err)
+        {
+            if (err)
+            {
+                std::cerr << "Could not connect to the stand-in member." << std::endl;
+
+                return;
+            }
+
+            pipeline = std::make_unique<raw_pipeline>(
+                conn,
+                depth,
+                [&](std::size_t, const boost::system::error_code& err, std::vector<char> response)
+                {
+                    ++n_completed;
+                    n_bytes += response.size();
+
+                    if (err || !decode(response))
+                        ++n_failed;
+
+                    if (n_completed == exchanges.size())
+                        conn.close();
+                }
+            );
+
+            started = steady_clock::now();
+
+            for (const auto& x : exchanges)
+                pipeline->add({{}, {x.request}});
+        }
+    );
+
+    ctx.run();
+    member.join();
+
+    auto elapsed = duration_cast<duration<double>>(steady_clock::now() - started).count();
+
+    std::cout << "Completed " << n_completed << " invocations (" << n_failed << " failed) in "
+              << elapsed << " s, "
+              << n_completed / elapsed << " invocations/s, "
+              << n_bytes / elapsed / (1 << 20) << " MiB/s of responses."
+              << std::endl;
+}
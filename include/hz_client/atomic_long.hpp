@@ -0,0 +1,221 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/message/atomic_long.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+// A linearizable counter of the CP subsystem. Its CP group is resolved by
+// the first invocation, those made meanwhile waiting for it, and kept from
+// then on. Every operation is a round trip; where only the sum of many
+// increments matters, `pn_counter` batches them locally instead.
+//
+// To be used from the thread running the io_context, and to outlive the
+// invocations it makes.
+class atomic_long
+{
+    using error_code = boost::system::error_code;
+
+public:
+
+    inline atomic_long(connection& conn, std::string name);
+
+    inline const std::string& name() const;
+
+    template<typename CompletionToken>
+    auto async_add_and_get(std::int64_t delta, CompletionToken&& token);
+
+    template<typename CompletionToken>
+    auto async_get(CompletionToken&& token);
+
+private:
+
+    using group_waiter_t = std::function<void(error_code)>;
+
+    template<typename Result, typename T, typename Make, typename CompletionToken>
+    auto invoke_in_group(Make make, CompletionToken&& token);
+
+    template<typename CompletionToken>
+    auto async_resolve_group(CompletionToken&& token);
+
+    inline void on_group_resolved(error_code err, std::vector<char>& response);
+
+    // The name of the structure within its group, i.e. without `@group`.
+    static inline std::string object_name(const std::string& proxy_name);
+
+    connection&                           m_conn;
+    std::string                           m_name;
+    std::optional<message::raft_group_id> m_group;
+    std::vector<group_waiter_t>           m_group_waiters;
+};
+
+inline atomic_long::atomic_long(connection& conn, std::string name)
+    :   m_conn {conn}
+    ,   m_name {std::move(name)}
+{}
+
+inline const std::string& atomic_long::name() const
+{
+    return m_name;
+}
+
+template<typename CompletionToken>
+auto atomic_long::async_add_and_get(std::int64_t delta, CompletionToken&& token)
+{
+    return invoke_in_group<std::int64_t, message::atomic_long_add_and_get>(
+        [this, delta](const message::raft_group_id& group)
+        {
+            return message::atomic_long_add_and_get {delta, group, object_name(m_name)};
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto atomic_long::async_get(CompletionToken&& token)
+{
+    return invoke_in_group<std::int64_t, message::atomic_long_get>(
+        [this](const message::raft_group_id& group)
+        {
+            return message::atomic_long_get {group, object_name(m_name)};
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename Result, typename T, typename Make, typename CompletionToken>
+auto atomic_long::invoke_in_group(Make make, CompletionToken&& token)
+{
+    enum {starting, group_resolving, response_awaiting};
+
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code, Result)
+    >(
+        [
+            this,
+            make  = std::move(make),
+            state = starting
+        ]
+        (
+            auto& composable,
+            const error_code& error = {},
+            std::vector<char> response = {}
+        ) mutable
+        {
+            if (!error)
+            {
+                switch (state)
+                {
+                    case starting:
+                    {
+                        if (!m_group)
+                        {
+                            state = group_resolving;
+
+                            return async_resolve_group(std::move(composable));
+                        }
+
+                        [[fallthrough]];
+                    }
+                    case group_resolving:
+                    {
+                        state = response_awaiting;
+
+                        message::request<T> req;
+
+                        req.entity = make(*m_group);
+
+                        m_conn.invoke(std::move(req), std::move(composable));
+
+                        return;
+                    }
+                    case response_awaiting:
+                    {
+                        message::response<T> res;
+
+                        if (auto ec = message::decode_response(response, res))
+                            return composable.complete(ec, Result {});
+
+                        return composable.complete(error, res.value);
+                    }
+                }
+            }
+
+            composable.complete(error, Result {});
+        },
+        token
+    );
+}
+
+template<typename CompletionToken>
+auto atomic_long::async_resolve_group(CompletionToken&& token)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code)
+    >(
+        [this](auto& composable) mutable
+        {
+            m_group_waiters.push_back(
+                make_shallow_copyable(
+                    [composable = std::move(composable)](error_code err) mutable
+                    {
+                        composable.complete(err);
+                    }
+                )
+            );
+
+            if (m_group_waiters.size() > 1)
+                return;
+
+            message::request<message::create_cp_group> req;
+
+            req.entity = {m_name};
+
+            m_conn.invoke(
+                std::move(req),
+                [this](error_code err, std::vector<char> response)
+                {
+                    on_group_resolved(err, response);
+                }
+            );
+        },
+        token
+    );
+}
+
+inline void atomic_long::on_group_resolved(error_code err, std::vector<char>& response)
+{
+    message::response<message::create_cp_group> res;
+
+    if (!err)
+        err = message::decode_response(response, res);
+
+    if (!err)
+        m_group = std::move(res.group_id);
+
+    auto waiters = std::exchange(m_group_waiters, {});
+
+    for (auto& waiter : waiters)
+        waiter(err);
+}
+
+inline std::string atomic_long::object_name(const std::string& proxy_name)
+{
+    return proxy_name.substr(0, proxy_name.find('@'));
+}
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+#include <optional>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/system/error_code.hpp>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace hz_client
+{
+
+// Trades a core for latency: instead of sleeping in the reactor until the
+// kernel wakes it up, the thread keeps polling the io_context, so that a
+// response is handled as soon as it is readable.
+//
+// While handlers keep coming the thread spins. Once none has run for
+// `spin_for` it yields its time slice between polls, and once none has run
+// for `yield_for` as well it parks, blocking in the reactor for at most
+// `park_for` at a time, until the next handler runs.
+struct busy_poll_options
+{
+    // Core the polling thread is pinned to. Linux only.
+    std::optional<int> cpu;
+
+    std::chrono::microseconds spin_for {std::chrono::milliseconds {10}};
+    std::chrono::microseconds yield_for {std::chrono::milliseconds {100}};
+    std::chrono::microseconds park_for {std::chrono::milliseconds {1}};
+};
+
+// Pins the calling thread to `cpu`.
+inline boost::system::error_code pin_thread(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if (auto err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        return {err, boost::system::system_category()};
+
+    return {};
+#else
+    (void)cpu;
+
+    return make_error_code(boost::system::errc::not_supported);
+#endif
+}
+
+// Runs `ctx` on the calling thread the way `busy_poll_options` describes,
+// until it is stopped or runs out of work like `io_context::run` does.
+// Fails without running anything if the thread cannot be pinned.
+inline boost::system::error_code run_busy_polling(
+    boost::asio::io_context& ctx,
+    const busy_poll_options& options = {}
+)
+{
+    using clock = std::chrono::steady_clock;
+
+    if (options.cpu)
+    {
+        if (auto err = pin_thread(*options.cpu))
+            return err;
+    }
+
+    auto last_handler = clock::now();
+
+    while (!ctx.stopped())
+    {
+        if (ctx.poll() > 0)
+        {
+            last_handler = clock::now();
+
+            continue;
+        }
+
+        auto idle = clock::now() - last_handler;
+
+        if (idle < options.spin_for)
+            continue;
+
+        if (idle < options.spin_for + options.yield_for)
+        {
+            std::this_thread::yield();
+
+            continue;
+        }
+
+        if (ctx.run_one_for(options.park_for) > 0)
+            last_handler = clock::now();
+    }
+
+    return {};
+}
+
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+#include <boost/endian/conversion.hpp>
+
+namespace hz_client
+{
+
+// A capture file starts with `CAPTURE_MAGIC` followed by the records, each
+// one laid out as
+//
+//   direction (1) | timestamp in ns since epoch (8) | length (4) | message
+//
+// with the integers in little endian. A message is a complete client
+// protocol message, all of its frames included.
+static inline constexpr char        CAPTURE_MAGIC[8] = {'H', 'Z', 'C', 'A', 'P', '0', '0', '1'};
+static inline constexpr std::size_t CAPTURE_RECORD_HEADER_SIZE = 13;
+
+enum class capture_direction : std::uint8_t
+{
+    outgoing = 0,
+    incoming = 1
+};
+
+struct capture_record
+{
+    capture_direction direction {capture_direction::outgoing};
+    std::uint64_t     timestamp {0};
+    std::vector<char> message;
+};
+
+// Records messages into a capture file. `record` only copies the message
+// into a ring buffer, which a background thread writes out to the file; a
+// message which does not fit into the ring is dropped and counted rather
+// than waited for. `record` must always be called from the same thread,
+// e.g. the one running the connection it is attached to.
+class capture_writer
+{
+public:
+
+    explicit capture_writer(const std::string& path, std::size_t ring_capacity = 1 << 22);
+    ~capture_writer();
+
+    capture_writer(const capture_writer&) = delete;
+    capture_writer& operator=(const capture_writer&) = delete;
+
+    void record(capture_direction direction, const char* message, std::size_t size);
+
+    std::uint64_t dropped() const;
+
+private:
+
+    void put(const char* x, std::size_t n, std::uint64_t at);
+    void run();
+
+    std::FILE*                 m_file;
+    std::size_t                m_mask;
+    std::unique_ptr<char[]>    m_ring;
+    alignas(64) std::atomic<std::uint64_t> m_head;
+    alignas(64) std::atomic<std::uint64_t> m_tail;
+    std::atomic<std::uint64_t> m_dropped;
+    std::atomic<bool>          m_stopping;
+    std::thread                m_thread;
+};
+
+class capture_reader
+{
+public:
+
+    explicit capture_reader(const std::string& path);
+    ~capture_reader();
+
+    capture_reader(const capture_reader&) = delete;
+    capture_reader& operator=(const capture_reader&) = delete;
+
+    // Returns false at the end of the file or at a truncated record.
+    bool next(capture_record& x);
+
+private:
+
+    std::FILE* m_file;
+};
+
+inline capture_writer::capture_writer(const std::string& path, std::size_t ring_capacity)
+    :   m_file {std::fopen(path.c_str(), "wb")}
+    ,   m_mask {0}
+    ,   m_head {0}
+    ,   m_tail {0}
+    ,   m_dropped {0}
+    ,   m_stopping {false}
+{
+    if (!m_file)
+        throw std::runtime_error {"Capture file " + path + " could not be opened."};
+
+    std::size_t capacity {64};
+
+    while (capacity < ring_capacity)
+        capacity <<= 1;
+
+    m_mask = capacity - 1;
+    m_ring.reset(new char[capacity]);
+
+    std::fwrite(CAPTURE_MAGIC, 1, sizeof(CAPTURE_MAGIC), m_file);
+
+    m_thread = std::thread {[this] { run(); }};
+}
+
+inline capture_writer::~capture_writer()
+{
+    m_stopping.store(true);
+    m_thread.join();
+
+    std::fclose(m_file);
+}
+
+inline void capture_writer::record(
+    capture_direction direction,
+    const char* message,
+    std::size_t size
+)
+{
+    auto head  = m_head.load(std::memory_order_relaxed);
+    auto tail  = m_tail.load(std::memory_order_acquire);
+    auto total = CAPTURE_RECORD_HEADER_SIZE + size;
+
+    if (total > m_mask + 1 - (head - tail))
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+
+        return;
+    }
+
+    std::uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+
+    auto length = boost::endian::native_to_little(std::uint32_t(size));
+
+    boost::endian::native_to_little_inplace(timestamp);
+
+    char header[CAPTURE_RECORD_HEADER_SIZE];
+
+    header[0] = char(direction);
+    std::memcpy(header + 1, &timestamp, sizeof(timestamp));
+    std::memcpy(header + 9, &length, sizeof(length));
+
+    put(header, sizeof(header), head);
+    put(message, size, head + sizeof(header));
+
+    m_head.store(head + total, std::memory_order_release);
+}
+
+inline std::uint64_t capture_writer::dropped() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+inline void capture_writer::put(const char* x, std::size_t n, std::uint64_t at)
+{
+    auto offset = at & m_mask;
+    auto first  = std::min(n, m_mask + 1 - offset);
+
+    std::memcpy(m_ring.get() + offset, x, first);
+    std::memcpy(m_ring.get(), x + first, n - first);
+}
+
+inline void capture_writer::run()
+{
+    for (;;)
+    {
+        // Read before the head, so nothing recorded before stopping is lost.
+        auto stopping = m_stopping.load();
+        auto tail     = m_tail.load(std::memory_order_relaxed);
+        auto head     = m_head.load(std::memory_order_acquire);
+
+        if (head == tail)
+        {
+            if (stopping)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds {1});
+
+            continue;
+        }
+
+        auto offset = tail & m_mask;
+        auto n      = std::min<std::uint64_t>(head - tail, m_mask + 1 - offset);
+
+        std::fwrite(m_ring.get() + offset, 1, n, m_file);
+
+        m_tail.store(tail + n, std::memory_order_release);
+    }
+
+    std::fflush(m_file);
+}
+
+inline capture_reader::capture_reader(const std::string& path)
+    :   m_file {std::fopen(path.c_str(), "rb")}
+{
+    if (!m_file)
+        throw std::runtime_error {"Capture file " + path + " could not be opened."};
+
+    char magic[sizeof(CAPTURE_MAGIC)];
+
+    if (std::fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) ||
+        std::memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0)
+    {
+        std::fclose(m_file);
+
+        throw std::runtime_error {path + " is not a capture file."};
+    }
+}
+
+inline capture_reader::~capture_reader()
+{
+    std::fclose(m_file);
+}
+
+inline bool capture_reader::next(capture_record& x)
+{
+    char header[CAPTURE_RECORD_HEADER_SIZE];
+
+    if (std::fread(header, 1, sizeof(header), m_file) != sizeof(header))
+        return false;
+
+    std::uint32_t length;
+
+    x.direction = capture_direction(header[0]);
+    std::memcpy(&x.timestamp, header + 1, sizeof(x.timestamp));
+    std::memcpy(&length, header + 9, sizeof(length));
+
+    boost::endian::little_to_native_inplace(x.timestamp);
+    boost::endian::little_to_native_inplace(length);
+
+    x.message.resize(length);
+
+    return std::fread(x.message.data(), 1, length, m_file) == length;
+}
+
+}
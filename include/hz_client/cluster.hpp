@@ -0,0 +1,497 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/invocation_registry.hpp"
+#include "hz_client/message/authentication.hpp"
+#include "hz_client/message/create_proxies.hpp"
+#include "hz_client/message/cluster_view.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+// How a member's connections are picked among for its partitions.
+enum class striping_policy
+{
+    // Invocations of a partition always go over the same connection of its
+    // owner, so those of the same key keep their order.
+    by_partition,
+
+    // Every invocation takes the next connection of the member. Traffic is
+    // spread evenly even over few hot partitions, but invocations of the
+    // same key may overtake one another.
+    round_robin
+};
+
+struct cluster_options
+{
+    // Members known upfront, all of them connected to at the same time.
+    std::vector<boost::asio::ip::tcp::endpoint> members;
+
+    message::authentication credentials;
+
+    // Proxies created with a single request as soon as the first member is
+    // authenticated, so that the first operations don't wait for them.
+    std::vector<message::proxy_definition> proxies;
+
+    reconnect_options reconnect;
+
+    // Connections opened to each member. Each one has its own write queue
+    // and reader, and is served by its own IO thread on the member, so a
+    // member takes more traffic before a single socket's pipeline limits
+    // it.
+    std::size_t connections_per_member {1};
+
+    striping_policy striping {striping_policy::by_partition};
+
+    // When set, every connection registers for the acks of backups once
+    // authenticated, and again after a reconnect, and invocations wait for
+    // them this long after their response at most.
+    std::optional<std::chrono::milliseconds> backup_ack_timeout;
+};
+
+// Owner of each partition, indexed by partition id.
+struct partition_table
+{
+    std::int32_t                    version {-1};
+    std::vector<boost::uuids::uuid> owners;
+};
+
+// Connections to the members of a cluster, and the partition table to
+// route requests over them.
+//
+// `async_start` opens and authenticates `connections_per_member` connections
+// to every member, all of them concurrently. The first connection to be
+// authenticated is asked for the cluster view and creates the configured
+// proxies, both with the same write. The start completes once every
+// connection has either been authenticated or failed, the proxies exist and
+// the partition table is loaded, i.e. once requests can be routed to the
+// owners of their keys. Connections which fail do not fail the start as
+// long as one of them is authenticated; a member is used over those of its
+// connections which are.
+//
+// The connections share their correlation ids and backup-aware invocations,
+// so that the ack of a backup, which comes over the connection to the
+// backup member, completes the invocation made over the one to the owner.
+//
+// The cluster view listener is registered again whenever its connection
+// is back after a reconnect. Once a connection gives up reconnecting it is
+// no longer routed to, and if it was the one listened over, the listener
+// moves to another authenticated connection.
+//
+// The cluster has to outlive its connections' invocations, and is only to
+// be used from the thread running the io_context.
+class cluster
+{
+    using io_context = boost::asio::io_context;
+    using error_code = boost::system::error_code;
+
+public:
+
+    inline cluster(io_context& ctx, cluster_options options);
+
+    template<typename CompletionToken>
+    auto async_start(CompletionToken&& token);
+
+    inline bool ready() const;
+
+    inline const partition_table& partitions() const;
+
+    // Connection to the owner of `partition_id`, or to the first member if
+    // the owner is not connected, picked among the owner's connections by
+    // the striping policy. Only to be called once started.
+    inline connection& connection_for(std::int32_t partition_id);
+
+    // Connection for invocations which are not bound to a partition: the
+    // one the cluster view is listened to over, or with round robin
+    // striping the next one to the first member.
+    inline connection& any_connection();
+
+    inline void close();
+
+private:
+
+    // Connections to a member, in the order they were authenticated.
+    struct member_connections
+    {
+        std::vector<connection*> stripes;
+        std::size_t              next {0};
+    };
+
+    inline connection& pick(member_connections& member, std::int32_t partition_id);
+
+    inline void start();
+    inline void on_connection_started(connection& conn, error_code err);
+    inline void load_cluster_view();
+    inline void listen_cluster_view();
+    inline void on_reconnect(connection& conn, error_code err);
+    inline void on_cluster_event(const std::vector<char>& event);
+    inline void check_ready();
+
+    io_context&                                      m_ctx;
+    cluster_options                                  m_options;
+    invocation_registry                              m_invocations;
+    std::vector<std::unique_ptr<connection>>         m_connections;
+    std::map<boost::uuids::uuid, member_connections> m_by_member;
+    connection*                                      m_primary {nullptr};
+    member_connections*                              m_primary_member {nullptr};
+    partition_table                                  m_partitions;
+    std::size_t                                      m_connections_pending {0};
+    bool                                             m_view_loaded {false};
+    bool                                             m_proxies_created {false};
+    bool                                             m_ready {false};
+    error_code                                       m_member_error;
+    error_code                                       m_error;
+    std::function<void(error_code)>                  m_waiter;
+};
+
+inline cluster::cluster(io_context& ctx, cluster_options options)
+    :   m_ctx {ctx}
+    ,   m_options {std::move(options)}
+{
+    if (m_options.connections_per_member < 1)
+        m_options.connections_per_member = 1;
+}
+
+template<typename CompletionToken>
+auto cluster::async_start(CompletionToken&& token)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code)
+    >(
+        [this](auto& composable) mutable
+        {
+            m_waiter = make_shallow_copyable(
+                [composable = std::move(composable)](error_code err) mutable
+                {
+                    composable.complete(err);
+                }
+            );
+
+            start();
+        },
+        token
+    );
+}
+
+inline bool cluster::ready() const
+{
+    return m_ready;
+}
+
+inline const partition_table& cluster::partitions() const
+{
+    return m_partitions;
+}
+
+inline connection& cluster::connection_for(std::int32_t partition_id)
+{
+    if (partition_id >= 0 && std::size_t(partition_id) < m_partitions.owners.size())
+    {
+        auto it = m_by_member.find(m_partitions.owners[partition_id]);
+
+        if (it != m_by_member.end() && !it->second.stripes.empty())
+            return pick(it->second, partition_id);
+    }
+
+    return any_connection();
+}
+
+inline connection& cluster::any_connection()
+{
+    if (m_options.striping == striping_policy::round_robin && !m_primary_member->stripes.empty())
+        return pick(*m_primary_member, -1);
+
+    return *m_primary;
+}
+
+inline connection& cluster::pick(member_connections& member, std::int32_t partition_id)
+{
+    const auto& stripes = member.stripes;
+
+    if (stripes.size() == 1)
+        return *stripes.front();
+
+    if (m_options.striping == striping_policy::round_robin || partition_id < 0)
+        return *stripes[member.next++ % stripes.size()];
+
+    return *stripes[std::size_t(partition_id) % stripes.size()];
+}
+
+inline void cluster::close()
+{
+    m_ready = false;
+
+    for (auto& conn : m_connections)
+        conn->close();
+}
+
+inline void cluster::start()
+{
+    m_connections_pending = m_options.members.size() * m_options.connections_per_member;
+
+    if (m_options.members.empty())
+    {
+        m_member_error = make_error_code(error::not_connected);
+
+        return check_ready();
+    }
+
+    for (const auto& member : m_options.members)
+    {
+        for (std::size_t i = 0; i < m_options.connections_per_member; ++i)
+        {
+            auto& conn = *m_connections.emplace_back(
+                std::make_unique<connection>(m_ctx, m_options.reconnect)
+            );
+
+            conn.set_invocation_registry(&m_invocations);
+
+            conn.async_connect(
+                member,
+                [this, &conn](const error_code& err)
+                {
+                    if (err)
+                        return on_connection_started(conn, err);
+
+                    conn.async_authenticate(
+                        m_options.credentials,
+                        [this, &conn](const error_code& err)
+                        {
+                            if (err || !m_options.backup_ack_timeout)
+                                return on_connection_started(conn, err);
+
+                            conn.async_enable_backup_acks(
+                                *m_options.backup_ack_timeout,
+                                [this, &conn](const error_code& err)
+                                {
+                                    on_connection_started(conn, err);
+                                }
+                            );
+                        }
+                    );
+                }
+            );
+        }
+    }
+}
+
+inline void cluster::on_connection_started(connection& conn, error_code err)
+{
+    --m_connections_pending;
+
+    if (err)
+    {
+        m_member_error = err;
+
+        conn.close();
+    }
+    else
+    {
+        auto& member = m_by_member[conn.member_uuid()];
+
+        member.stripes.push_back(&conn);
+
+        conn.set_reconnect_handler(
+            [this, &conn](const error_code& err)
+            {
+                on_reconnect(conn, err);
+            }
+        );
+
+        if (!m_primary)
+        {
+            m_primary        = &conn;
+            m_primary_member = &member;
+
+            load_cluster_view();
+        }
+    }
+
+    check_ready();
+}
+
+inline void cluster::load_cluster_view()
+{
+    m_primary->hold_writes();
+
+    listen_cluster_view();
+
+    if (m_options.proxies.empty())
+    {
+        m_proxies_created = true;
+    }
+    else
+    {
+        message::request<message::create_proxies> req;
+
+        req.entity.proxies = m_options.proxies;
+
+        m_primary->invoke(
+            std::move(req),
+            [this](error_code err, std::vector<char> response)
+            {
+                message::response<message::create_proxies> res;
+
+                if (!err)
+                    err = message::decode_response(response, res);
+
+                if (err)
+                    m_error = err;
+                else
+                    m_proxies_created = true;
+
+                check_ready();
+            }
+        );
+    }
+
+    m_primary->release_writes();
+}
+
+inline void cluster::listen_cluster_view()
+{
+    m_primary->listen(
+        message::request<message::add_cluster_view_listener> {},
+        [this](const std::vector<char>& event)
+        {
+            on_cluster_event(event);
+        },
+        [this](const error_code& err, std::vector<char>)
+        {
+            if (err)
+            {
+                m_error = err;
+
+                check_ready();
+            }
+        }
+    );
+}
+
+inline void cluster::on_reconnect(connection& conn, error_code err)
+{
+    if (!err)
+    {
+        if (&conn == m_primary)
+            listen_cluster_view();
+
+        // Invocations over the connection are only backup-aware again once
+        // registered, if it fails they are not.
+        if (m_options.backup_ack_timeout)
+            conn.async_enable_backup_acks(*m_options.backup_ack_timeout, [](const error_code&) {});
+
+        return;
+    }
+
+    auto& stripes = m_by_member[conn.member_uuid()].stripes;
+
+    stripes.erase(std::remove(begin(stripes), end(stripes), &conn), end(stripes));
+
+    if (&conn != m_primary)
+        return;
+
+    // Any authenticated connection serves, the first member's first.
+    for (auto& [uuid, member] : m_by_member)
+    {
+        if (member.stripes.empty())
+            continue;
+
+        m_primary        = member.stripes.front();
+        m_primary_member = &member;
+
+        return listen_cluster_view();
+    }
+}
+
+inline void cluster::on_cluster_event(const std::vector<char>& event)
+{
+    using view_codec = message::event_codec<message::partitions_view_event>;
+
+    // Member list updates are of no use for routing.
+    if (message::event_type(event) != view_codec::message_type)
+        return;
+
+    message::partitions_view_event view;
+
+    if (message::decode_event(event, view))
+        return;
+
+    if (m_view_loaded && view.version <= m_partitions.version)
+        return;
+
+    partition_table table;
+
+    table.version = view.version;
+    table.owners.resize(m_primary->partition_count());
+
+    for (const auto& [owner, ids] : view.partitions)
+    {
+        for (auto id : ids)
+        {
+            if (id < 0)
+                continue;
+
+            if (std::size_t(id) >= table.owners.size())
+                table.owners.resize(id + 1);
+
+            table.owners[id] = owner;
+        }
+    }
+
+    m_partitions  = std::move(table);
+    m_view_loaded = true;
+
+    check_ready();
+}
+
+inline void cluster::check_ready()
+{
+    if (!m_waiter)
+        return;
+
+    error_code err;
+
+    if (m_error)
+    {
+        err = m_error;
+    }
+    else if (m_connections_pending > 0)
+    {
+        return;
+    }
+    else if (!m_primary)
+    {
+        err = m_member_error;
+    }
+    else if (!m_view_loaded || !m_proxies_created)
+    {
+        return;
+    }
+
+    m_ready = !err;
+
+    auto waiter = std::move(m_waiter);
+
+    m_waiter = nullptr;
+
+    waiter(err);
+}
+
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/message/compact.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+// Schemas of the Compact values serialized through it, and whether the
+// cluster knows them.
+//
+// The schema of a type is recorded the first time a value of the type is
+// serialized, and sent to the cluster by the next `async_publish`. A map
+// given the registry in its options publishes before any invocation once
+// there is a schema to publish, so a type costs one round trip on its first
+// use and nothing afterwards: serializing a value of a type seen before is
+// an array lookup on top of the encoding.
+//
+// To be used from the thread running the io_context, and to outlive the
+// invocations it submits.
+class compact_schemas
+{
+    using error_code = boost::system::error_code;
+
+public:
+
+    template<message::has_compact_codec T>
+    message::data to_data(const T& x);
+
+    // Whether a schema is recorded which the cluster is not known to have,
+    // because it is not sent yet or its response is still awaited.
+    inline bool has_unpublished() const;
+
+    // Sends every schema recorded and not sent yet, one SendSchema each,
+    // and completes once the cluster has them, or with the error of one of
+    // them, which is sent again by the next call. Calls made while schemas
+    // are being sent complete after another round.
+    template<typename CompletionToken>
+    auto async_publish(connection& conn, CompletionToken&& token);
+
+private:
+
+    enum class schema_state
+    {
+        unrecorded,
+        unpublished,
+        publishing,
+        published
+    };
+
+    struct entry
+    {
+        const message::schema* schema {nullptr};
+        schema_state           state {schema_state::unrecorded};
+    };
+
+    // Index of `T` into `m_schemas`, handed out on first use.
+    template<typename T>
+    static std::size_t type_index();
+
+    inline void publish(connection& conn);
+    inline void on_published(connection& conn, std::size_t index, error_code err);
+
+    std::vector<entry>                           m_schemas;
+    std::size_t                                  m_unpublished {0};
+    bool                                         m_publishing {false};
+    std::size_t                                  m_round_left {0};
+    error_code                                   m_round_error;
+    std::vector<std::function<void(error_code)>> m_round_waiters;
+    std::vector<std::function<void(error_code)>> m_waiters;
+
+    static inline std::atomic<std::size_t> s_next_type_index {0};
+};
+
+template<message::has_compact_codec T>
+message::data compact_schemas::to_data(const T& x)
+{
+    auto i = type_index<T>();
+
+    if (i >= m_schemas.size())
+        m_schemas.resize(i + 1);
+
+    if (auto& e = m_schemas[i]; e.state == schema_state::unrecorded)
+    {
+        e.schema = &message::schema_of<T>();
+        e.state  = schema_state::unpublished;
+
+        ++m_unpublished;
+    }
+
+    return message::to_compact_data(x);
+}
+
+inline bool compact_schemas::has_unpublished() const
+{
+    return m_unpublished > 0 || m_publishing;
+}
+
+template<typename CompletionToken>
+auto compact_schemas::async_publish(connection& conn, CompletionToken&& token)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code)
+    >(
+        [this, &conn](auto& composable) mutable
+        {
+            m_waiters.push_back(
+                make_shallow_copyable(
+                    [composable = std::move(composable)](error_code err) mutable
+                    {
+                        composable.complete(err);
+                    }
+                )
+            );
+
+            if (!m_publishing)
+                publish(conn);
+        },
+        token
+    );
+}
+
+template<typename T>
+std::size_t compact_schemas::type_index()
+{
+    static const std::size_t index = s_next_type_index.fetch_add(1, std::memory_order_relaxed);
+
+    return index;
+}
+
+inline void compact_schemas::publish(connection& conn)
+{
+    auto waiters = std::exchange(m_waiters, {});
+
+    std::vector<std::size_t> round;
+
+    for (std::size_t i = 0; i < m_schemas.size(); ++i)
+    {
+        if (m_schemas[i].state == schema_state::unpublished)
+            round.push_back(i);
+    }
+
+    if (round.empty())
+    {
+        for (auto& waiter : waiters)
+            waiter(error_code {});
+
+        return;
+    }
+
+    m_publishing    = true;
+    m_round_left    = round.size();
+    m_round_error   = {};
+    m_round_waiters = std::move(waiters);
+    m_unpublished  -= round.size();
+
+    // The schemas leave with a single write.
+    conn.hold_writes();
+
+    for (auto i : round)
+    {
+        message::request<message::send_schema> req;
+
+        req.entity = {*m_schemas[i].schema};
+
+        m_schemas[i].state = schema_state::publishing;
+
+        conn.invoke(
+            std::move(req),
+            [this, &conn, i](error_code err, std::vector<char> response)
+            {
+                message::response<message::send_schema> res;
+
+                if (!err)
+                    err = message::decode_response(response, res);
+
+                on_published(conn, i, err);
+            }
+        );
+    }
+
+    conn.release_writes();
+}
+
+inline void compact_schemas::on_published(connection& conn, std::size_t index, error_code err)
+{
+    if (err)
+    {
+        m_schemas[index].state = schema_state::unpublished;
+        m_round_error          = err;
+
+        ++m_unpublished;
+    }
+    else
+    {
+        m_schemas[index].state = schema_state::published;
+    }
+
+    if (--m_round_left > 0)
+        return;
+
+    m_publishing = false;
+
+    auto waiters = std::exchange(m_round_waiters, {});
+
+    for (auto& waiter : waiters)
+        waiter(m_round_error);
+
+    if (!m_waiters.empty() && !m_publishing)
+        publish(conn);
+}
+
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/system/error_code.hpp>
+
+#if defined(HZ_CLIENT_WITH_LZ4)
+#include <lz4.h>
+#endif
+
+#if defined(HZ_CLIENT_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "hz_client/error.hpp"
+#include "hz_client/message/data.hpp"
+
+namespace hz_client
+{
+
+enum class compression_algorithm : std::uint8_t
+{
+    none = 0,
+    lz4  = 1,
+    zstd = 2
+};
+
+struct compression_options
+{
+    compression_algorithm algorithm {compression_algorithm::none};
+    std::size_t           threshold {4096};
+    int                   level {3};
+};
+
+// A compressed value travels as a `data` of its own type id, so the members
+// store it opaquely and compressed and uncompressed values of a map can
+// coexist. The envelope payload is laid out as
+//
+//   | algorithm (1) | original type id (4) | original size (4) | compressed bytes |
+//
+// with the integers in big endian, like the rest of a `data` payload.
+static inline constexpr std::int32_t COMPRESSED_TYPE_ID          = 0x485a43;
+static inline constexpr std::size_t  COMPRESSION_ENVELOPE_HEADER = 9;
+
+// LZ4 cannot expand a byte of its output to more than 255 bytes, which
+// bounds the original size an envelope may claim for its compressed bytes.
+static inline constexpr std::size_t  LZ4_MAX_RATIO = 255;
+
+inline bool is_compressed(const message::data& x)
+{
+    return x.type_id == COMPRESSED_TYPE_ID;
+}
+
+inline constexpr bool is_compression_supported(compression_algorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case compression_algorithm::none:
+            return true;
+        case compression_algorithm::lz4:
+#if defined(HZ_CLIENT_WITH_LZ4)
+            return true;
+#else
+            return false;
+#endif
+        case compression_algorithm::zstd:
+#if defined(HZ_CLIENT_WITH_ZSTD)
+            return true;
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+inline message::data compress(message::data x, const compression_options& options)
+{
+    if (options.algorithm == compression_algorithm::none ||
+        !is_compression_supported(options.algorithm) ||
+        x.payload.size() < options.threshold ||
+        is_compressed(x))
+        return x;
+
+    std::size_t bound {0};
+
+#if defined(HZ_CLIENT_WITH_LZ4)
+    if (options.algorithm == compression_algorithm::lz4)
+        bound = LZ4_compressBound(int(x.payload.size()));
+#endif
+#if defined(HZ_CLIENT_WITH_ZSTD)
+    if (options.algorithm == compression_algorithm::zstd)
+        bound = ZSTD_compressBound(x.payload.size());
+#endif
+
+    std::vector<char> envelope(COMPRESSION_ENVELOPE_HEADER + bound);
+    std::size_t compressed_size {0};
+    [[maybe_unused]] auto dst = envelope.data() + COMPRESSION_ENVELOPE_HEADER;
+
+#if defined(HZ_CLIENT_WITH_LZ4)
+    if (options.algorithm == compression_algorithm::lz4)
+    {
+        auto n = LZ4_compress_default(
+            x.payload.data(),
+            dst,
+            int(x.payload.size()),
+            int(bound)
+        );
+
+        compressed_size = n > 0 ? std::size_t(n) : 0;
+    }
+#endif
+#if defined(HZ_CLIENT_WITH_ZSTD)
+    if (options.algorithm == compression_algorithm::zstd)
+    {
+        auto n = ZSTD_compress(
+            dst,
+            bound,
+            x.payload.data(),
+            x.payload.size(),
+            options.level
+        );
+
+        compressed_size = ZSTD_isError(n) ? 0 : n;
+    }
+#endif
+
+    // Not worth it, incompressible values are kept as they are.
+    if (compressed_size == 0 ||
+        COMPRESSION_ENVELOPE_HEADER + compressed_size >= x.payload.size())
+        return x;
+
+    auto type_id       = boost::endian::native_to_big(x.type_id);
+    auto original_size = boost::endian::native_to_big(std::uint32_t(x.payload.size()));
+
+    envelope[0] = char(options.algorithm);
+    std::memcpy(envelope.data() + 1, &type_id, sizeof(type_id));
+    std::memcpy(envelope.data() + 5, &original_size, sizeof(original_size));
+
+    envelope.resize(COMPRESSION_ENVELOPE_HEADER + compressed_size);
+
+    return {COMPRESSED_TYPE_ID, std::move(envelope)};
+}
+
+inline bool is_plausible_original_size(
+    compression_algorithm algorithm,
+    [[maybe_unused]] const char* src,
+    std::size_t src_size,
+    std::size_t original_size
+)
+{
+    switch (algorithm)
+    {
+        case compression_algorithm::none:
+            return src_size == original_size;
+        case compression_algorithm::lz4:
+            return original_size <= src_size * LZ4_MAX_RATIO;
+        case compression_algorithm::zstd:
+#if defined(HZ_CLIENT_WITH_ZSTD)
+            // `compress` has the frame carry the size of its content.
+            return ZSTD_getFrameContentSize(src, src_size) == original_size;
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+// Restores a value produced by `compress` in place. Values which are not
+// compressed are left untouched.
+inline boost::system::error_code decompress(message::data& x)
+{
+    if (!is_compressed(x))
+        return {};
+
+    if (x.payload.size() < COMPRESSION_ENVELOPE_HEADER)
+        return error::decompression_failed;
+
+    auto algorithm = compression_algorithm(x.payload[0]);
+
+    if (!is_compression_supported(algorithm))
+        return error::unsupported_compression;
+
+    std::int32_t  type_id;
+    std::uint32_t original_size;
+
+    std::memcpy(&type_id, x.payload.data() + 1, sizeof(type_id));
+    std::memcpy(&original_size, x.payload.data() + 5, sizeof(original_size));
+
+    boost::endian::big_to_native_inplace(type_id);
+    boost::endian::big_to_native_inplace(original_size);
+
+    [[maybe_unused]] auto src      = x.payload.data() + COMPRESSION_ENVELOPE_HEADER;
+    [[maybe_unused]] auto src_size = x.payload.size() - COMPRESSION_ENVELOPE_HEADER;
+
+    // The size comes from the wire, it is checked against what the bytes
+    // may decompress to before anything is allocated for it.
+    if (!is_plausible_original_size(algorithm, src, src_size, original_size))
+        return error::decompression_failed;
+
+    std::vector<char> original(original_size);
+    bool ok {algorithm == compression_algorithm::none};
+
+    if (algorithm == compression_algorithm::none)
+        std::memcpy(original.data(), src, src_size);
+
+#if defined(HZ_CLIENT_WITH_LZ4)
+    if (algorithm == compression_algorithm::lz4)
+    {
+        auto n = LZ4_decompress_safe(
+            src,
+            original.data(),
+            int(src_size),
+            int(original_size)
+        );
+
+        ok = n >= 0 && std::uint32_t(n) == original_size;
+    }
+#endif
+#if defined(HZ_CLIENT_WITH_ZSTD)
+    if (algorithm == compression_algorithm::zstd)
+    {
+        auto n = ZSTD_decompress(
+            original.data(),
+            original_size,
+            src,
+            src_size
+        );
+
+        ok = !ZSTD_isError(n) && n == original_size;
+    }
+#endif
+
+    if (!ok)
+        return error::decompression_failed;
+
+    x.type_id = type_id;
+    x.payload = std::move(original);
+
+    return {};
+}
+
+}
@@ -1,21 +1,59 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <optional>
+#include <mutex>
 #include <functional>
+#include <unordered_map>
 
+#include <boost/asio/any_io_executor.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/io_context_strand.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/uuid/uuid.hpp>
 
 #include <rbs/rbs.hpp>
 
+#include "hz_client/error.hpp"
+#include "hz_client/capture.hpp"
+#include "hz_client/flush_policy.hpp"
+#include "hz_client/invocation_registry.hpp"
+#include "hz_client/metrics.hpp"
+#include "hz_client/skew_profiler.hpp"
 #include "hz_client/message/authentication.hpp"
 #include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
 #include "hz_client/util/make_shallow_copyable.hpp"
+#include "hz_client/util/mpsc_queue.hpp"
 
 namespace hz_client
 {
 
+struct reconnect_options
+{
+    std::chrono::milliseconds initial_backoff {100};
+    std::chrono::milliseconds max_backoff {5000};
+    double                    multiplier {2.0};
+
+    // Negative means reconnecting is attempted until the connection is
+    // closed explicitly.
+    int max_attempts {-1};
+
+    // How long an attempt, the connect and the authentication together,
+    // may take before it counts as failed.
+    std::chrono::milliseconds authentication_timeout {10000};
+
+    // When set, invocations which are not marked as retryable are sent
+    // again as well instead of being failed with `error::connection_lost`.
+    bool redo_operations {false};
+};
+
 class connection
 {
     using io_context = boost::asio::io_context;
@@ -27,9 +65,19 @@ class connection
 
 public:
 
-    explicit inline connection(io_context& ctx);
+    explicit inline connection(
+        io_context& ctx,
+        reconnect_options options = {},
+        std::size_t submission_capacity = 8192
+    );
+
+    inline ~connection();
 
     inline socket& sck();
+    inline std::int32_t partition_count() const;
+
+    // Uuid of the member the connection is authenticated to, nil before.
+    inline const boost::uuids::uuid& member_uuid() const;
 
     template<typename CompletionToken>
     auto async_connect(
@@ -49,28 +97,405 @@ public:
         CompletionToken&& token
     );
 
+    // Same as `invoke`, but the response lands in storage the caller keeps
+    // across invocations instead of a new vector. `buffer` is swapped with
+    // the buffer the response was read into, so the two capacities are
+    // reused back and forth rather than allocated per message; completes
+    // with the size of the response. `buffer` has to outlive the invocation.
+    template<typename T, typename CompletionToken>
+    auto invoke_into(
+        message::request<T> message,
+        std::vector<char>& buffer,
+        CompletionToken&& token
+    );
+
+    // Decodes the response straight into `out`, which has to outlive the
+    // invocation, and completes with the outcome. The read buffer is kept
+    // for the next message, and data already held by `out` is overwritten
+    // in place where its capacity allows.
+    template<typename T, typename CompletionToken>
+    auto invoke_into(
+        message::request<T> message,
+        message::response<T>& out,
+        CompletionToken&& token
+    );
+
+    // Same as `invoke`, but a request identical to one already in flight on
+    // the connection, i.e. of the same type, partition and payload, is not
+    // sent again. It waits for the response to the one in flight instead,
+    // each waiter completing with its own copy. Only for reads, those
+    // marked as shareable.
+    template<typename T, typename CompletionToken>
+    auto invoke_shared(
+        message::request<T> message,
+        CompletionToken&& token
+    );
+
+    // Registers a listener with `message` and completes with the response
+    // of the registration. Every event the member sends for it afterwards is
+    // passed to `on_event`, on the thread running the io_context, until the
+    // connection is lost or closed; registrations are not renewed after a
+    // reconnect.
+    template<typename T, typename CompletionToken>
+    auto listen(
+        message::request<T> message,
+        std::function<void(const std::vector<char>&)> on_event,
+        CompletionToken&& token
+    );
+
+    // Registers for the acks of backups and, once registered, marks every
+    // invocation as backup-aware. The owner of a partition then responds to
+    // a write without waiting for its synchronous backups, which are acked
+    // to the client directly by the members making them; the invocation
+    // completes once its response and all the acks are in, or `timeout`
+    // after the response at the latest. The acks arrive over the
+    // connections to the backup members, so those have to share the
+    // invocation registry of this one and be registered as well. The
+    // registration is not renewed after a reconnect, invocations are not
+    // backup-aware from then on.
+    template<typename CompletionToken>
+    auto async_enable_backup_acks(
+        std::chrono::milliseconds timeout,
+        CompletionToken&& token
+    );
+
+    // Same as `invoke`, but safe to be called from any thread. The message
+    // is encoded on the calling thread and handed to the thread running the
+    // io_context through a lock-free queue, which is woken only when it
+    // finds the queue empty. Completes with `error::submission_queue_full`
+    // when the queue is full, through the io_context as well.
+    template<typename T, typename CompletionToken>
+    auto submit(
+        message::request<T> message,
+        CompletionToken&& token
+    );
+
+    // Stops reconnecting and fails every pending invocation with
+    // `error::connection_closed`.
+    inline void close();
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    inline const metrics::connection_counters& counters() const;
+#endif
+
+    // Called on the thread running the io_context with no error every time
+    // the link is back after being lost, before the invocations kept
+    // across the loss are sent again, and with `error::connection_lost`
+    // once reconnecting is given up. Registrations of listeners, which the
+    // member forgets with the link, are to be renewed from it.
+    inline void set_reconnect_handler(std::function<void(error_code)> handler);
+
+    // Takes correlation ids from `registry` rather than from a registry of
+    // its own, and looks the invocations acked by backup events up in it,
+    // so that the connections sharing it can route acks to one another.
+    // To be set before the first invocation; the registry has to outlive
+    // the connection.
+    inline void set_invocation_registry(invocation_registry* registry);
+
+    // Records every message sent and received from now on into `capture`,
+    // or stops recording if it is null. The writer has to outlive the
+    // connection or be detached first. Messages sent again after a
+    // reconnect are not recorded twice.
+    inline void set_capture(capture_writer* capture);
+
+    // Samples the invocations made from now on into `profiler`, or stops
+    // if it is null. The profiler has to outlive the connection or be
+    // detached first; maps over the connection sample their keys into it.
+    inline void set_profiler(skew_profiler* profiler);
+    inline skew_profiler* profiler() const;
+
+    // Takes effect with the next write, and its socket options right away
+    // if connected, otherwise once connected.
+    inline void set_flush_policy(flush_policy policy);
+
+    // Completions of invocations made with `submit` are run on `executor`
+    // from then on, rather than on the thread running the io_context, so
+    // that callbacks of any cost don't hold up the reading of the socket,
+    // whose thread only decodes and routes responses. They are handed over
+    // in batches: the executor is woken only when it has none to run, and
+    // takes every completion queued by then at once. Completions of the
+    // other invocations stay on the io_context's thread, as their callbacks
+    // may drive the connection further.
+    inline void set_completion_executor(boost::asio::any_io_executor executor);
+
+    // Messages given to `invoke` whose values add up to at least `threshold`
+    // bytes are encoded on `executor` from then on, into buffers of their
+    // own which are written out as they are, so that a large value does not
+    // hold up the reading. Messages still go out in the order they are
+    // invoked in: those behind a large one wait for it to be encoded, those
+    // ahead of it are written meanwhile. Smaller ones are encoded straight
+    // into the pending buffer. The
+    // connection has to outlive the messages being encoded.
+    inline void set_serialization_executor(
+        boost::asio::any_io_executor executor,
+        std::size_t threshold = 64 * 1024
+    );
+
+    // Sets SO_BUSY_POLL on the socket, for the kernel to poll the device
+    // for this long on reads instead of waiting for an interrupt; zero
+    // leaves it as the system sets it. Meant to be used along with
+    // `run_busy_polling`. Linux only, and may need CAP_NET_ADMIN.
+    inline void set_busy_poll(std::chrono::microseconds duration);
+
+    // While writes are held, invocations are only serialized into the
+    // pending buffer. Releasing the last hold flushes them with a single
+    // write.
+    inline void hold_writes();
+    inline void release_writes();
+
+    // Grows as writes start. An invocation made while this was `n` which
+    // fails while it still is never left the client.
+    inline std::uint64_t writes_started() const;
+
 private:
 
+    enum class link_state
+    {
+        disconnected,
+        connected,
+        reconnecting,
+        closed
+    };
+
+    using byte_array_t    = std::vector<char>;
+    // The response is passed by reference for the callback to take it over
+    // or leave it, in which case its capacity is reused for the next one.
+    using invocation_cb_t = std::function<void(error_code, byte_array_t&)>;
+    using event_cb_t      = std::function<void(const byte_array_t&)>;
+
+    struct invocation
+    {
+        invocation_cb_t callback;
+
+        // Copy of the encoded message, kept only if it may be sent again.
+        byte_array_t    encoded;
+
+        // Write batch the message is serialized into. Messages of the
+        // batch which is still pending have not touched the socket yet.
+        std::uint64_t   batch {0};
+        bool            resend {false};
+
+        // Acks of backups received so far, which may precede the response.
+        // A response telling of more backups than that is held back until
+        // the rest arrive, `backups_expected` being their number then.
+        std::int32_t    backups_acked {0};
+        std::int32_t    backups_expected {0};
+        byte_array_t    response;
+
+        // Correlation id it is registered under with the invocation
+        // registry, for its acks to be routed to it from any connection.
+        std::int64_t    registered_id {0};
+
+        // Made with `submit`, to be completed on the completion executor.
+        bool            offload {false};
+
+        // Sampled by the profiler, which is told of the response as well.
+        bool            profiled {false};
+        std::int32_t    partition_id {-1};
+        std::chrono::steady_clock::time_point queued_at;
+
+        HZ_CLIENT_METRIC(std::int32_t type {0};)
+    };
+
+    using handlers_t  = std::unordered_map<int64_t, invocation>;
+    using listeners_t = std::unordered_map<int64_t, event_cb_t>;
+
+    // A message encoded into a buffer of its own, written after the first
+    // `first` bytes of its write buffer. Its place is reserved when it is
+    // invoked, and `encoded` is empty until the encoding is done.
+    // Empty while it is being encoded; it and whatever follows it are
+    // left out of writes until then, as the batch it starts.
+    struct detached_message
+    {
+        std::size_t   first {0};
+        std::int64_t  correlation_id {0};
+        std::uint64_t batch {0};
+        byte_array_t  encoded;
+    };
+
+    struct completion
+    {
+        invocation_cb_t callback;
+        error_code      err;
+        byte_array_t    response;
+    };
+
+    // Completions on their way to the completion executor. Shared with the
+    // runs posted to the executor, which may outlive the connection.
+    struct completion_queue
+    {
+        std::mutex                mutex;
+        std::vector<completion>   ready;
+        bool                      draining {false};
+    };
+
+    // Waiters of the shared invocations in flight, keyed by the encoded
+    // request with a zero correlation id.
+    using shared_t    = std::unordered_map<std::string, std::vector<invocation_cb_t>>;
+
+    struct submission
+    {
+        std::int64_t    correlation_id {0};
+        byte_array_t    encoded;
+        invocation_cb_t callback;
+        bool            retryable {false};
+        std::int32_t    partition_id {-1};
+
+        HZ_CLIENT_METRIC(std::int32_t type {0};)
+        HZ_CLIENT_METRIC(std::uint64_t allocations {0};)
+    };
+
+    // Completes with what `deliver(composable, err, response)` passes to
+    // `composable.complete`, `Signature` being the completion signature.
+    template<typename Signature, typename T, typename Deliver, typename CompletionToken>
+    auto async_invoke(
+        message::request<T> message,
+        event_cb_t on_event,
+        Deliver deliver,
+        CompletionToken&& token
+    );
+
+    inline void complete_shared(const std::string& key, error_code err, byte_array_t& response);
+
+    inline void register_for_backups(std::int64_t correlation_id, invocation& inv);
+    inline void hold_for_backups(std::int64_t correlation_id, invocation& inv, std::int32_t acks);
+    inline void on_backup_event();
+    inline void on_backup_ack(std::int64_t correlation_id);
+    inline void complete_held(handlers_t::iterator it);
+    inline void profile(invocation& inv, std::int32_t partition_id, std::size_t bytes);
+
+    // Reserves the place of `message` in the pending buffer, the messages
+    // after it waiting for it to be filled, then encodes it, at least `size` bytes long, on
+    // the serialization executor and hands it over to `enqueue_detached`.
+    template<typename T>
+    void serialize_detached(message::request<T> message, std::size_t size, invocation_cb_t callback);
+    inline void enqueue_detached(
+        std::int64_t correlation_id,
+        std::int32_t partition_id,
+        byte_array_t encoded,
+        invocation inv
+    );
+    inline void arm_backup_timer();
+    inline void on_backup_timeout();
+
+    // Completes `inv`, right away or by handing it to the completion
+    // executor, which takes `response` along.
+    inline void finish(invocation& inv, error_code err, byte_array_t& response);
+    static inline void run_completions(completion_queue& queue);
+
     inline void start_reader();
     inline void do_write();
+    inline void write_now();
+    inline std::chrono::microseconds flush_delay();
+    inline void apply_socket_options();
+    inline void set_cork(bool on);
     inline void on_frame_header_read(const error_code& err);
     inline void on_frame_read(const error_code& err, int n_read, bool is_final);
     inline void toggle_write_buffer();
     inline streambuf& writing_buffer();
     inline streambuf& pending_buffer();
 
-    using byte_array_t    = std::vector<char>;
-    using invocation_cb_t = std::function<void(error_code, byte_array_t)>;
-    using handlers_t      = std::unordered_map<int64_t, invocation_cb_t>;
-
-    byte_array_t m_received_message;
-    bool         m_write_in_progress;
-    uint64_t     m_correlation_id;
-    handlers_t   m_handlers;
-    int          m_active_buffer_idx;
-    streambuf    m_write_buffers[2];
-    streambuf    m_read_buffer;
-    socket       m_sck;
+    // Of the pending buffer and of the messages to be written along with it.
+    inline std::size_t pending_bytes();
+
+    // Of those, the ones ahead of the first message still being encoded.
+    inline std::size_t ready_bytes();
+
+    inline error_code unavailable_reason() const;
+    inline void drain_submissions();
+    inline void enqueue(submission s);
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    inline void count_invocation(
+        std::int32_t type,
+        std::size_t request_bytes,
+        std::size_t bytes_copied,
+        std::uint64_t allocations_before
+    );
+    inline void count_response(
+        std::int32_t type,
+        std::size_t response_bytes,
+        std::uint64_t allocations_before
+    );
+    inline void count_read(std::size_t n);
+    inline void count_write(std::size_t n, std::uint64_t messages);
+#endif
+
+    inline void on_connection_error(const error_code& err);
+    inline void schedule_reconnect();
+    inline void reconnect();
+    inline void send_handshake();
+    inline void on_reconnected();
+    inline void on_reconnect_failed();
+    inline void reset_link();
+    inline void fail_handlers(error_code err, bool keep_retryable);
+
+    byte_array_t      m_received_message;
+    bool              m_write_in_progress;
+    invocation_registry  m_own_registry;
+    invocation_registry* m_registry;
+    std::int32_t      m_partition_count;
+    handlers_t        m_handlers;
+    listeners_t       m_listeners;
+    shared_t          m_shared;
+    boost::uuids::uuid m_member_uuid;
+    int               m_active_buffer_idx;
+    streambuf         m_write_buffers[2];
+    streambuf         m_read_buffer;
+    socket            m_sck;
+
+    reconnect_options m_reconnect_options;
+    link_state        m_state;
+    std::uint64_t     m_generation;
+    std::uint64_t     m_write_batch;
+    std::uint64_t     m_pending_batch;
+    endpoint          m_endpoint;
+    std::optional<message::authentication> m_auth;
+    streambuf         m_handshake_buffer;
+    std::uint64_t     m_handshake_id;
+    boost::asio::steady_timer m_reconnect_timer;
+    std::chrono::milliseconds m_backoff;
+    int               m_reconnect_attempts;
+    std::function<void(error_code)> m_reconnect_handler;
+    int               m_write_holds;
+    capture_writer*   m_capture;
+    skew_profiler*    m_profiler;
+
+    flush_policy              m_flush_policy;
+    boost::asio::steady_timer m_flush_timer;
+    bool                      m_flush_armed {false};
+    bool                      m_corked {false};
+    std::chrono::microseconds m_busy_poll {0};
+
+    std::optional<boost::asio::any_io_executor> m_completion_executor;
+
+    // Messages encoded into buffers of their own, next to each write buffer.
+    std::optional<boost::asio::any_io_executor> m_serialization_executor;
+    std::size_t                                 m_serialization_threshold {0};
+    std::vector<detached_message>               m_detached[2];
+    std::shared_ptr<completion_queue>           m_completions {std::make_shared<completion_queue>()};
+
+    // Held responses by the time their backups stop being waited for, in
+    // the order they arrived, which is that of their deadlines as well.
+    std::atomic<bool>         m_backup_aware {false};
+    std::chrono::milliseconds m_backup_ack_timeout {0};
+    boost::asio::steady_timer m_backup_timer;
+    bool                      m_backup_timer_armed {false};
+    std::deque<std::pair<std::int64_t, std::chrono::steady_clock::time_point>> m_backup_deadlines;
+
+    // Round trip time, smoothed, sampled with the first response to a
+    // write while no other sample is being taken.
+    std::chrono::steady_clock::duration   m_rtt {};
+    bool                                  m_rtt_probing {false};
+    std::uint64_t                         m_rtt_probe_batch {0};
+    std::chrono::steady_clock::time_point m_rtt_probe_started;
+
+    HZ_CLIENT_METRIC(metrics::connection_counters m_counters;)
+    HZ_CLIENT_METRIC(std::uint64_t m_pending_messages {0};)
+    HZ_CLIENT_METRIC(std::uint64_t m_message_allocations {0};)
+
+    mpsc_queue<submission> m_submissions;
+    std::atomic<bool> m_drain_scheduled;
 };
 
 }
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <type_traits>
+
+#include <boost/system/error_code.hpp>
+
+namespace hz_client
+{
+
+enum class error
+{
+    success = 0,
+    malformed_response,
+    remote_exception,
+    authentication_failed,
+    decompression_failed,
+    unsupported_compression,
+    not_connected,
+    connection_lost,
+    connection_closed,
+    submission_queue_full,
+    schema_mismatch
+};
+
+class error_category : public boost::system::error_category
+{
+public:
+
+    const char* name() const noexcept override
+    {
+        return "hz_client";
+    }
+
+    std::string message(int ev) const override
+    {
+        switch (static_cast<error>(ev))
+        {
+            case error::success:
+                return "Success";
+            case error::malformed_response:
+                return "Malformed response";
+            case error::remote_exception:
+                return "Member responded with an exception";
+            case error::authentication_failed:
+                return "Authentication failed";
+            case error::decompression_failed:
+                return "Compressed value could not be decompressed";
+            case error::unsupported_compression:
+                return "Value is compressed with an algorithm which is not compiled in";
+            case error::not_connected:
+                return "Not connected";
+            case error::connection_lost:
+                return "Connection is lost before the response is received";
+            case error::connection_closed:
+                return "Connection is closed";
+            case error::submission_queue_full:
+                return "Submission queue is full";
+            case error::schema_mismatch:
+                return "Compact value is of another schema than its type";
+        }
+
+        return "Unknown error";
+    }
+};
+
+inline const boost::system::error_category& hz_category()
+{
+    static error_category instance;
+
+    return instance;
+}
+
+inline boost::system::error_code make_error_code(error e)
+{
+    return {static_cast<int>(e), hz_category()};
+}
+
+}
+
+namespace boost::system
+{
+
+template<>
+struct is_error_code_enum<hz_client::error> : std::true_type
+{};
+
+}
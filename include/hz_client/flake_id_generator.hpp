@@ -0,0 +1,324 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/message/flake_id.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+struct flake_id_options
+{
+    // Number of ids reserved with one request.
+    std::int32_t prefetch_count {100};
+
+    // Ids of a batch are not handed out once it is this old, counted from
+    // when it was asked for. Zero means batches never expire.
+    std::chrono::milliseconds prefetch_validity {std::chrono::minutes {10}};
+};
+
+// Cluster-wide unique ids, handed out from batches reserved on the members.
+//
+// One batch is handed out from while the next one is kept in reserve: the
+// reserve is asked for as soon as the previous one is taken into use, so
+// that a steady flow of ids never waits for a round trip. Taking an id is a
+// couple of atomic operations on the batch in use, which may be done from
+// any thread with `try_new_id`.
+//
+// The generator has to outlive the invocations it submits.
+class flake_id_generator
+{
+    using error_code = boost::system::error_code;
+
+public:
+
+    inline flake_id_generator(
+        connection& conn,
+        std::string name,
+        flake_id_options options = {}
+    );
+
+    inline const std::string& name() const;
+
+    // Takes an id from the batch at hand, lock-free and from any thread.
+    // Returns nothing if there is none, in which case a batch is asked for.
+    inline std::optional<std::int64_t> try_new_id();
+
+    // Completes with an id, without a round trip if one is at hand,
+    // otherwise once a batch arrives; `try_new_id` is the way to take one
+    // without a completion. To be called from the thread running the
+    // io_context.
+    template<typename CompletionToken>
+    auto async_new_id(CompletionToken&& token);
+
+private:
+
+    using clock = std::chrono::steady_clock;
+
+    // A batch, published seqlock-style: `epoch` is odd while the batch is
+    // being replaced, and readers which see it change discard what they
+    // read. Every field is atomic for the reads racing the replacement to
+    // be well-defined.
+    struct batch_slot
+    {
+        std::atomic<std::uint64_t> epoch {0};
+        std::atomic<std::int64_t>  base {0};
+        std::atomic<std::int64_t>  increment {0};
+        std::atomic<std::int64_t>  size {0};
+
+        // In ticks of the steady clock, zero for never.
+        std::atomic<std::int64_t>  valid_until {0};
+
+        // Index of the next id to be taken, past the size once the batch
+        // has run out.
+        std::atomic<std::int64_t>  next {0};
+    };
+
+    // Bit 0 selects the slot in use, the other one holding the reserve
+    // when `RESERVE_READY` is set. Only the slot which is not in use is
+    // ever written to, and only while its reserve is not ready.
+    static inline constexpr std::uint32_t RESERVE_READY = 2;
+
+    static inline std::optional<std::int64_t> take(batch_slot& slot);
+
+    inline void request_batch();
+    inline void fetch();
+    inline void on_fetched(
+        error_code err,
+        const message::response<message::flake_id_new_batch>& res,
+        clock::time_point requested
+    );
+
+    connection&                m_conn;
+    std::string                m_name;
+    flake_id_options           m_options;
+
+    batch_slot                 m_slots[2];
+    std::atomic<std::uint32_t> m_state {0};
+    std::atomic<bool>          m_fetching {false};
+
+    std::deque<std::function<void(error_code, std::int64_t)>> m_waiters;
+};
+
+inline flake_id_generator::flake_id_generator(
+    connection& conn,
+    std::string name,
+    flake_id_options options
+)
+    :   m_conn {conn}
+    ,   m_name {std::move(name)}
+    ,   m_options {std::move(options)}
+{
+    if (m_options.prefetch_count < 1)
+        m_options.prefetch_count = 1;
+}
+
+inline const std::string& flake_id_generator::name() const
+{
+    return m_name;
+}
+
+inline std::optional<std::int64_t> flake_id_generator::try_new_id()
+{
+    auto state = m_state.load(std::memory_order_acquire);
+
+    if (auto id = take(m_slots[state & 1]))
+        return id;
+
+    // The batch in use has run out or expired, the reserve takes over if
+    // it is there. Whoever loses the race to switch over retries with the
+    // slot the winner switched to.
+    while (state & RESERVE_READY)
+    {
+        auto next = (state ^ 1) & ~RESERVE_READY;
+
+        if (m_state.compare_exchange_weak(state, next, std::memory_order_acq_rel))
+            state = next;
+
+        if (auto id = take(m_slots[state & 1]))
+        {
+            request_batch();
+
+            return id;
+        }
+    }
+
+    request_batch();
+
+    return std::nullopt;
+}
+
+template<typename CompletionToken>
+auto flake_id_generator::async_new_id(CompletionToken&& token)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code, std::int64_t)
+    >(
+        [this](auto& composable) mutable
+        {
+            // Never completed from within this call.
+            if (auto id = try_new_id())
+            {
+                return boost::asio::post(
+                    m_conn.sck().get_executor(),
+                    [composable = std::move(composable), id = *id]() mutable
+                    {
+                        composable.complete(error_code {}, id);
+                    }
+                );
+            }
+
+            m_waiters.push_back(
+                make_shallow_copyable(
+                    [composable = std::move(composable)](error_code err, std::int64_t id) mutable
+                    {
+                        composable.complete(err, id);
+                    }
+                )
+            );
+        },
+        token
+    );
+}
+
+inline std::optional<std::int64_t> flake_id_generator::take(batch_slot& slot)
+{
+    auto epoch = slot.epoch.load(std::memory_order_acquire);
+
+    if (epoch & 1)
+        return std::nullopt;
+
+    auto i           = slot.next.fetch_add(1, std::memory_order_relaxed);
+    auto size        = slot.size.load(std::memory_order_relaxed);
+    auto base        = slot.base.load(std::memory_order_relaxed);
+    auto increment   = slot.increment.load(std::memory_order_relaxed);
+    auto valid_until = slot.valid_until.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (slot.epoch.load(std::memory_order_relaxed) != epoch)
+        return std::nullopt;
+
+    if (i >= size)
+        return std::nullopt;
+
+    if (valid_until != 0 && clock::now().time_since_epoch().count() >= valid_until)
+        return std::nullopt;
+
+    return base + i * increment;
+}
+
+inline void flake_id_generator::request_batch()
+{
+    if (m_state.load(std::memory_order_acquire) & RESERVE_READY)
+        return;
+
+    if (!m_fetching.exchange(true, std::memory_order_acq_rel))
+        boost::asio::post(m_conn.sck().get_executor(), [this] { fetch(); });
+}
+
+inline void flake_id_generator::fetch()
+{
+    // Asked for on another thread, by one which saw the reserve missing
+    // before it was published.
+    if (m_state.load(std::memory_order_acquire) & RESERVE_READY)
+        return m_fetching.store(false, std::memory_order_release);
+
+    message::request<message::flake_id_new_batch> req;
+
+    req.entity = {m_name, m_options.prefetch_count};
+
+    auto requested = clock::now();
+
+    m_conn.invoke(
+        std::move(req),
+        [this, requested](error_code err, std::vector<char> response)
+        {
+            message::response<message::flake_id_new_batch> res;
+
+            if (!err)
+                err = message::decode_response(response, res);
+
+            on_fetched(err, res, requested);
+        }
+    );
+}
+
+inline void flake_id_generator::on_fetched(
+    error_code err,
+    const message::response<message::flake_id_new_batch>& res,
+    clock::time_point requested
+)
+{
+    if (!err && res.batch_size < 1)
+        err = error::malformed_response;
+
+    if (err)
+    {
+        m_fetching.store(false, std::memory_order_release);
+
+        auto waiters = std::exchange(m_waiters, {});
+
+        for (auto& waiter : waiters)
+            waiter(err, 0);
+
+        return;
+    }
+
+    // The reserve is not ready, as it is only fetched when it is not, and
+    // nothing but this makes it ready, so the slot in use does not change
+    // until it is published.
+    auto  state = m_state.load(std::memory_order_acquire);
+    auto& slot  = m_slots[(state & 1) ^ 1];
+
+    std::int64_t valid_until {0};
+
+    if (m_options.prefetch_validity.count() > 0)
+        valid_until = (requested + m_options.prefetch_validity).time_since_epoch().count();
+
+    slot.epoch.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.base.store(res.base, std::memory_order_relaxed);
+    slot.increment.store(res.increment, std::memory_order_relaxed);
+    slot.size.store(res.batch_size, std::memory_order_relaxed);
+    slot.valid_until.store(valid_until, std::memory_order_relaxed);
+    slot.next.store(0, std::memory_order_relaxed);
+
+    slot.epoch.fetch_add(1, std::memory_order_release);
+
+    m_state.fetch_or(RESERVE_READY, std::memory_order_release);
+    m_fetching.store(false, std::memory_order_release);
+
+    // Waiters are served in order, a further batch being asked for by the
+    // ids they take once the reserve is in use.
+    while (!m_waiters.empty())
+    {
+        auto id = try_new_id();
+
+        if (!id)
+            break;
+
+        auto waiter = std::move(m_waiters.front());
+
+        m_waiters.pop_front();
+
+        waiter(error_code {}, *id);
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace hz_client
+{
+
+enum class flush_mode
+{
+    // Pending messages are written as soon as no write is in progress.
+    immediate,
+
+    // Pending messages are written once they are `max_pending_bytes` long,
+    // or `max_delay` after the first of them at the latest.
+    size_or_deadline,
+
+    // Pending messages are written right away while the connection is
+    // idle. While other invocations are in flight, and their responses are
+    // a round trip away anyway, they are held for up to `rtt_fraction` of
+    // the observed round trip time, `max_delay` at most, for more of them
+    // to go with the same write. Bounded by `max_pending_bytes` as well.
+    adaptive
+};
+
+// When a connection writes what it has serialized, and how its socket is
+// set up to send it.
+struct flush_policy
+{
+    flush_mode mode {flush_mode::immediate};
+
+    std::size_t max_pending_bytes {64 * 1024};
+
+    std::chrono::microseconds max_delay {200};
+
+    double rtt_fraction {0.125};
+
+    // TCP_NODELAY, left as the system sets it when empty.
+    std::optional<bool> no_delay;
+
+    // Linux only. The socket is corked while writes follow each other, so
+    // that the kernel sends full segments, and uncorked once there is
+    // nothing more to be written, so that the last segment leaves at once.
+    bool cork {false};
+};
+
+}
@@ -1,227 +1,1708 @@
 #pragma once
 
+#include <utility>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
 #include "hz_client/connection.hpp"
 #include <boost/asio/read.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/buffers_iterator.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/random_generator.hpp>
 #include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/stream_buffer.hpp>
 
 namespace hz_client
 {
 
-inline connection::connection(io_context& ctx)
+inline connection::connection(
+    io_context& ctx,
+    reconnect_options options,
+    std::size_t submission_capacity
+)
     :   m_write_in_progress {false}
     ,   m_sck {ctx}
     ,   m_active_buffer_idx {0}
-    ,   m_correlation_id {1}
+    ,   m_registry {&m_own_registry}
+    ,   m_partition_count {271}
+    ,   m_member_uuid {}
+    ,   m_reconnect_options {std::move(options)}
+    ,   m_state {link_state::disconnected}
+    ,   m_generation {0}
+    ,   m_write_batch {0}
+    ,   m_pending_batch {0}
+    ,   m_handshake_id {0}
+    ,   m_reconnect_timer {ctx}
+    ,   m_backoff {m_reconnect_options.initial_backoff}
+    ,   m_reconnect_attempts {0}
+    ,   m_write_holds {0}
+    ,   m_capture {nullptr}
+    ,   m_profiler {nullptr}
+    ,   m_flush_timer {ctx}
+    ,   m_backup_timer {ctx}
+    ,   m_submissions {submission_capacity}
+    ,   m_drain_scheduled {false}
 {}
 
+inline connection::~connection()
+{
+    // The registry may be shared, and outlive the connection.
+    for (auto& [correlation_id, inv] : m_handlers)
+    {
+        if (inv.registered_id != 0)
+            m_registry->remove(inv.registered_id);
+    }
+}
+
 inline boost::asio::ip::tcp::socket&
 connection::sck()
 {
     return m_sck;
 }
 
+inline std::int32_t connection::partition_count() const
+{
+    return m_partition_count;
+}
+
+inline const boost::uuids::uuid& connection::member_uuid() const
+{
+    return m_member_uuid;
+}
+
 template<typename T, typename CompletionToken>
 auto connection::invoke(
     message::request<T> message,
     CompletionToken&& token
 )
 {
-    enum state { starting, response_awaiting };
+    return async_invoke<void(boost::system::error_code, std::vector<char>)>(
+        std::move(message),
+        {},
+        [](auto& composable, const error_code& err, byte_array_t& response)
+        {
+            composable.complete(err, std::move(response));
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename T, typename CompletionToken>
+auto connection::invoke_into(
+    message::request<T> message,
+    std::vector<char>& buffer,
+    CompletionToken&& token
+)
+{
+    return async_invoke<void(boost::system::error_code, std::size_t)>(
+        std::move(message),
+        {},
+        [&buffer](auto& composable, const error_code& err, byte_array_t& response)
+        {
+            if (err)
+                return composable.complete(err, std::size_t {0});
+
+            std::swap(buffer, response);
+
+            composable.complete(err, buffer.size());
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename T, typename CompletionToken>
+auto connection::invoke_into(
+    message::request<T> message,
+    message::response<T>& out,
+    CompletionToken&& token
+)
+{
+    return async_invoke<void(boost::system::error_code)>(
+        std::move(message),
+        {},
+        [&out](auto& composable, error_code err, byte_array_t& response)
+        {
+            if (!err)
+                err = message::decode_response(response, out);
+
+            composable.complete(err);
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename T, typename CompletionToken>
+auto connection::invoke_shared(
+    message::request<T> message,
+    CompletionToken&& token
+)
+{
+    static_assert(message::is_shareable_v<T>, "only reads can be shared");
+
+    return boost::asio::async_compose<
+        CompletionToken, void(boost::system::error_code, std::vector<char>)
+    >(
+        [
+            this,
+            message = std::move(message)
+        ]
+        (auto& composable) mutable
+        {
+            auto req = std::move(message);
+
+            std::string key;
+
+            {
+                boost::iostreams::stream_buffer<
+                    boost::iostreams::back_insert_device<std::string>
+                > encoder {key};
+
+                req.header.correlation_id = 0;
+
+                rbs::serialize_le(req, encoder);
+            }
+
+            auto [shared, first] = m_shared.try_emplace(key);
+
+            shared->second.push_back(
+                make_shallow_copyable(
+                    [composable = std::move(composable)]
+                    (const boost::system::error_code& err, byte_array_t& response) mutable
+                    {
+                        composable.complete(err, std::move(response));
+                    }
+                )
+            );
+
+            if (!first)
+            {
+                HZ_CLIENT_METRIC(++m_counters.shared_invocations;)
+
+                return;
+            }
+
+            invoke(
+                std::move(req),
+                [this, key = std::move(key)](const error_code& err, byte_array_t response)
+                {
+                    complete_shared(key, err, response);
+                }
+            );
+        },
+        token
+    );
+}
+
+template<typename T, typename CompletionToken>
+auto connection::listen(
+    message::request<T> message,
+    std::function<void(const std::vector<char>&)> on_event,
+    CompletionToken&& token
+)
+{
+    return async_invoke<void(boost::system::error_code, std::vector<char>)>(
+        std::move(message),
+        std::move(on_event),
+        [](auto& composable, const error_code& err, byte_array_t& response)
+        {
+            composable.complete(err, std::move(response));
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto connection::async_enable_backup_acks(
+    std::chrono::milliseconds timeout,
+    CompletionToken&& token
+)
+{
+    enum {starting, registering};
+
+    return boost::asio::async_compose<
+        CompletionToken, void(boost::system::error_code)
+    >(
+        [this, timeout, state = starting](
+            auto& composable,
+            const error_code& err = {},
+            std::vector<char> response = {}
+        ) mutable
+        {
+            if (state == starting)
+            {
+                state = registering;
+
+                // Acks come as events with the backup event flag, which are
+                // told apart by it rather than by a listener.
+                return listen(
+                    message::request<message::add_local_backup_listener> {},
+                    nullptr,
+                    std::move(composable)
+                );
+            }
+
+            auto ec = err;
+
+            message::response<message::add_local_backup_listener> res;
+
+            if (!ec)
+                ec = message::decode_response(response, res);
+
+            if (!ec)
+            {
+                m_backup_ack_timeout = timeout;
+                m_backup_aware.store(true, std::memory_order_relaxed);
+            }
+
+            composable.complete(ec);
+        },
+        token
+    );
+}
+
+template<typename Signature, typename T, typename Deliver, typename CompletionToken>
+auto connection::async_invoke(
+    message::request<T> message,
+    event_cb_t on_event,
+    Deliver deliver,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<CompletionToken, Signature>(
+        [
+            this,
+            message  = std::move(message),
+            on_event = std::move(on_event),
+            deliver  = std::move(deliver)
+        ]
+        (auto& composable) mutable
+        {
+            // Posted rather than delivered from within the call, so that a
+            // caller invoking again from its handler does not recurse.
+            if (auto reason = unavailable_reason())
+            {
+                auto on_response = std::move(deliver);
+
+                return boost::asio::post(
+                    m_sck.get_executor(),
+                    [
+                        composable = std::move(composable),
+                        deliver    = std::move(on_response),
+                        reason
+                    ]
+                    () mutable
+                    {
+                        byte_array_t none;
+
+                        deliver(composable, reason, none);
+                    }
+                );
+            }
+
+            HZ_CLIENT_METRIC(auto allocations = metrics::allocations();)
+
+            message.header.correlation_id = m_registry->next_correlation_id();
+
+            if (m_backup_aware.load(std::memory_order_relaxed))
+                message.header.flags |= message::frame_header::BACKUP_AWARE_FLAG;
+
+            // The captures are moved along with `composable` below.
+            if (on_event)
+            {
+                m_listeners.emplace(
+                    message.header.correlation_id,
+                    std::move(on_event)
+                );
+            }
+
+            if (m_serialization_executor)
+            {
+                auto size = message::estimated_size(message);
+
+                if (size >= m_serialization_threshold)
+                {
+                    auto detached    = std::move(message);
+                    auto on_response = std::move(deliver);
+
+                    return serialize_detached(
+                        std::move(detached),
+                        size,
+                        make_shallow_copyable(
+                            [
+                                composable = std::move(composable),
+                                deliver    = std::move(on_response)
+                            ]
+                            (const boost::system::error_code& err, byte_array_t& response) mutable
+                            {
+                                deliver(composable, err, response);
+                            }
+                        )
+                    );
+                }
+            }
+
+            auto& buffer = pending_buffer();
+            auto  offset = buffer.size();
+
+            rbs::serialize_le(message, buffer);
+
+            if (m_capture)
+            {
+                auto encoded = buffer.data();
+
+                m_capture->record(
+                    capture_direction::outgoing,
+                    static_cast<const char*>(encoded.data()) + offset,
+                    encoded.size() - offset
+                );
+            }
+
+            auto correlation_id = message.header.correlation_id;
+            auto on_response    = std::move(deliver);
+
+            invocation inv;
+
+            inv.callback = make_shallow_copyable(
+                [
+                    composable = std::move(composable),
+                    deliver    = std::move(on_response)
+                ]
+                (const boost::system::error_code& err, byte_array_t& response) mutable
+                {
+                    deliver(composable, err, response);
+                }
+            );
+            inv.batch = m_pending_batch;
+
+            HZ_CLIENT_METRIC(inv.type = message.header.type;)
+
+            if (m_profiler && m_profiler->sample())
+                profile(inv, message.header.partition_id, buffer.size() - offset);
+
+            if (message::is_retryable_v<T> || m_reconnect_options.redo_operations)
+            {
+                auto encoded = buffer.data();
+
+                inv.encoded.assign(
+                    buffers_begin(encoded) + offset,
+                    buffers_end(encoded)
+                );
+            }
+
+            HZ_CLIENT_METRIC(++m_pending_messages;)
+            HZ_CLIENT_METRIC(
+                count_invocation(
+                    inv.type,
+                    buffer.size() - offset,
+                    inv.encoded.size(),
+                    allocations
+                );
+            )
+
+            register_for_backups(correlation_id, inv);
+            m_handlers.emplace(correlation_id, std::move(inv));
+
+            do_write();
+        },
+        token
+    );
+}
+
+template<typename T, typename CompletionToken>
+auto connection::submit(
+    message::request<T> message,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(boost::system::error_code, std::vector<char>)
+    >(
+        [
+            this,
+            message = std::move(message)
+        ]
+        (auto& composable) mutable
+        {
+            HZ_CLIENT_METRIC(auto allocations = metrics::allocations();)
+
+            submission s;
+
+            message.header.correlation_id = m_registry->next_correlation_id();
+
+            if (m_backup_aware.load(std::memory_order_relaxed))
+                message.header.flags |= message::frame_header::BACKUP_AWARE_FLAG;
+
+            {
+                boost::iostreams::stream_buffer<
+                    boost::iostreams::back_insert_device<byte_array_t>
+                > encoder {s.encoded};
+
+                rbs::serialize_le(message, encoder);
+            }
+
+            s.correlation_id = message.header.correlation_id;
+            s.retryable      = message::is_retryable_v<T>;
+            s.partition_id   = message.header.partition_id;
+
+            HZ_CLIENT_METRIC(s.type = message.header.type;)
+            s.callback       = make_shallow_copyable(
+                [
+                    composable = std::move(composable)
+                ]
+                (const boost::system::error_code& err, std::vector<char>& response) mutable
+                {
+                    composable.complete(err, std::move(response));
+                }
+            );
+
+            HZ_CLIENT_METRIC(s.allocations = metrics::allocations() - allocations;)
+
+            // Completed like any other submission, never on the producer's
+            // thread from within this call. The queue leaves `s` as it was.
+            if (!m_submissions.try_push(std::move(s)))
+            {
+                return boost::asio::post(
+                    m_sck.get_executor(),
+                    [this, callback = std::move(s.callback)]() mutable
+                    {
+                        invocation   inv;
+                        byte_array_t none;
+
+                        inv.callback = std::move(callback);
+                        inv.offload  = true;
+
+                        finish(inv, make_error_code(error::submission_queue_full), none);
+                    }
+                );
+            }
+
+            // Pairs with the fence in `drain_submissions`: either the drain
+            // sees this submission, or this sees the drain is over.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!m_drain_scheduled.exchange(true))
+                boost::asio::post(m_sck.get_executor(), [this] { drain_submissions(); });
+        },
+        token
+    );
+}
+
+inline void connection::close()
+{
+    if (m_state == link_state::closed)
+        return;
+
+    m_state = link_state::closed;
+    m_reconnect_timer.cancel();
+    m_flush_timer.cancel();
+    m_flush_armed = false;
+    m_backup_timer.cancel();
+    m_backup_timer_armed = false;
+    m_backup_deadlines.clear();
+
+    reset_link();
+    fail_handlers(make_error_code(error::connection_closed), false);
+}
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+inline const metrics::connection_counters& connection::counters() const
+{
+    return m_counters;
+}
+
+inline void connection::count_invocation(
+    std::int32_t type,
+    std::size_t request_bytes,
+    std::size_t bytes_copied,
+    std::uint64_t allocations_before
+)
+{
+    auto& x = m_counters.by_type[type];
+
+    ++x.invocations;
+    x.request_bytes += request_bytes;
+    x.bytes_copied  += bytes_copied;
+    x.allocations   += metrics::allocations() - allocations_before;
+}
+
+inline void connection::count_response(
+    std::int32_t type,
+    std::size_t response_bytes,
+    std::uint64_t allocations_before
+)
+{
+    auto& x = m_counters.by_type[type];
+
+    x.response_bytes += response_bytes;
+
+    // Assembling the response out of its frames copies it once.
+    x.bytes_copied   += response_bytes;
+    x.allocations    += metrics::allocations() - allocations_before;
+}
+
+inline void connection::count_read(std::size_t n)
+{
+    ++m_counters.read_calls;
+    m_counters.bytes_read += n;
+}
+
+inline void connection::count_write(std::size_t n, std::uint64_t messages)
+{
+    ++m_counters.write_calls;
+    m_counters.bytes_written    += n;
+    m_counters.messages_written += messages;
+}
+#endif
+
+inline void connection::set_reconnect_handler(std::function<void(error_code)> handler)
+{
+    m_reconnect_handler = std::move(handler);
+}
+
+inline void connection::set_invocation_registry(invocation_registry* registry)
+{
+    m_registry = registry ? registry : &m_own_registry;
+}
+
+inline void connection::set_capture(capture_writer* capture)
+{
+    m_capture = capture;
+}
+
+inline void connection::set_profiler(skew_profiler* profiler)
+{
+    m_profiler = profiler;
+}
+
+inline skew_profiler* connection::profiler() const
+{
+    return m_profiler;
+}
+
+inline void connection::set_flush_policy(flush_policy policy)
+{
+    m_flush_policy = std::move(policy);
+
+    if (m_state == link_state::connected)
+        apply_socket_options();
+}
+
+inline void connection::set_completion_executor(boost::asio::any_io_executor executor)
+{
+    m_completion_executor = std::move(executor);
+}
+
+inline void connection::set_serialization_executor(
+    boost::asio::any_io_executor executor,
+    std::size_t threshold
+)
+{
+    m_serialization_executor  = std::move(executor);
+    m_serialization_threshold = threshold;
+}
+
+inline void connection::set_busy_poll(std::chrono::microseconds duration)
+{
+    m_busy_poll = duration;
+
+    if (m_state == link_state::connected)
+        apply_socket_options();
+}
+
+inline void connection::hold_writes()
+{
+    ++m_write_holds;
+}
+
+inline void connection::release_writes()
+{
+    if (m_write_holds > 0 && --m_write_holds == 0)
+        do_write();
+}
+
+inline std::uint64_t connection::writes_started() const
+{
+    return m_write_batch;
+}
+
+inline boost::system::error_code connection::unavailable_reason() const
+{
+    switch (m_state)
+    {
+        case link_state::disconnected:
+            return make_error_code(error::not_connected);
+        case link_state::closed:
+            return make_error_code(error::connection_closed);
+        default:
+            return {};
+    }
+}
+
+inline void connection::drain_submissions()
+{
+    for (;;)
+    {
+        submission s;
+
+        hold_writes();
+
+        while (m_submissions.try_pop(s))
+            enqueue(std::move(s));
+
+        release_writes();
+
+        m_drain_scheduled.store(false);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // A submission pushed after the last pop whose producer still saw
+        // the drain scheduled is picked up here, otherwise its producer
+        // posts a new drain.
+        if (m_submissions.empty() || m_drain_scheduled.exchange(true))
+            return;
+    }
+}
+
+inline void connection::enqueue(submission s)
+{
+    invocation inv;
+
+    inv.callback = std::move(s.callback);
+    inv.batch    = m_pending_batch;
+    inv.offload  = true;
+
+    if (auto reason = unavailable_reason())
+    {
+        byte_array_t none;
+
+        return finish(inv, reason, none);
+    }
+
+    HZ_CLIENT_METRIC(auto allocations = metrics::allocations() - s.allocations;)
+
+    pending_buffer().sputn(s.encoded.data(), s.encoded.size());
+
+    if (m_capture)
+        m_capture->record(capture_direction::outgoing, s.encoded.data(), s.encoded.size());
+
+    HZ_CLIENT_METRIC(inv.type = s.type;)
+
+    if (m_profiler && m_profiler->sample())
+        profile(inv, s.partition_id, s.encoded.size());
+
+    HZ_CLIENT_METRIC(++m_pending_messages;)
+    HZ_CLIENT_METRIC(count_invocation(s.type, s.encoded.size(), s.encoded.size(), allocations);)
+
+    if (s.retryable || m_reconnect_options.redo_operations)
+        inv.encoded = std::move(s.encoded);
+
+    register_for_backups(s.correlation_id, inv);
+    m_handlers.emplace(s.correlation_id, std::move(inv));
+}
+
+inline void connection::complete_shared(
+    const std::string& key,
+    error_code err,
+    byte_array_t& response
+)
+{
+    auto shared = m_shared.find(key);
+
+    if (shared == end(m_shared))
+        return;
+
+    // Taken over first, the waiters may issue the same request again.
+    auto waiters = std::move(shared->second);
+
+    m_shared.erase(shared);
+
+    for (std::size_t i = 0; i + 1 < waiters.size(); ++i)
+    {
+        auto copy = response;
+
+        waiters[i](err, copy);
+    }
+
+    waiters.back()(err, response);
+}
+
+inline void connection::start_reader()
+{
+    boost::asio::async_read(
+        m_sck,
+        m_read_buffer,
+        boost::asio::transfer_exactly(message::frame_header::HEADER_SIZE),
+        [this, generation = m_generation](const error_code& err, [[maybe_unused]] std::size_t n)
+        {
+            HZ_CLIENT_METRIC(count_read(n);)
+
+            if (generation == m_generation)
+                on_frame_header_read(err);
+        }
+    );
+}
+
+inline void connection::do_write()
+{
+   if (m_write_in_progress ||
+       m_write_holds > 0 ||
+       m_state != link_state::connected ||
+       ready_bytes() == 0)
+        return;
+
+    auto delay = flush_delay();
+
+    if (delay.count() == 0)
+        return write_now();
+
+    // A write which becomes due earlier is not waited for, a timer which
+    // fires after it finds what is pending by then.
+    if (m_flush_armed)
+        return;
+
+    m_flush_armed = true;
+
+    m_flush_timer.expires_after(delay);
+    m_flush_timer.async_wait(
+        [this](const error_code& err)
+        {
+            if (err)
+                return;
+
+            m_flush_armed = false;
+
+            write_now();
+        }
+    );
+}
+
+inline std::chrono::microseconds connection::flush_delay()
+{
+    using std::chrono::microseconds;
+    using std::chrono::duration_cast;
+
+    if (m_flush_policy.mode == flush_mode::immediate ||
+        pending_bytes() >= m_flush_policy.max_pending_bytes)
+        return microseconds {0};
+
+    if (m_flush_policy.mode == flush_mode::size_or_deadline)
+        return m_flush_policy.max_delay;
+
+    // Nothing else in flight, or no round trip observed yet.
+    if (m_handlers.size() <= 1 || m_rtt.count() == 0)
+        return microseconds {0};
+
+    auto delay = duration_cast<microseconds>(m_rtt * m_flush_policy.rtt_fraction);
+
+    return std::min(delay, m_flush_policy.max_delay);
+}
+
+inline void connection::write_now()
+{
+   if (m_write_in_progress ||
+       m_write_holds > 0 ||
+       m_state != link_state::connected ||
+       ready_bytes() == 0)
+        return;
+
+    m_write_in_progress = true;
+
+    if (m_flush_policy.mode == flush_mode::adaptive)
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        // A probe whose responses are not coming, such as those of blocking
+        // operations, is given up on.
+        if (!m_rtt_probing || now - m_rtt_probe_started > std::chrono::seconds {1})
+        {
+            m_rtt_probing       = true;
+            m_rtt_probe_batch   = m_write_batch;
+            m_rtt_probe_started = now;
+        }
+    }
+
+    if (m_flush_policy.cork && !m_corked)
+        set_cork(true);
+
+    toggle_write_buffer();
+
+    auto& detached = m_detached[m_active_buffer_idx];
+    auto  length   = writing_buffer().size();
+    auto  encoding = std::find_if(
+        begin(detached),
+        end(detached),
+        [](const detached_message& x) { return x.encoded.empty(); }
+    );
+
+    // What follows a message still being encoded goes back to the pending
+    // buffer, which the last write left empty, and waits for it there.
+    if (encoding != end(detached))
+    {
+        length        = encoding->first;
+        m_write_batch = encoding->batch;
+
+        auto tail = writing_buffer().data() + length;
+
+        pending_buffer().commit(boost::asio::buffer_copy(pending_buffer().prepare(tail.size()), tail));
+
+        for (auto it = encoding; it != end(detached); ++it)
+        {
+            it->first -= length;
+            m_detached[!m_active_buffer_idx].push_back(std::move(*it));
+        }
+
+        detached.erase(encoding, end(detached));
+    }
+    else
+    {
+        m_write_batch = ++m_pending_batch;
+    }
+
+    HZ_CLIENT_METRIC(auto messages = std::exchange(m_pending_messages, 0);)
+
+    auto on_written = [
+        this,
+        generation = m_generation
+        HZ_CLIENT_METRIC(, messages)
+    ]
+    (const boost::system::error_code& ec, [[maybe_unused]] std::size_t n){
+        if (generation != m_generation)
+            return;
+
+        HZ_CLIENT_METRIC(count_write(n, messages);)
+
+        m_write_in_progress = false;
+
+        if (ec)
+            return on_connection_error(ec);
+
+        writing_buffer().consume(writing_buffer().size());
+        m_detached[m_active_buffer_idx].clear();
+        do_write();
+
+        if (m_corked && !m_write_in_progress)
+            set_cork(false);
+    };
+
+    if (detached.empty())
+    {
+        boost::asio::async_write(m_sck, boost::asio::buffer(writing_buffer().data(), length), std::move(on_written));
+
+        return;
+    }
+
+    // The detached messages are spliced in where they were enqueued.
+    auto buffered = writing_buffer().data();
+    auto data     = static_cast<const char*>(buffered.data());
+
+    std::vector<boost::asio::const_buffer> buffers;
+    std::size_t                            written {0};
+
+    for (const auto& x : detached)
+    {
+        buffers.emplace_back(data + written, x.first - written);
+        buffers.emplace_back(x.encoded.data(), x.encoded.size());
+
+        written = x.first;
+    }
+
+    buffers.emplace_back(data + written, length - written);
+
+    boost::asio::async_write(m_sck, buffers, std::move(on_written));
+}
+
+inline void connection::apply_socket_options()
+{
+    error_code ignored;
+
+    if (m_flush_policy.no_delay)
+        m_sck.set_option(boost::asio::ip::tcp::no_delay {*m_flush_policy.no_delay}, ignored);
+
+    if (m_corked && !m_flush_policy.cork)
+        set_cork(false);
+
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+    using busy_poll = boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>;
+
+    if (m_busy_poll.count() > 0)
+        m_sck.set_option(busy_poll {int(m_busy_poll.count())}, ignored);
+#endif
+}
+
+inline void connection::set_cork(bool on)
+{
+    m_corked = on;
+
+#if defined(__linux__)
+    using cork = boost::asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_CORK>;
+
+    error_code ignored;
+
+    m_sck.set_option(cork {on}, ignored);
+#endif
+}
+
+inline void connection::on_frame_header_read(const error_code& err)
+{
+    if (err)
+        return on_connection_error(err);
+
+    message::frame_header header;
+    rbs::stream ss {m_read_buffer, rbs::endian::little};
+
+    ss >> header;
+    ss << header;
+
+    bool is_final { bool(header.flags & message::frame_header::IS_FINAL_FLAG) };
+
+    if (header.length > message::frame_header::HEADER_SIZE)
+    {
+        int needs_to_be_read {header.length - message::frame_header::HEADER_SIZE};
+
+        boost::asio::async_read(
+            m_sck,
+            m_read_buffer,
+            boost::asio::transfer_exactly(needs_to_be_read),
+            [
+                this,
+                generation = m_generation,
+                length     = header.length,
+                is_final
+            ]
+            (const error_code& err, [[maybe_unused]] std::size_t n)
+            {
+                HZ_CLIENT_METRIC(count_read(n);)
+
+                if (generation == m_generation)
+                    on_frame_read(err, length, is_final);
+            }
+        );
+    }
+    else
+    {
+        on_frame_read(error_code{}, message::frame_header::HEADER_SIZE, is_final);
+    }    
+}
+
+inline void connection::on_frame_read(const error_code& err, int n_read, bool is_final)
+{
+    if (err)
+        return on_connection_error(err);
+
+    HZ_CLIENT_METRIC(++m_counters.frames_read;)
+
+    HZ_CLIENT_METRIC(
+        if (m_received_message.empty())
+            m_message_allocations = metrics::allocations();
+    )
+
+    auto buffer = m_read_buffer.data();
+
+    m_received_message.insert(
+        end(m_received_message),
+        buffers_begin(buffer),
+        buffers_end(buffer)
+    );
+    m_read_buffer.consume(n_read);
+
+    if (is_final)
+    {
+        boost::iostreams::stream_buffer<boost::iostreams::array_source> rd_buffer {
+            data(m_received_message),
+            size(m_received_message)
+        };
+
+        rbs::stream is {rd_buffer, rbs::endian::little};
+
+        message::initial_frame iframe;
+
+        is >> iframe;
+
+        if (m_capture)
+        {
+            m_capture->record(
+                capture_direction::incoming,
+                m_received_message.data(),
+                m_received_message.size()
+            );
+        }
+
+        auto handler = m_handlers.find(iframe.correlation_id);
+
+        auto generation = m_generation;
+
+        if (iframe.flags & message::frame_header::BACKUP_EVENT_FLAG)
+        {
+            on_backup_event();
+        }
+        else if (iframe.flags & message::frame_header::IS_EVENT_FLAG)
+        {
+            auto listener = m_listeners.find(iframe.correlation_id);
+
+            // Both are taken over as the listener may tear the link down.
+            if (listener != end(m_listeners))
+            {
+                auto on_event = listener->second;
+                auto event    = std::move(m_received_message);
+
+                on_event(event);
+            }
+        }
+        else if (handler != end(m_handlers))
+        {
+            if (m_rtt_probing && handler->second.batch == m_rtt_probe_batch)
+            {
+                auto sample = std::chrono::steady_clock::now() - m_rtt_probe_started;
+
+                m_rtt         = m_rtt.count() == 0 ? sample : m_rtt + (sample - m_rtt) / 8;
+                m_rtt_probing = false;
+            }
+
+            HZ_CLIENT_METRIC(
+                count_response(
+                    handler->second.type,
+                    m_received_message.size(),
+                    m_message_allocations
+                );
+            )
+
+            if (handler->second.profiled && m_profiler)
+            {
+                m_profiler->record_response(
+                    handler->second.partition_id,
+                    m_received_message.size(),
+                    std::chrono::steady_clock::now() - handler->second.queued_at
+                );
+            }
+
+            auto acks = std::int32_t(message::backup_acks(m_received_message));
+
+            if (acks > handler->second.backups_acked)
+            {
+                hold_for_backups(iframe.correlation_id, handler->second, acks);
+            }
+            else
+            {
+                auto inv = std::move(handler->second);
+
+                m_handlers.erase(handler);
+                finish(inv, boost::system::error_code{}, m_received_message);
+            }
+        }
+
+        // The callback may have torn the link down, in which case a reader
+        // of the new link is already started.
+        if (generation != m_generation)
+            return;
+
+        m_received_message.clear();
+    }
+
+    start_reader();
+}
+
+inline void connection::register_for_backups(std::int64_t correlation_id, invocation& inv)
+{
+    if (!m_backup_aware.load(std::memory_order_relaxed))
+        return;
+
+    inv.registered_id = correlation_id;
+
+    m_registry->add(correlation_id, *this);
+}
+
+inline void connection::hold_for_backups(
+    std::int64_t correlation_id,
+    invocation& inv,
+    std::int32_t acks
+)
+{
+    inv.backups_expected = acks;
+    inv.response         = std::move(m_received_message);
+
+    m_backup_deadlines.emplace_back(
+        correlation_id,
+        std::chrono::steady_clock::now() + m_backup_ack_timeout
+    );
+
+    arm_backup_timer();
+}
+
+inline void connection::on_backup_event()
+{
+    message::backup_event event;
+
+    if (message::decode_event(m_received_message, event))
+        return;
+
+    // The invocation was made over the connection to the owner, which is
+    // this one only if the backup is on the owner as well.
+    auto owner = m_registry->owner_of(event.source_correlation_id);
+
+    // Late for an invocation which is already complete.
+    if (owner)
+        owner->on_backup_ack(event.source_correlation_id);
+}
+
+inline void connection::on_backup_ack(std::int64_t correlation_id)
+{
+    auto it = m_handlers.find(correlation_id);
+
+    if (it == end(m_handlers))
+        return;
+
+    auto& inv = it->second;
+
+    ++inv.backups_acked;
+
+    if (inv.backups_expected > 0 && inv.backups_acked >= inv.backups_expected)
+        complete_held(it);
+}
+
+inline void connection::complete_held(handlers_t::iterator it)
+{
+    auto inv = std::move(it->second);
+
+    m_handlers.erase(it);
+    finish(inv, boost::system::error_code{}, inv.response);
+}
+
+inline void connection::profile(invocation& inv, std::int32_t partition_id, std::size_t bytes)
+{
+    inv.profiled     = true;
+    inv.partition_id = partition_id;
+    inv.queued_at    = std::chrono::steady_clock::now();
+
+    m_profiler->record_request(partition_id, bytes);
+}
+
+template<typename T>
+void connection::serialize_detached(
+    message::request<T> message,
+    std::size_t size,
+    invocation_cb_t callback
+)
+{
+    invocation inv;
+
+    inv.callback = std::move(callback);
+
+    HZ_CLIENT_METRIC(inv.type = message.header.type;)
+
+    bool keep_copy = message::is_retryable_v<T> || m_reconnect_options.redo_operations;
+
+    // Messages invoked meanwhile wait behind it, in the batch it starts.
+    m_detached[!m_active_buffer_idx].push_back(
+        {pending_buffer().size(), std::int64_t(message.header.correlation_id), ++m_pending_batch, {}}
+    );
 
-    return boost::asio::async_compose<
-        CompletionToken, void(boost::system::error_code, std::vector<char>)
-    >(
+    boost::asio::post(
+        *m_serialization_executor,
         [
             this,
-            state   = starting,
-            message = std::move(message)
+            message = std::move(message),
+            size,
+            keep_copy,
+            inv     = std::move(inv)
         ]
-        (
-            auto& composable,
-            const boost::system::error_code& err = {},
-            std::vector<char> response = {}
-        ) mutable
+        () mutable
         {
-            if (!err)
-            {
-                switch (state)
-                {
-                    case starting:
-                    {
-                        state = response_awaiting;
-
-                        message.header.correlation_id = m_correlation_id++;
-                        rbs::serialize_le(message, pending_buffer());
-
-                        m_handlers.emplace(
-                            std::make_pair(
-                                message.header.correlation_id,
-                                make_shallow_copyable(
-                                    [
-                                        composable = std::move(composable)
-                                    ]
-                                    (const boost::system::error_code& err, std::vector<char> response) mutable
-                                    {
-                                        composable(err, move(response));
-                                    }
-                                )
-                            )
-                        );
+            byte_array_t encoded;
 
-                        do_write();
+            encoded.reserve(size);
 
-                        return;
-                    }
-                }
+            {
+                boost::iostreams::stream_buffer<
+                    boost::iostreams::back_insert_device<byte_array_t>
+                > encoder {encoded};
+
+                rbs::serialize_le(message, encoder);
             }
 
-            return composable.complete(err, move(response));
-        },
-        token
+            if (keep_copy)
+                inv.encoded = encoded;
+
+            boost::asio::post(
+                m_sck.get_executor(),
+                [
+                    this,
+                    correlation_id = message.header.correlation_id,
+                    partition_id   = message.header.partition_id,
+                    encoded        = std::move(encoded),
+                    inv            = std::move(inv)
+                ]
+                () mutable
+                {
+                    enqueue_detached(correlation_id, partition_id, std::move(encoded), std::move(inv));
+                }
+            );
+        }
     );
 }
 
-inline void connection::start_reader()
+inline void connection::enqueue_detached(
+    std::int64_t correlation_id,
+    std::int32_t partition_id,
+    byte_array_t encoded,
+    invocation inv
+)
 {
-    boost::asio::async_read(
-        m_sck,
-        m_read_buffer,
-        boost::asio::transfer_exactly(message::frame_header::HEADER_SIZE),
-        bind(
-            &connection::on_frame_header_read,
-            this,
-            std::placeholders::_1
-        )
+    auto& detached = m_detached[!m_active_buffer_idx];
+    auto  reserved = std::find_if(
+        begin(detached),
+        end(detached),
+        [correlation_id](const detached_message& x) { return x.correlation_id == correlation_id; }
     );
+
+    // Its place is gone along with the pending buffer once the connection
+    // is closed or given up on.
+    if (reserved == end(detached))
+    {
+        byte_array_t none;
+        auto         reason = unavailable_reason();
+
+        m_listeners.erase(correlation_id);
+
+        return finish(inv, reason ? reason : make_error_code(error::connection_lost), none);
+    }
+
+    if (m_capture)
+        m_capture->record(capture_direction::outgoing, encoded.data(), encoded.size());
+
+    if (m_profiler && m_profiler->sample())
+        profile(inv, partition_id, encoded.size());
+
+    HZ_CLIENT_METRIC(++m_pending_messages;)
+    HZ_CLIENT_METRIC(++m_counters.detached_serializations;)
+    HZ_CLIENT_METRIC(count_invocation(inv.type, encoded.size(), inv.encoded.size(), metrics::allocations());)
+
+    inv.batch = reserved->batch;
+
+    reserved->encoded = std::move(encoded);
+
+    register_for_backups(correlation_id, inv);
+    m_handlers.emplace(correlation_id, std::move(inv));
+
+    do_write();
 }
 
-inline void connection::do_write()
+inline void connection::finish(invocation& inv, error_code err, byte_array_t& response)
 {
-   if (m_write_in_progress)
-        return;
+    if (inv.registered_id != 0)
+        m_registry->remove(inv.registered_id);
 
-    m_write_in_progress = true;
+    if (!inv.offload || !m_completion_executor)
+        return inv.callback(err, response);
 
-    toggle_write_buffer();
-    boost::asio::async_write(
-        m_sck,
-        writing_buffer().data(),
-        [this](const boost::system::error_code& ec, std::size_t n){
-            m_write_in_progress = false;
-            if (ec) {
-                throw std::runtime_error {
-                    "Write error."
-                };
+    auto& queue = *m_completions;
+    bool  wake {false};
+
+    {
+        std::lock_guard lock {queue.mutex};
+
+        queue.ready.push_back({std::move(inv.callback), err, std::move(response)});
+
+        wake = !std::exchange(queue.draining, true);
+    }
+
+    HZ_CLIENT_METRIC(++m_counters.offloaded_completions;)
+
+    if (wake)
+    {
+        HZ_CLIENT_METRIC(++m_counters.completion_wakeups;)
+
+        boost::asio::post(
+            *m_completion_executor,
+            [queue = m_completions]
+            {
+                run_completions(*queue);
+            }
+        );
+    }
+}
+
+inline void connection::run_completions(completion_queue& queue)
+{
+    std::vector<completion> batch;
+
+    for (;;)
+    {
+        batch.clear();
+
+        {
+            std::lock_guard lock {queue.mutex};
+
+            if (queue.ready.empty())
+            {
+                queue.draining = false;
+
+                return;
             }
 
-            writing_buffer().consume(n);
+            std::swap(batch, queue.ready);
+        }
+
+        for (auto& c : batch)
+            c.callback(c.err, c.response);
+    }
+}
+
+inline void connection::arm_backup_timer()
+{
+    if (m_backup_timer_armed || m_backup_deadlines.empty())
+        return;
+
+    m_backup_timer_armed = true;
+
+    m_backup_timer.expires_at(m_backup_deadlines.front().second);
+    m_backup_timer.async_wait(
+        [this](const error_code& err)
+        {
+            if (err)
+                return;
+
+            m_backup_timer_armed = false;
+
+            on_backup_timeout();
         }
     );
 }
 
-inline void connection::on_frame_header_read(const error_code& err)
+inline void connection::on_backup_timeout()
 {
-    message::frame_header header;
-    rbs::stream ss {m_read_buffer, rbs::endian::little};
+    auto now = std::chrono::steady_clock::now();
 
-    ss >> header;
-    ss << header;
+    while (!m_backup_deadlines.empty() && m_backup_deadlines.front().second <= now)
+    {
+        auto it = m_handlers.find(m_backup_deadlines.front().first);
 
-    bool is_final { bool(header.flags & message::frame_header::IS_FINAL_FLAG) };
+        m_backup_deadlines.pop_front();
 
-    if (header.length > message::frame_header::HEADER_SIZE)
+        // Acked in time, or completed as the link went down.
+        if (it == end(m_handlers) || it->second.backups_expected == 0)
+            continue;
+
+        HZ_CLIENT_METRIC(++m_counters.backup_ack_timeouts;)
+
+        complete_held(it);
+    }
+
+    arm_backup_timer();
+}
+
+inline void connection::toggle_write_buffer()
+{
+    m_active_buffer_idx = !m_active_buffer_idx;
+}
+
+inline boost::asio::streambuf& connection::writing_buffer()
+{
+    return m_write_buffers[m_active_buffer_idx];
+}
+
+inline boost::asio::streambuf& connection::pending_buffer()
+{
+    return m_write_buffers[!m_active_buffer_idx];
+}
+
+inline std::size_t connection::pending_bytes()
+{
+    auto n = pending_buffer().size();
+
+    for (const auto& x : m_detached[!m_active_buffer_idx])
+        n += x.encoded.size();
+
+    return n;
+}
+
+inline std::size_t connection::ready_bytes()
+{
+    std::size_t n {0};
+
+    for (const auto& x : m_detached[!m_active_buffer_idx])
     {
-        int needs_to_be_read {header.length - message::frame_header::HEADER_SIZE};
+        if (x.encoded.empty())
+            return n + x.first;
 
-        boost::asio::async_read(
-            m_sck,
-            m_read_buffer,
-            boost::asio::transfer_exactly(needs_to_be_read),
-            bind(
-                &connection::on_frame_read,
-                this,
-                std::placeholders::_1,
-                header.length,
-                is_final
-            )
-        );
+        n += x.encoded.size();
     }
-    else
+
+    return n + pending_buffer().size();
+}
+
+inline void connection::on_connection_error(const error_code&)
+{
+    switch (m_state)
     {
-        on_frame_read(error_code{}, message::frame_header::HEADER_SIZE, is_final);
-    }    
+        case link_state::connected:
+            break;
+        case link_state::reconnecting:
+            return on_reconnect_failed();
+        default:
+            return;
+    }
+
+    reset_link();
+
+    // Reconnecting is only possible once the credentials are known.
+    if (!m_auth)
+    {
+        m_state = link_state::disconnected;
+        fail_handlers(make_error_code(error::connection_lost), false);
+
+        return;
+    }
+
+    m_state              = link_state::reconnecting;
+    m_backoff            = m_reconnect_options.initial_backoff;
+    m_reconnect_attempts = 0;
+
+    fail_handlers(make_error_code(error::connection_lost), true);
+    schedule_reconnect();
 }
 
-inline void connection::on_frame_read(const error_code& err, int n_read, bool is_final)
+inline void connection::schedule_reconnect()
 {
-    if (err) {
-        throw std::runtime_error {
-            "Error occurred."
-        };
+    if (m_reconnect_options.max_attempts >= 0 &&
+        m_reconnect_attempts >= m_reconnect_options.max_attempts)
+    {
+        m_state = link_state::disconnected;
+        fail_handlers(make_error_code(error::connection_lost), false);
+
+        if (m_reconnect_handler)
+            m_reconnect_handler(make_error_code(error::connection_lost));
+
+        return;
     }
 
-    auto buffer = m_read_buffer.data();
+    ++m_reconnect_attempts;
 
-    copy(
-        buffers_begin(buffer),
-        buffers_end(buffer),
-        back_inserter(m_received_message)
+    m_reconnect_timer.expires_after(m_backoff);
+    m_reconnect_timer.async_wait(
+        [this](const error_code& err)
+        {
+            if (!err && m_state == link_state::reconnecting)
+                reconnect();
+        }
     );
-    m_read_buffer.consume(n_read);
 
-    if (is_final)
+    using std::chrono::milliseconds;
+    using std::chrono::duration_cast;
+
+    m_backoff = std::min(
+        duration_cast<milliseconds>(m_backoff * m_reconnect_options.multiplier),
+        m_reconnect_options.max_backoff
+    );
+}
+
+inline void connection::reconnect()
+{
+    // A member which accepts the connection but never answers the
+    // handshake would hold the link in `reconnecting` otherwise.
+    m_reconnect_timer.expires_after(m_reconnect_options.authentication_timeout);
+    m_reconnect_timer.async_wait(
+        [this, generation = m_generation](const error_code& err)
+        {
+            if (err || generation != m_generation)
+                return;
+
+            on_reconnect_failed();
+        }
+    );
+
+    m_sck.async_connect(
+        m_endpoint,
+        [this, generation = m_generation](const error_code& err)
+        {
+            if (generation != m_generation)
+                return;
+
+            if (err)
+                return on_reconnect_failed();
+
+            apply_socket_options();
+
+            // A read of the previous link which completed right before it is
+            // torn down commits its bytes once its handler runs, so the
+            // buffer is only known to be clean from here on.
+            m_read_buffer.consume(m_read_buffer.size());
+            m_received_message.clear();
+
+            start_reader();
+            send_handshake();
+        }
+    );
+}
+
+inline void connection::send_handshake()
+{
+    message::request<message::authentication> req;
+
+    req.entity                = *m_auth;
+    req.header.correlation_id = m_registry->next_correlation_id();
+    m_handshake_id            = req.header.correlation_id;
+
+    m_handshake_buffer.sputn("CP2", 3);
+    rbs::serialize_le(req, m_handshake_buffer);
+
+    invocation inv;
+
+    inv.callback = [this](const error_code& err, byte_array_t& response)
     {
-        boost::iostreams::stream_buffer<boost::iostreams::array_source> rd_buffer {
-            data(m_received_message),
-            size(m_received_message)
-        };
+        // Failed by `close()`, nothing left to do.
+        if (err)
+            return;
 
-        rbs::stream is {rd_buffer, rbs::endian::little};
+        message::response<message::authentication> res;
 
-        message::initial_frame iframe;
+        if (message::decode_response(response, res) || res.status != 0)
+            return on_reconnect_failed();
 
-        is >> iframe;
+        m_partition_count = res.partition_count;
+        m_member_uuid     = res.member_uuid;
 
-        auto handler = m_handlers.find(iframe.correlation_id);
+        on_reconnected();
+    };
 
-        if (handler != end(m_handlers))
+    m_handlers.emplace(m_handshake_id, std::move(inv));
+
+    boost::asio::async_write(
+        m_sck,
+        m_handshake_buffer.data(),
+        [this, generation = m_generation](const error_code& err, std::size_t n)
         {
-            handler->second(boost::system::error_code{}, move(m_received_message));
-            m_handlers.erase(handler);
+            if (generation != m_generation)
+                return;
+
+            if (err)
+                return on_reconnect_failed();
+
+            m_handshake_buffer.consume(n);
         }
+    );
+}
+
+inline void connection::on_reconnected()
+{
+    m_reconnect_timer.cancel();
+
+    m_state              = link_state::connected;
+    m_backoff            = m_reconnect_options.initial_backoff;
+    m_reconnect_attempts = 0;
+
+    // Registrations renewed from the handler go out ahead of the resent
+    // invocations.
+    if (m_reconnect_handler)
+        m_reconnect_handler({});
+
+    if (m_state != link_state::connected)
+        return;
+
+    for (auto& [correlation_id, inv] : m_handlers)
+    {
+        if (!inv.resend)
+            continue;
+
+        pending_buffer().sputn(inv.encoded.data(), inv.encoded.size());
+
+        HZ_CLIENT_METRIC(++m_pending_messages;)
+
+        inv.resend = false;
+        inv.batch  = m_pending_batch;
     }
 
-    boost::asio::async_read(
-        m_sck,
-        m_read_buffer,
-        boost::asio::transfer_exactly(message::frame_header::HEADER_SIZE),
-        bind(
-            &connection::on_frame_header_read,
-            this,
-            std::placeholders::_1
-        )
-    );
+    do_write();
 }
 
-inline void connection::toggle_write_buffer()
+inline void connection::on_reconnect_failed()
 {
-    m_active_buffer_idx = !m_active_buffer_idx;
+    if (m_state != link_state::reconnecting)
+        return;
+
+    m_handlers.erase(m_handshake_id);
+
+    reset_link();
+    schedule_reconnect();
 }
 
-inline boost::asio::streambuf& connection::writing_buffer()
+inline void connection::reset_link()
 {
-    return m_write_buffers[m_active_buffer_idx];
+    ++m_generation;
+
+    error_code ignored;
+
+    m_sck.close(ignored);
+
+    m_write_in_progress = false;
+    m_corked            = false;
+    m_rtt_probing       = false;
+
+    writing_buffer().consume(writing_buffer().size());
+    m_detached[m_active_buffer_idx].clear();
+    m_read_buffer.consume(m_read_buffer.size());
+    m_handshake_buffer.consume(m_handshake_buffer.size());
+    m_received_message.clear();
+
+    // Registrations are bound to the link, the member forgets them.
+    m_listeners.clear();
+    m_backup_aware.store(false, std::memory_order_relaxed);
 }
 
-inline boost::asio::streambuf& connection::pending_buffer()
+inline void connection::fail_handlers(error_code err, bool keep_retryable)
 {
-    return m_write_buffers[!m_active_buffer_idx];
+    std::vector<invocation> failed;
+    std::vector<invocation> held;
+
+    for (auto it = begin(m_handlers); it != end(m_handlers);)
+    {
+        auto& inv    = it->second;
+        bool  unsent = inv.batch >= m_write_batch;
+
+        // The owner has applied it, only acks of its backups are missing.
+        if (inv.backups_expected > 0)
+        {
+            held.push_back(std::move(inv));
+            it = m_handlers.erase(it);
+
+            continue;
+        }
+
+        // Messages still sitting in the pending buffer never reached the
+        // member, so they are safe to be sent whatever their kind is.
+        if (keep_retryable && (unsent || !inv.encoded.empty()))
+        {
+            inv.resend = !unsent;
+            ++it;
+
+            continue;
+        }
+
+        failed.push_back(std::move(inv));
+        it = m_handlers.erase(it);
+    }
+
+    if (!keep_retryable)
+    {
+        pending_buffer().consume(pending_buffer().size());
+        m_detached[!m_active_buffer_idx].clear();
+    }
+
+    byte_array_t none;
+
+    for (auto& inv : failed)
+        finish(inv, err, none);
+
+    for (auto& inv : held)
+        finish(inv, error_code {}, inv.response);
 }
 
 template<typename CompletionToken>
@@ -263,6 +1744,12 @@ auto connection::async_connect(
                     case connecting:
                     {
                         state = start_read;
+
+                        m_endpoint = host;
+                        m_state    = link_state::connected;
+
+                        apply_socket_options();
+
                         start_reader();
 
                         composable();
@@ -326,16 +1813,31 @@ auto connection::async_authenticate(
 
                         message::request<message::authentication> message;
 
-                        message.entity = std::move(req);
+                        message.entity = req;
 
                         invoke(
                             std::move(message),
                             make_shallow_copyable(
-                                [composable = std::move(composable)](
+                                [this, auth = std::move(req), composable = std::move(composable)](
                                     const boost::system::error_code& err,
                                     std::vector<char> response
                                 ) mutable
                                 {
+                                    if (err)
+                                        return composable(err);
+
+                                    message::response<message::authentication> res;
+
+                                    if (auto ec = message::decode_response(response, res))
+                                        return composable(ec);
+
+                                    if (res.status != 0)
+                                        return composable(make_error_code(error::authentication_failed));
+
+                                    m_partition_count = res.partition_count;
+                                    m_member_uuid     = res.member_uuid;
+                                    m_auth            = std::move(auth);
+
                                     composable(err);
                                 }
                             )
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+namespace hz_client
+{
+
+class connection;
+
+// What the connections of a client share about their invocations: the
+// correlation ids, handed out once across all of them so that an id names
+// a single invocation client-wide, and the connection each backup-aware
+// invocation in flight was made over. The acks of its backups come from
+// the backup members, i.e. over the connections to them, and are routed
+// back to it through here.
+//
+// Ids may be taken from any thread, the rest is only to be used from the
+// thread running the io_context.
+class invocation_registry
+{
+public:
+
+    invocation_registry() = default;
+
+    invocation_registry(const invocation_registry&) = delete;
+    invocation_registry& operator=(const invocation_registry&) = delete;
+
+    std::uint64_t next_correlation_id()
+    {
+        return m_correlation_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void add(std::int64_t correlation_id, connection& owner)
+    {
+        m_owners[correlation_id] = &owner;
+    }
+
+    void remove(std::int64_t correlation_id)
+    {
+        m_owners.erase(correlation_id);
+    }
+
+    // Null once the invocation is complete.
+    connection* owner_of(std::int64_t correlation_id) const
+    {
+        auto it = m_owners.find(correlation_id);
+
+        return it == m_owners.end() ? nullptr : it->second;
+    }
+
+private:
+
+    std::atomic<std::uint64_t>                     m_correlation_id {1};
+    std::unordered_map<std::int64_t, connection*> m_owners;
+};
+
+}
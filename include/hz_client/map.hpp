@@ -0,0 +1,774 @@
+#pragma once
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <unordered_map>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/compact.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/compression.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+// Puts to the same key issued while coalescing are merged into a single
+// put of the latest value. Every merged put completes with the outcome of
+// the one which went out, the previous value included.
+//
+// A get or an entry processor on a key whose put is pending sends that put
+// right away, ahead of it, so that it sees the value put. Queries, key sets
+// and the other reads spanning many keys do not: they may miss the pending
+// puts unless `map::flush` is called before them.
+struct write_coalescing_options
+{
+    bool enabled {false};
+
+    // Pending puts are sent at the latest this long after the first one.
+    std::chrono::microseconds window {std::chrono::milliseconds {1}};
+
+    // Or as soon as this many distinct keys are pending.
+    std::size_t max_keys {1024};
+};
+
+struct map_options
+{
+    // Values at least `compression.threshold` bytes long are compressed
+    // before they are put. Compressed values are recognized and restored on
+    // the response path regardless of this setting. Compressed values are
+    // opaque to the members, entry processors and predicates included.
+    compression_options compression;
+
+    write_coalescing_options coalescing;
+
+    // Reads identical to one already in flight on the connection, a get of
+    // the same key or a query with the same predicate, wait for its
+    // response instead of being sent, so that a burst of reads of a hot key
+    // costs a single request. A read issued after a write completed may
+    // then join a read sent before it, and see the value from before the
+    // write.
+    bool share_reads {false};
+
+    // Registry the Compact keys and values given to the map are serialized
+    // with. Its schemas the cluster does not know yet are sent before the
+    // next invocation, which might carry a value of them. Has to outlive
+    // the map.
+    compact_schemas* schemas {nullptr};
+};
+
+class map
+{
+public:
+
+    inline map(connection& conn, std::string name, map_options options = {});
+
+    // Puts still pending for coalescing complete with
+    // `error::connection_closed`, without being sent.
+    inline ~map();
+
+    inline const std::string& name() const;
+
+    // Sends the puts pending for coalescing right away.
+    inline void flush();
+
+    template<typename CompletionToken>
+    auto async_put(
+        message::data key,
+        message::data value,
+        CompletionToken&& token
+    );
+
+    template<typename CompletionToken>
+    auto async_get(
+        message::data key,
+        CompletionToken&& token
+    );
+
+    // Runs the entry processor on the member owning `key` and completes
+    // with what the processor returns.
+    template<typename CompletionToken>
+    auto async_execute_on_key(
+        message::data key,
+        message::data entry_processor,
+        CompletionToken&& token
+    );
+
+    template<typename CompletionToken>
+    auto async_execute_on_keys(
+        std::vector<message::data> keys,
+        message::data entry_processor,
+        CompletionToken&& token
+    );
+
+    template<typename CompletionToken>
+    auto async_execute_on_entries(
+        message::data entry_processor,
+        std::optional<message::data> predicate,
+        CompletionToken&& token
+    );
+
+    // Predicate queries, with the predicate built from the types in
+    // `hz_client/query.hpp`. The whole result arrives in one response, use
+    // `paged_query` for results which may be large.
+    template<typename CompletionToken>
+    auto async_key_set(
+        message::data predicate,
+        CompletionToken&& token
+    );
+
+    template<typename CompletionToken>
+    auto async_values(
+        message::data predicate,
+        CompletionToken&& token
+    );
+
+    template<typename CompletionToken>
+    auto async_entry_set(
+        message::data predicate,
+        CompletionToken&& token
+    );
+
+    // Completes with the projection of every entry matching `predicate`,
+    // or of every entry without one.
+    template<typename CompletionToken>
+    auto async_project(
+        message::data projection,
+        std::optional<message::data> predicate,
+        CompletionToken&& token
+    );
+
+    template<typename CompletionToken>
+    auto async_aggregate(
+        message::data aggregator,
+        std::optional<message::data> predicate,
+        CompletionToken&& token
+    );
+
+private:
+
+    using entries_t = std::vector<std::pair<message::data, message::data>>;
+
+    using put_waiter_t = std::function<
+        void(boost::system::error_code, std::optional<message::data>)
+    >;
+
+    struct pending_put
+    {
+        message::data             key;
+        message::data             value;
+        std::vector<put_waiter_t> waiters;
+    };
+
+    using pending_puts_t = std::unordered_map<std::string, pending_put>;
+
+    inline bool schemas_unpublished() const;
+
+    // Partition of `key`, which is sampled into the connection's profiler.
+    inline std::int32_t partition_of(const message::data& key);
+    inline void coalesce_put(message::data key, message::data value, put_waiter_t waiter);
+
+    // Sends the put of `key` pending for coalescing, if any, ahead of what
+    // is invoked next.
+    inline void flush_key(const message::data& key);
+    inline void send_pending(pending_puts_t pending);
+    inline void send_puts(pending_puts_t pending, boost::system::error_code err);
+    inline void send_put(pending_put put);
+
+    static inline std::string coalescing_key(const message::data& key);
+
+    // Sends `req` and completes with what `extract` takes out of the
+    // decoded response.
+    template<typename Result, typename T, typename Extract, typename CompletionToken>
+    auto invoke_for(
+        message::request<T> req,
+        Extract extract,
+        CompletionToken&& token
+    );
+
+    static inline boost::system::error_code decompress_value(std::optional<message::data>& value);
+
+    static inline boost::system::error_code decompress_values(std::vector<message::data>& values);
+
+    static inline boost::system::error_code decompress_values(entries_t& entries);
+
+    connection& m_conn;
+    std::string m_name;
+    map_options m_options;
+
+    pending_puts_t            m_pending_puts;
+    boost::asio::steady_timer m_flush_timer;
+    bool                      m_flush_scheduled {false};
+};
+
+inline map::map(connection& conn, std::string name, map_options options)
+    :   m_conn {conn}
+    ,   m_name {std::move(name)}
+    ,   m_options {std::move(options)}
+    ,   m_flush_timer {conn.sck().get_executor()}
+{}
+
+inline map::~map()
+{
+    send_puts(std::exchange(m_pending_puts, {}), make_error_code(error::connection_closed));
+}
+
+inline const std::string& map::name() const
+{
+    return m_name;
+}
+
+inline void map::flush()
+{
+    if (m_flush_scheduled)
+    {
+        m_flush_scheduled = false;
+        m_flush_timer.cancel();
+    }
+
+    if (m_pending_puts.empty())
+        return;
+
+    send_pending(std::exchange(m_pending_puts, {}));
+}
+
+template<typename CompletionToken>
+auto map::async_put(
+    message::data key,
+    message::data value,
+    CompletionToken&& token
+)
+{
+    if (m_options.coalescing.enabled)
+    {
+        return boost::asio::async_compose<
+            CompletionToken, void(boost::system::error_code, std::optional<message::data>)
+        >(
+            [
+                this,
+                key   = std::move(key),
+                value = std::move(value)
+            ]
+            (auto& composable) mutable
+            {
+                // Taken out before `composable`, which holds them, is moved.
+                auto k = std::move(key);
+                auto v = std::move(value);
+
+                coalesce_put(
+                    std::move(k),
+                    std::move(v),
+                    make_shallow_copyable(
+                        [composable = std::move(composable)](
+                            boost::system::error_code err,
+                            std::optional<message::data> previous
+                        ) mutable
+                        {
+                            composable.complete(err, std::move(previous));
+                        }
+                    )
+                );
+            },
+            token
+        );
+    }
+
+    message::request<message::map_put> req;
+
+    req.header.partition_id = partition_of(key);
+    req.entity = {
+        m_name,
+        std::move(key),
+        compress(std::move(value), m_options.compression)
+    };
+
+    return invoke_for<std::optional<message::data>>(
+        std::move(req),
+        [](auto& res, auto& value)
+        {
+            value = std::move(res.previous);
+
+            return decompress_value(value);
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_get(
+    message::data key,
+    CompletionToken&& token
+)
+{
+    if (!m_pending_puts.empty())
+        flush_key(key);
+
+    message::request<message::map_get> req;
+
+    req.header.partition_id = partition_of(key);
+    req.entity = {m_name, std::move(key)};
+
+    return invoke_for<std::optional<message::data>>(
+        std::move(req),
+        [](auto& res, auto& value)
+        {
+            value = std::move(res.value);
+
+            return decompress_value(value);
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_execute_on_key(
+    message::data key,
+    message::data entry_processor,
+    CompletionToken&& token
+)
+{
+    if (!m_pending_puts.empty())
+        flush_key(key);
+
+    message::request<message::execute_on_key> req;
+
+    req.header.partition_id = partition_of(key);
+    req.entity = {m_name, std::move(entry_processor), std::move(key)};
+
+    return invoke_for<std::optional<message::data>>(
+        std::move(req),
+        [](auto& res, auto& value)
+        {
+            value = std::move(res.result);
+
+            return decompress_value(value);
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_execute_on_keys(
+    std::vector<message::data> keys,
+    message::data entry_processor,
+    CompletionToken&& token
+)
+{
+    message::request<message::execute_on_keys> req;
+
+    req.entity = {m_name, std::move(entry_processor), std::move(keys)};
+
+    return invoke_for<entries_t>(
+        std::move(req),
+        [](auto& res, auto& entries)
+        {
+            entries = std::move(res.results);
+
+            return boost::system::error_code {};
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_execute_on_entries(
+    message::data entry_processor,
+    std::optional<message::data> predicate,
+    CompletionToken&& token
+)
+{
+    message::request<message::execute_on_entries> req;
+
+    req.entity = {m_name, std::move(entry_processor), std::move(predicate)};
+
+    return invoke_for<entries_t>(
+        std::move(req),
+        [](auto& res, auto& entries)
+        {
+            entries = std::move(res.results);
+
+            return boost::system::error_code {};
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_key_set(
+    message::data predicate,
+    CompletionToken&& token
+)
+{
+    message::request<message::key_set_with_predicate> req;
+
+    req.entity = {m_name, std::move(predicate)};
+
+    return invoke_for<std::vector<message::data>>(
+        std::move(req),
+        [](auto& res, auto& keys)
+        {
+            keys = std::move(res.keys);
+
+            return boost::system::error_code {};
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_values(
+    message::data predicate,
+    CompletionToken&& token
+)
+{
+    message::request<message::values_with_predicate> req;
+
+    req.entity = {m_name, std::move(predicate)};
+
+    return invoke_for<std::vector<message::data>>(
+        std::move(req),
+        [](auto& res, auto& values)
+        {
+            values = std::move(res.values);
+
+            return decompress_values(values);
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_entry_set(
+    message::data predicate,
+    CompletionToken&& token
+)
+{
+    message::request<message::entries_with_predicate> req;
+
+    req.entity = {m_name, std::move(predicate)};
+
+    return invoke_for<entries_t>(
+        std::move(req),
+        [](auto& res, auto& entries)
+        {
+            entries = std::move(res.entries);
+
+            return decompress_values(entries);
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_project(
+    message::data projection,
+    std::optional<message::data> predicate,
+    CompletionToken&& token
+)
+{
+    message::request<message::project_with_predicate> req;
+
+    req.entity = {m_name, std::move(projection), std::move(predicate)};
+
+    return invoke_for<std::vector<std::optional<message::data>>>(
+        std::move(req),
+        [](auto& res, auto& results)
+        {
+            results = std::move(res.results);
+
+            return boost::system::error_code {};
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto map::async_aggregate(
+    message::data aggregator,
+    std::optional<message::data> predicate,
+    CompletionToken&& token
+)
+{
+    message::request<message::aggregate_with_predicate> req;
+
+    req.entity = {m_name, std::move(aggregator), std::move(predicate)};
+
+    return invoke_for<std::optional<message::data>>(
+        std::move(req),
+        [](auto& res, auto& result)
+        {
+            result = std::move(res.result);
+
+            return boost::system::error_code {};
+        },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename Result, typename T, typename Extract, typename CompletionToken>
+auto map::invoke_for(
+    message::request<T> req,
+    Extract extract,
+    CompletionToken&& token
+)
+{
+    enum {starting, schemas_publishing, response_awaiting};
+
+    return boost::asio::async_compose<
+        CompletionToken, void(boost::system::error_code, Result)
+    >(
+        [
+            this,
+            req     = std::move(req),
+            extract = std::move(extract),
+            state   = starting
+        ]
+        (
+            auto& composable,
+            const boost::system::error_code& error = {},
+            std::vector<char> response = {}
+        ) mutable
+        {
+            if (!error)
+            {
+                switch (state)
+                {
+                    case starting:
+                    {
+                        if (schemas_unpublished())
+                        {
+                            state = schemas_publishing;
+
+                            return m_options.schemas->async_publish(m_conn, std::move(composable));
+                        }
+
+                        [[fallthrough]];
+                    }
+                    case schemas_publishing:
+                    {
+                        state = response_awaiting;
+
+                        if constexpr (message::is_shareable_v<T>)
+                        {
+                            if (m_options.share_reads)
+                                return m_conn.invoke_shared(std::move(req), std::move(composable));
+                        }
+
+                        m_conn.invoke(std::move(req), std::move(composable));
+
+                        return;
+                    }
+                    case response_awaiting:
+                    {
+                        message::response<T> res;
+                        Result result {};
+
+                        if (auto ec = message::decode_response(response, res))
+                            return composable.complete(ec, Result{});
+
+                        if (auto ec = extract(res, result))
+                            return composable.complete(ec, Result{});
+
+                        return composable.complete(error, std::move(result));
+                    }
+                }
+            }
+
+            composable.complete(error, Result{});
+        },
+        token
+    );
+}
+
+inline bool map::schemas_unpublished() const
+{
+    return m_options.schemas && m_options.schemas->has_unpublished();
+}
+
+inline std::int32_t map::partition_of(const message::data& key)
+{
+    auto hash = message::partition_hash(key);
+
+    if (auto* profiler = m_conn.profiler())
+        profiler->record_key(key, hash);
+
+    return message::partition_id(hash, m_conn.partition_count());
+}
+
+inline void map::coalesce_put(
+    message::data key,
+    message::data value,
+    put_waiter_t waiter
+)
+{
+    auto [it, inserted] = m_pending_puts.try_emplace(coalescing_key(key));
+    auto& put           = it->second;
+
+    if (inserted)
+        put.key = std::move(key);
+
+    put.value = std::move(value);
+    put.waiters.push_back(std::move(waiter));
+
+    if (m_pending_puts.size() >= m_options.coalescing.max_keys)
+        return flush();
+
+    if (m_flush_scheduled)
+        return;
+
+    m_flush_scheduled = true;
+
+    m_flush_timer.expires_after(m_options.coalescing.window);
+    m_flush_timer.async_wait(
+        [this](const boost::system::error_code& err)
+        {
+            if (!err && m_flush_scheduled)
+                flush();
+        }
+    );
+}
+
+inline void map::flush_key(const message::data& key)
+{
+    auto it = m_pending_puts.find(coalescing_key(key));
+
+    if (it == m_pending_puts.end())
+        return;
+
+    pending_puts_t pending;
+
+    pending.insert(m_pending_puts.extract(it));
+
+    if (m_pending_puts.empty() && m_flush_scheduled)
+    {
+        m_flush_scheduled = false;
+        m_flush_timer.cancel();
+    }
+
+    send_pending(std::move(pending));
+}
+
+// Once the schemas the values may carry are published, in the order of the
+// invocations waiting for them.
+inline void map::send_pending(pending_puts_t pending)
+{
+    if (schemas_unpublished())
+    {
+        return m_options.schemas->async_publish(
+            m_conn,
+            [this, pending = std::move(pending)](boost::system::error_code err) mutable
+            {
+                send_puts(std::move(pending), err);
+            }
+        );
+    }
+
+    send_puts(std::move(pending), {});
+}
+
+inline void map::send_puts(pending_puts_t pending, boost::system::error_code err)
+{
+    if (err)
+    {
+        for (auto& [k, put] : pending)
+        {
+            for (auto& waiter : put.waiters)
+                waiter(err, std::nullopt);
+        }
+
+        return;
+    }
+
+    m_conn.hold_writes();
+
+    for (auto& [k, put] : pending)
+        send_put(std::move(put));
+
+    m_conn.release_writes();
+}
+
+inline void map::send_put(pending_put put)
+{
+    message::request<message::map_put> req;
+
+    req.header.partition_id = partition_of(put.key);
+    req.entity = {
+        m_name,
+        std::move(put.key),
+        compress(std::move(put.value), m_options.compression)
+    };
+
+    m_conn.invoke(
+        std::move(req),
+        [waiters = std::move(put.waiters)](boost::system::error_code err, std::vector<char> response)
+        {
+            std::optional<message::data> previous;
+            message::response<message::map_put> res;
+
+            if (!err)
+                err = message::decode_response(response, res);
+
+            if (!err)
+            {
+                previous = std::move(res.previous);
+                err      = decompress_value(previous);
+            }
+
+            for (auto& waiter : waiters)
+                waiter(err, previous);
+        }
+    );
+}
+
+inline std::string map::coalescing_key(const message::data& key)
+{
+    std::string x(sizeof(key.type_id) + key.payload.size(), '\0');
+
+    std::memcpy(x.data(), &key.type_id, sizeof(key.type_id));
+    std::memcpy(x.data() + sizeof(key.type_id), key.payload.data(), key.payload.size());
+
+    return x;
+}
+
+inline boost::system::error_code map::decompress_value(std::optional<message::data>& value)
+{
+    if (value)
+        return decompress(*value);
+
+    return {};
+}
+
+inline boost::system::error_code map::decompress_values(std::vector<message::data>& values)
+{
+    for (auto& x : values)
+    {
+        if (auto ec = decompress(x))
+            return ec;
+    }
+
+    return {};
+}
+
+inline boost::system::error_code map::decompress_values(entries_t& entries)
+{
+    for (auto& [key, value] : entries)
+    {
+        if (auto ec = decompress(value))
+            return ec;
+    }
+
+    return {};
+}
+
+}
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+
+#include "hz_client/cluster.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/compression.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/query.hpp"
+#include "hz_client/message/map_fetch.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+struct map_scan_options
+{
+    // Number of keys or entries fetched with one request.
+    std::int32_t batch_size {1000};
+
+    // Number of partitions scanned at the same time.
+    std::size_t parallelism {4};
+};
+
+template<message::iteration_type Type>
+struct scan_batch
+{
+    using item_type = std::conditional_t<
+        Type == message::iteration_type::key,
+        message::data,
+        std::pair<message::data, message::data>
+    >;
+
+    std::int32_t           partition_id {-1};
+    std::vector<item_type> items;
+};
+
+// Iterates over the keys or entries of a map, partition by partition.
+// `parallelism` partitions are scanned at the same time, over a cluster
+// each one from the connection to its owner, so that the scan is spread
+// over every member rather than held up by one; each of them keeps
+// one batch requested ahead of the one waiting to be taken, so at most two
+// batches per scanned partition are held at any time. Batches are handed out
+// in the order they arrive, not in partition order.
+//
+// Only one `async_next` may be outstanding at a time, and the scan has to
+// outlive the invocations it submits. A cluster has to be started first.
+template<message::iteration_type Type>
+class map_scan
+{
+    static_assert(Type != message::iteration_type::value, "a map can only be scanned for keys or entries");
+
+    using error_code = boost::system::error_code;
+
+public:
+
+    using batch_type = scan_batch<Type>;
+
+    map_scan(connection& conn, std::string map_name, map_scan_options options = {});
+    map_scan(cluster& members, std::string map_name, map_scan_options options = {});
+
+    // Completes with the next batch. A batch without items marks the end of
+    // the scan.
+    template<typename CompletionToken>
+    auto async_next(CompletionToken&& token);
+
+private:
+
+    using fetch_t = std::conditional_t<
+        Type == message::iteration_type::key,
+        message::fetch_keys,
+        message::fetch_entries
+    >;
+
+    struct cursor
+    {
+        std::vector<message::iteration_pointer> pointers {message::iteration_pointer {}};
+        std::size_t buffered {0};
+        bool        fetching {false};
+        bool        done {false};
+    };
+
+    static inline constexpr std::size_t MAX_BUFFERED = 2;
+
+    // The one the scan was made over, or the connection to the owner of
+    // `partition_id` within the cluster, any of them for a negative id.
+    connection& connection_for(std::int32_t partition_id);
+
+    void start_cursors();
+    void fetch(std::int32_t partition_id, cursor& c);
+    void on_fetched(std::int32_t partition_id, error_code err, std::vector<char> response);
+    void deliver();
+
+    connection*                             m_conn {nullptr};
+    cluster*                                m_cluster {nullptr};
+    std::string                             m_map_name;
+    map_scan_options                        m_options;
+    bool                                    m_started {false};
+    std::int32_t                            m_partition_count {0};
+    std::int32_t                            m_next_partition {0};
+    std::map<std::int32_t, cursor>          m_cursors;
+    std::deque<batch_type>                  m_ready;
+    bool                                    m_failed {false};
+    error_code                              m_error;
+    std::function<void(error_code, batch_type)> m_waiter;
+};
+
+template<message::iteration_type Type>
+map_scan<Type>::map_scan(connection& conn, std::string map_name, map_scan_options options)
+    :   m_conn {&conn}
+    ,   m_map_name {std::move(map_name)}
+    ,   m_options {std::move(options)}
+{
+    if (m_options.batch_size < 1)
+        m_options.batch_size = 1;
+
+    if (m_options.parallelism < 1)
+        m_options.parallelism = 1;
+}
+
+template<message::iteration_type Type>
+map_scan<Type>::map_scan(cluster& members, std::string map_name, map_scan_options options)
+    :   map_scan {members.any_connection(), std::move(map_name), std::move(options)}
+{
+    m_cluster = &members;
+}
+
+template<message::iteration_type Type>
+template<typename CompletionToken>
+auto map_scan<Type>::async_next(CompletionToken&& token)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code, batch_type)
+    >(
+        [this](auto& composable) mutable
+        {
+            m_waiter = make_shallow_copyable(
+                [composable = std::move(composable)](error_code err, batch_type batch) mutable
+                {
+                    composable.complete(err, std::move(batch));
+                }
+            );
+
+            if (!m_started)
+            {
+                m_started         = true;
+                m_partition_count = connection_for(-1).partition_count();
+
+                start_cursors();
+            }
+
+            // Whatever is at hand already is handed over through the
+            // executor, never from within this call.
+            boost::asio::post(connection_for(-1).sck().get_executor(), [this] { deliver(); });
+        },
+        token
+    );
+}
+
+template<message::iteration_type Type>
+connection& map_scan<Type>::connection_for(std::int32_t partition_id)
+{
+    if (!m_cluster)
+        return *m_conn;
+
+    if (partition_id < 0)
+        return m_cluster->any_connection();
+
+    return m_cluster->connection_for(partition_id);
+}
+
+template<message::iteration_type Type>
+void map_scan<Type>::start_cursors()
+{
+    if (m_failed)
+        return;
+
+    // The first batches of the newly started partitions leave with a single
+    // write per connection.
+    std::vector<connection*> held;
+
+    while (m_cursors.size() < m_options.parallelism && m_next_partition < m_partition_count)
+    {
+        auto  partition_id = m_next_partition++;
+        auto& conn         = connection_for(partition_id);
+
+        if (std::find(begin(held), end(held), &conn) == end(held))
+        {
+            conn.hold_writes();
+            held.push_back(&conn);
+        }
+
+        fetch(partition_id, m_cursors[partition_id]);
+    }
+
+    for (auto conn : held)
+        conn->release_writes();
+}
+
+template<message::iteration_type Type>
+void map_scan<Type>::fetch(std::int32_t partition_id, cursor& c)
+{
+    message::request<fetch_t> req;
+
+    req.header.partition_id = partition_id;
+    req.entity.map_name     = m_map_name;
+    req.entity.batch        = m_options.batch_size;
+    req.entity.pointers     = c.pointers;
+
+    c.fetching = true;
+
+    connection_for(partition_id).invoke(
+        std::move(req),
+        [this, partition_id](const error_code& err, std::vector<char> response)
+        {
+            on_fetched(partition_id, err, std::move(response));
+        }
+    );
+}
+
+template<message::iteration_type Type>
+void map_scan<Type>::on_fetched(
+    std::int32_t partition_id,
+    error_code err,
+    std::vector<char> response
+)
+{
+    auto it = m_cursors.find(partition_id);
+
+    if (it == m_cursors.end())
+        return;
+
+    auto& c = it->second;
+
+    c.fetching = false;
+
+    message::response<fetch_t> res;
+
+    if (!err)
+        err = message::decode_response(response, res);
+
+    if (err)
+    {
+        m_failed = true;
+        m_error  = err;
+
+        m_cursors.clear();
+        m_ready.clear();
+
+        return deliver();
+    }
+
+    c.pointers = std::move(res.pointers);
+    c.done     = message::is_iteration_done(c.pointers);
+
+    batch_type batch;
+
+    batch.partition_id = partition_id;
+
+    if constexpr (Type == message::iteration_type::key)
+    {
+        batch.items = std::move(res.keys);
+    }
+    else
+    {
+        batch.items = std::move(res.entries);
+
+        for (auto& [key, value] : batch.items)
+            decompress(value);
+    }
+
+    if (!batch.items.empty())
+    {
+        m_ready.push_back(std::move(batch));
+        ++c.buffered;
+    }
+
+    if (c.done)
+    {
+        if (c.buffered == 0)
+        {
+            m_cursors.erase(it);
+
+            start_cursors();
+        }
+    }
+    else if (c.buffered < MAX_BUFFERED)
+    {
+        fetch(partition_id, c);
+    }
+
+    deliver();
+}
+
+template<message::iteration_type Type>
+void map_scan<Type>::deliver()
+{
+    if (!m_waiter)
+        return;
+
+    batch_type batch;
+    error_code err;
+
+    if (!m_ready.empty())
+    {
+        batch = std::move(m_ready.front());
+
+        m_ready.pop_front();
+
+        auto it = m_cursors.find(batch.partition_id);
+        auto& c = it->second;
+
+        --c.buffered;
+
+        if (c.done && c.buffered == 0)
+        {
+            m_cursors.erase(it);
+
+            start_cursors();
+        }
+        else if (!c.done && !c.fetching)
+        {
+            fetch(batch.partition_id, c);
+        }
+    }
+    else if (m_failed)
+    {
+        err = std::exchange(m_error, {});
+    }
+    else if (!m_cursors.empty() || m_next_partition < m_partition_count)
+    {
+        return;
+    }
+
+    auto waiter = std::move(m_waiter);
+
+    m_waiter = nullptr;
+
+    waiter(err, std::move(batch));
+}
+
+}
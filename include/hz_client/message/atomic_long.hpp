@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/frame_header.hpp"
+#include "hz_client/message/frame_reader.hpp"
+#include "hz_client/message/string_serialization.hpp"
+
+namespace hz_client::message
+{
+
+// Identifies the CP group, i.e. the Raft group, a CP data structure lives
+// in. `seed` tells apart the incarnations of a group of the same name.
+struct raft_group_id
+{
+    std::string  name;
+    std::int64_t seed {0};
+    std::int64_t id {0};
+};
+
+// Resolves the group of the CP proxy `proxy_name`, which is either a plain
+// name, living in the default group, or `name@group`. Creates the group if
+// it does not exist yet, any member may be asked.
+struct create_cp_group
+{
+    std::string proxy_name;
+};
+
+struct atomic_long_add_and_get
+{
+    std::int64_t  delta {0};
+    raft_group_id group_id;
+    std::string   name;
+};
+
+struct atomic_long_get
+{
+    raft_group_id group_id;
+    std::string   name;
+};
+
+// The longs in an initial frame, followed by the name.
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const raft_group_id& x
+)
+{
+    frame_header initial {};
+
+    initial.length = frame_header::HEADER_SIZE + 2 * sizeof(std::int64_t);
+
+    return ss << begin_frame()
+              << initial
+              << x.seed
+              << x.id
+              << x.name
+              << end_frame();
+}
+
+inline void decode_variable(frame_reader& reader, raft_group_id& x)
+{
+    reader.next();
+
+    auto initial = reader.next();
+
+    if (initial.size >= 2 * sizeof(std::int64_t))
+    {
+        x.seed = read_fixed<std::int64_t>(initial, 0);
+        x.id   = read_fixed<std::int64_t>(initial, sizeof(std::int64_t));
+    }
+
+    if (reader.has_next() && !reader.next_is_end())
+    {
+        auto name = reader.next();
+
+        x.name.assign(name.content, name.size);
+    }
+
+    reader.skip_to_end_of_structure();
+}
+
+}
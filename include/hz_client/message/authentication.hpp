@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <optional>
@@ -24,28 +25,11 @@ struct authentication
     std::vector<std::string> labels;
     std::optional<std::string> username;
     std::optional<std::string> password;
+    std::uint8_t serialization_version {1};
+    std::string client_type {"CPP"};
+    std::string client_version {"5.1.0"};
 };
 
-template<auto... Args>
-inline rbs::stream<Args...>&
-operator<<(
-    rbs::stream<Args...>& ss ,
-    const authentication& auth
-)
-{
-    using namespace std::string_literals;
-
-    return ss << auth.uid
-              << std::uint8_t(1)
-              << auth.cluster_name
-              << auth.username
-              << auth.password
-              << "CPP"s
-              << "5.1.0"s
-              << auth.instance_name
-              << range { begin(auth.labels), end(auth.labels) };
-}
-
 template<auto... Args>
 inline rbs::stream<Args...>&
 operator>>(
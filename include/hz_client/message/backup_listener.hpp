@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hz_client::message
+{
+
+// Subscribes to the acks of the backups of backup-aware invocations made
+// over the connection. The owner of a partition then responds to such an
+// invocation without waiting for its backups, telling how many there are,
+// and each member making one acks it directly to the client.
+struct add_local_backup_listener
+{};
+
+// Ack of one backup, sent with the backup event flag set.
+struct backup_event
+{
+    // Correlation id of the invocation whose backup is made.
+    std::int64_t source_correlation_id {0};
+};
+
+}
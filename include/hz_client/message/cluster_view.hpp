@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#include <boost/uuid/uuid.hpp>
+
+#include "hz_client/message/frame_reader.hpp"
+
+namespace hz_client::message
+{
+
+// Subscribes to the member list and the partition table. The member sends
+// both right after the registration and again whenever they change.
+struct add_cluster_view_listener
+{};
+
+// Partition ids owned by each member.
+using partition_owners = std::vector<std::pair<boost::uuids::uuid, std::vector<std::int32_t>>>;
+
+struct partitions_view_event
+{
+    std::int32_t     version {0};
+    partition_owners partitions;
+};
+
+// The lists of partition ids come first, between a begin and an end frame,
+// followed by a single frame holding the uuids of their owners.
+inline void decode_variable(frame_reader& reader, partition_owners& x)
+{
+    x.clear();
+
+    decode_list(
+        reader,
+        [&x](frame_reader& reader)
+        {
+            auto frame = reader.next();
+
+            std::vector<std::int32_t> ids;
+
+            for (std::size_t offset = 0; offset + sizeof(std::int32_t) <= frame.size; offset += sizeof(std::int32_t))
+                ids.push_back(read_fixed<std::int32_t>(frame, offset));
+
+            x.emplace_back(boost::uuids::uuid {}, std::move(ids));
+        }
+    );
+
+    if (!reader.has_next())
+        return;
+
+    static constexpr std::size_t UUID_SIZE = 17;
+
+    auto owners = reader.next();
+
+    for (std::size_t i = 0; i < x.size() && (i + 1) * UUID_SIZE <= owners.size; ++i)
+        x[i].first = read_uuid(owners, i * UUID_SIZE);
+}
+
+}
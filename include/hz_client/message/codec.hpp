@@ -0,0 +1,400 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <type_traits>
+
+#include <boost/system/error_code.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/message/frame_header.hpp"
+#include "hz_client/message/frame_reader.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/range_serialization.hpp"
+
+namespace hz_client::message
+{
+
+// Codecs are declared rather than written. A message lists its fields in
+// wire order: the fixed-size ones, which are packed into the initial frame
+// right after the header, then the variable-size ones, one or more frames
+// each. Sizes and offsets of the fixed-size fields are computed at compile
+// time and inconsistent layouts are rejected.
+//
+//   template<>
+//   struct request_codec<map_get>
+//   {
+//       static inline constexpr std::int32_t message_type = 66048;
+//       static inline constexpr auto partition = partition_policy::keyed;
+//
+//       using layout = fields<
+//           field<&map_get::thread_id>,
+//           field<&map_get::map_name>,
+//           field<&map_get::key>
+//       >;
+//   };
+//
+// `message_type` may also be a static function of the entity, for messages
+// whose type depends on which optional fields are present. Responses and
+// events are declared the same way with `response_codec` and `event_codec`.
+
+// Size of the initial frame of a request without fixed-size fields: the
+// frame header, the message type, the correlation id and the partition id.
+static inline constexpr std::size_t REQUEST_INITIAL_FRAME_SIZE = 22;
+
+enum class partition_policy
+{
+    // Sent with partition id -1, to be executed on any member.
+    any,
+
+    // Sent with the partition id the caller puts into the header.
+    keyed
+};
+
+template<auto Member>
+struct field
+{};
+
+// A variable-size list of items, each one encoded on its own, between a
+// begin and an end frame.
+template<auto Member>
+struct list_field
+{};
+
+// A trailing `std::optional` which is left out of the message altogether
+// when it is empty, the message type telling whether it is there.
+template<auto Member>
+struct trailing_field
+{};
+
+template<typename... Fields>
+struct fields
+{};
+
+template<typename T>
+struct request_codec;
+
+template<typename T>
+struct response_codec;
+
+template<typename T>
+struct event_codec;
+
+template<typename T>
+concept has_request_codec = requires { typename request_codec<T>::layout; };
+
+template<typename T>
+concept has_response_codec = requires { typename response_codec<T>::layout; };
+
+template<typename T>
+concept has_event_codec = requires { typename event_codec<T>::layout; };
+
+template<typename T>
+struct fixed_size : std::integral_constant<std::size_t, 0>
+{};
+
+template<typename T>
+    requires std::is_arithmetic_v<T>
+struct fixed_size<T> : std::integral_constant<std::size_t, sizeof(T)>
+{};
+
+template<>
+struct fixed_size<bool> : std::integral_constant<std::size_t, 1>
+{};
+
+// Null flag followed by the two longs, which are there even if null.
+template<>
+struct fixed_size<boost::uuids::uuid> : std::integral_constant<std::size_t, 17>
+{};
+
+template<typename T>
+static inline constexpr bool is_fixed_size_v = fixed_size<T>::value > 0;
+
+template<auto Member>
+struct member_type;
+
+template<typename C, typename V, V C::* Member>
+struct member_type<Member>
+{
+    using type = V;
+};
+
+template<auto Member>
+using member_type_t = typename member_type<Member>::type;
+
+template<typename F>
+struct field_traits;
+
+template<auto Member>
+struct field_traits<field<Member>>
+{
+    static inline constexpr bool        is_fixed    = is_fixed_size_v<member_type_t<Member>>;
+    static inline constexpr std::size_t size        = fixed_size<member_type_t<Member>>::value;
+    static inline constexpr bool        is_trailing = false;
+};
+
+template<auto Member>
+struct field_traits<list_field<Member>>
+{
+    static inline constexpr bool        is_fixed    = false;
+    static inline constexpr std::size_t size        = 0;
+    static inline constexpr bool        is_trailing = false;
+};
+
+template<auto Member>
+struct field_traits<trailing_field<Member>>
+{
+    static inline constexpr bool        is_fixed    = false;
+    static inline constexpr std::size_t size        = 0;
+    static inline constexpr bool        is_trailing = true;
+};
+
+template<typename Layout>
+struct layout_traits;
+
+template<typename... F>
+struct layout_traits<fields<F...>>
+{
+    static inline constexpr std::size_t fixed_size   = (std::size_t {0} + ... + field_traits<F>::size);
+    static inline constexpr bool        has_variable = (false || ... || !field_traits<F>::is_fixed);
+
+    static constexpr bool fixed_fields_first()
+    {
+        constexpr bool is_fixed[] {field_traits<F>::is_fixed..., false};
+
+        for (std::size_t i = 1; i < sizeof...(F); ++i)
+        {
+            if (is_fixed[i] && !is_fixed[i - 1])
+                return false;
+        }
+
+        return true;
+    }
+
+    static constexpr bool trailing_fields_last()
+    {
+        constexpr bool is_trailing[] {field_traits<F>::is_trailing..., false};
+
+        for (std::size_t i = 1; i < sizeof...(F); ++i)
+        {
+            if (!is_trailing[i] && is_trailing[i - 1])
+                return false;
+        }
+
+        return true;
+    }
+};
+
+template<typename Codec, typename T>
+constexpr std::int32_t message_type_of(const T& x)
+{
+    if constexpr (requires { Codec::message_type(x); })
+        return Codec::message_type(x);
+    else
+        return Codec::message_type;
+}
+
+template<typename Codec>
+constexpr void check_layout()
+{
+    using layout = layout_traits<typename Codec::layout>;
+
+    static_assert(layout::fixed_fields_first(), "fixed-size fields have to precede the variable-size ones");
+    static_assert(layout::trailing_fields_last(), "trailing fields have to come last");
+
+    if constexpr (requires { std::integral_constant<std::int32_t, Codec::message_type> {}; })
+        static_assert(Codec::message_type > 0, "message types are positive, zero stands for errors");
+}
+
+template<auto... Args, typename T, auto Member>
+inline void encode_field(rbs::stream<Args...>& ss, const T& x, field<Member>)
+{
+    ss << x.*Member;
+}
+
+template<auto... Args, typename T, auto Member>
+inline void encode_field(rbs::stream<Args...>& ss, const T& x, list_field<Member>)
+{
+    const auto& items = x.*Member;
+
+    ss << range {begin(items), end(items)};
+}
+
+template<auto... Args, typename T, auto Member>
+inline void encode_field(rbs::stream<Args...>& ss, const T& x, trailing_field<Member>)
+{
+    if (const auto& value = x.*Member)
+        ss << *value;
+}
+
+template<auto... Args, typename T, typename... F>
+inline void encode_fields(rbs::stream<Args...>& ss, const T& x, fields<F...>)
+{
+    (encode_field(ss, x, F {}), ...);
+}
+
+// Bytes of the values a field carries, without the frames around them, for
+// the size of a message to be told without encoding it.
+template<typename T>
+inline std::size_t payload_size(const T& x);
+
+template<typename T>
+inline std::size_t payload_size(const std::optional<T>& x);
+
+template<typename A, typename B>
+inline std::size_t payload_size(const std::pair<A, B>& x);
+
+template<typename T>
+inline std::size_t payload_size(const std::vector<T>& x);
+
+inline std::size_t payload_size(const data& x)
+{
+    return x.payload.size();
+}
+
+inline std::size_t payload_size(const std::string& x)
+{
+    return x.size();
+}
+
+template<typename T>
+inline std::size_t payload_size(const T&)
+{
+    return fixed_size<T>::value;
+}
+
+template<typename T>
+inline std::size_t payload_size(const std::optional<T>& x)
+{
+    return x ? payload_size(*x) : 0;
+}
+
+template<typename A, typename B>
+inline std::size_t payload_size(const std::pair<A, B>& x)
+{
+    return payload_size(x.first) + payload_size(x.second);
+}
+
+template<typename T>
+inline std::size_t payload_size(const std::vector<T>& x)
+{
+    std::size_t n {0};
+
+    for (const auto& item : x)
+        n += payload_size(item);
+
+    return n;
+}
+
+template<typename T, template<auto> typename Field, auto Member>
+inline std::size_t field_payload_size(const T& x, Field<Member>)
+{
+    return payload_size(x.*Member);
+}
+
+template<typename T, typename... F>
+inline std::size_t fields_payload_size(const T& x, fields<F...>)
+{
+    return (std::size_t {0} + ... + field_payload_size(x, F {}));
+}
+
+// Decoding of a variable-size field, by the type of the member it goes to.
+// Overloads for types of particular messages are found next to them.
+inline void decode_variable(frame_reader& reader, std::optional<data>& x)
+{
+    if (reader.next_is_null())
+    {
+        reader.next();
+        x.reset();
+
+        return;
+    }
+
+    if (!x)
+        x.emplace();
+
+    decode_data(reader, *x);
+}
+
+// Items already held by `x` are overwritten in place, so that a list
+// decoded into the same vector again reuses the capacity of their payloads.
+inline void decode_variable(frame_reader& reader, std::vector<data>& x)
+{
+    std::size_t n {0};
+
+    decode_list(
+        reader,
+        [&x, &n](frame_reader& reader)
+        {
+            if (n == x.size())
+                x.emplace_back();
+
+            decode_data(reader, x[n++]);
+        }
+    );
+
+    x.resize(n);
+}
+
+inline void decode_variable(frame_reader& reader, std::vector<std::optional<data>>& x)
+{
+    x = decode_nullable_data_list(reader);
+}
+
+inline void decode_variable(frame_reader& reader, std::vector<std::pair<data, data>>& x)
+{
+    x = decode_entry_list(reader);
+}
+
+template<typename T>
+inline void decode_fixed(const frame_view& initial, std::size_t offset, T& x)
+{
+    if constexpr (std::is_same_v<T, boost::uuids::uuid>)
+        x = read_uuid(initial, offset);
+    else
+        x = read_fixed<T>(initial, offset);
+}
+
+template<typename T, typename... F>
+inline boost::system::error_code decode_fields(
+    frame_reader& reader,
+    const frame_view& initial,
+    std::size_t offset,
+    T& x,
+    fields<F...>
+)
+{
+    boost::system::error_code err;
+
+    [[maybe_unused]] auto decode_one = [&]<auto Member>(field<Member>)
+    {
+        if (err)
+            return;
+
+        if constexpr (is_fixed_size_v<member_type_t<Member>>)
+        {
+            decode_fixed(initial, offset, x.*Member);
+            offset += fixed_size<member_type_t<Member>>::value;
+        }
+        else if (!reader.has_next())
+        {
+            err = error::malformed_response;
+        }
+        else
+        {
+            decode_variable(reader, x.*Member);
+        }
+    };
+
+    (decode_one(F {}), ...);
+
+    return err;
+}
+
+}
@@ -0,0 +1,581 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/frame_header.hpp"
+#include "hz_client/message/range_serialization.hpp"
+#include "hz_client/message/string_serialization.hpp"
+#include "hz_client/util/rabin_fingerprint.hpp"
+
+namespace hz_client::message
+{
+
+// Compact serialization. A value does not carry the names and kinds of its
+// fields, only the id of a schema which lists them; the schema decides
+// where each field is found in the value. Members have to be sent a schema
+// before any value of it reaches them, see `hz_client::compact_schemas`.
+//
+// Types are declared by their schema's type name and their fields:
+//
+//   template<>
+//   struct compact_codec<order>
+//   {
+//       static inline constexpr const char* type_name = "order";
+//
+//       static inline constexpr auto fields = std::tuple {
+//           compact_field {"id", &order::id},
+//           compact_field {"customer", &order::customer}
+//       };
+//   };
+//
+// Members may be of `bool`, the fixed-width integers, `float`, `double`,
+// `std::string` and `std::optional<std::string>`.
+
+static inline constexpr std::int32_t CONSTANT_TYPE_COMPACT = -55;
+
+// Kinds as numbered by the members, of the fields which are supported.
+enum class field_kind : std::int32_t
+{
+    boolean = 1,
+    int8    = 3,
+    int16   = 7,
+    int32   = 9,
+    int64   = 11,
+    float32 = 13,
+    float64 = 15,
+    string  = 17
+};
+
+// Size of a field in the fixed-size section, zero for the variable-size
+// ones. Booleans take a bit each, after the other fixed-size fields.
+inline std::int32_t fixed_size_of(field_kind x)
+{
+    switch (x)
+    {
+        case field_kind::int8:
+            return 1;
+        case field_kind::int16:
+            return 2;
+        case field_kind::int32:
+        case field_kind::float32:
+            return 4;
+        case field_kind::int64:
+        case field_kind::float64:
+            return 8;
+        case field_kind::boolean:
+        case field_kind::string:
+            return 0;
+    }
+
+    return 0;
+}
+
+struct schema_field
+{
+    std::string  name;
+    field_kind   kind {field_kind::int32};
+
+    // A fixed-size field is found `offset` bytes into the data of a value,
+    // a boolean at bit `bit_offset` of that byte. A variable-size one is
+    // found through entry `index` of the offset table.
+    std::int32_t offset {-1};
+    std::int8_t  bit_offset {-1};
+    std::int32_t index {-1};
+};
+
+struct schema
+{
+    std::string               type_name;
+
+    // Sorted by name.
+    std::vector<schema_field> fields;
+
+    std::int64_t              id {0};
+    std::int32_t              fixed_size {0};
+    std::int32_t              variable_count {0};
+};
+
+// Lays the fields out as the members do and computes the id. Fixed-size
+// fields come first, largest first and by name among the same size, then
+// the booleans, eight to a byte. Variable-size fields are indexed by name.
+inline schema make_schema(std::string type_name, std::vector<schema_field> fields)
+{
+    schema x {std::move(type_name), std::move(fields)};
+
+    std::sort(
+        begin(x.fields),
+        end(x.fields),
+        [](const auto& a, const auto& b) { return a.name < b.name; }
+    );
+
+    std::vector<schema_field*> fixed;
+    std::vector<schema_field*> booleans;
+
+    for (auto& f : x.fields)
+    {
+        if (f.kind == field_kind::boolean)
+            booleans.push_back(&f);
+        else if (fixed_size_of(f.kind) > 0)
+            fixed.push_back(&f);
+        else
+            f.index = x.variable_count++;
+    }
+
+    std::stable_sort(
+        begin(fixed),
+        end(fixed),
+        [](auto a, auto b) { return fixed_size_of(a->kind) > fixed_size_of(b->kind); }
+    );
+
+    for (auto f : fixed)
+    {
+        f->offset     = x.fixed_size;
+        x.fixed_size += fixed_size_of(f->kind);
+    }
+
+    for (std::size_t i = 0; i < booleans.size(); ++i)
+    {
+        booleans[i]->offset     = x.fixed_size + std::int32_t(i / 8);
+        booleans[i]->bit_offset = std::int8_t(i % 8);
+    }
+
+    x.fixed_size += std::int32_t((booleans.size() + 7) / 8);
+
+    rabin_fingerprint fp;
+
+    fp.add(std::string_view {x.type_name});
+    fp.add(std::int32_t(x.fields.size()));
+
+    for (const auto& f : x.fields)
+    {
+        fp.add(std::string_view {f.name});
+        fp.add(std::int32_t(f.kind));
+    }
+
+    x.id = fp.value();
+
+    return x;
+}
+
+template<typename T>
+struct compact_kind;
+
+template<>
+struct compact_kind<bool> : std::integral_constant<field_kind, field_kind::boolean>
+{};
+
+template<>
+struct compact_kind<std::int8_t> : std::integral_constant<field_kind, field_kind::int8>
+{};
+
+template<>
+struct compact_kind<std::int16_t> : std::integral_constant<field_kind, field_kind::int16>
+{};
+
+template<>
+struct compact_kind<std::int32_t> : std::integral_constant<field_kind, field_kind::int32>
+{};
+
+template<>
+struct compact_kind<std::int64_t> : std::integral_constant<field_kind, field_kind::int64>
+{};
+
+template<>
+struct compact_kind<float> : std::integral_constant<field_kind, field_kind::float32>
+{};
+
+template<>
+struct compact_kind<double> : std::integral_constant<field_kind, field_kind::float64>
+{};
+
+template<>
+struct compact_kind<std::string> : std::integral_constant<field_kind, field_kind::string>
+{};
+
+template<>
+struct compact_kind<std::optional<std::string>> : std::integral_constant<field_kind, field_kind::string>
+{};
+
+template<typename C, typename V>
+struct compact_field
+{
+    const char* name;
+    V C::*      member;
+};
+
+template<typename C, typename V>
+compact_field(const char*, V C::*) -> compact_field<C, V>;
+
+template<typename T>
+struct compact_codec;
+
+template<typename T>
+concept has_compact_codec = requires
+{
+    compact_codec<T>::type_name;
+    compact_codec<T>::fields;
+};
+
+template<has_compact_codec T>
+static inline constexpr std::size_t compact_field_count_v =
+    std::tuple_size_v<std::remove_cvref_t<decltype(compact_codec<T>::fields)>>;
+
+// Schema of `T` and its fields in declaration order, where encoding and
+// decoding take their offsets from.
+template<has_compact_codec T>
+struct compact_layout
+{
+    message::schema                                    schema;
+    std::array<schema_field, compact_field_count_v<T>> fields;
+};
+
+// Computed on first use, once per type.
+template<has_compact_codec T>
+inline const compact_layout<T>& compact_layout_of()
+{
+    static const compact_layout<T> layout = []
+    {
+        compact_layout<T>         x;
+        std::vector<schema_field> fields;
+
+        std::apply(
+            [&fields](const auto&... f)
+            {
+                (
+                    fields.push_back({
+                        f.name,
+                        compact_kind<std::remove_cvref_t<decltype(std::declval<T>().*f.member)>>::value
+                    }),
+                    ...
+                );
+            },
+            compact_codec<T>::fields
+        );
+
+        x.schema = make_schema(compact_codec<T>::type_name, fields);
+
+        for (std::size_t i = 0; i < fields.size(); ++i)
+        {
+            x.fields[i] = *std::find_if(
+                begin(x.schema.fields),
+                end(x.schema.fields),
+                [&](const auto& f) { return f.name == fields[i].name; }
+            );
+        }
+
+        return x;
+    }();
+
+    return layout;
+}
+
+template<has_compact_codec T>
+inline const schema& schema_of()
+{
+    return compact_layout_of<T>().schema;
+}
+
+// Fixed-size fields and lengths are big endian, as everything in a `data`.
+template<typename T>
+inline void store_big(char* p, T x)
+{
+    if constexpr (std::is_same_v<T, float>)
+        return store_big(p, std::bit_cast<std::int32_t>(x));
+    else if constexpr (std::is_same_v<T, double>)
+        return store_big(p, std::bit_cast<std::int64_t>(x));
+    else
+    {
+        auto be = boost::endian::native_to_big(x);
+
+        std::memcpy(p, &be, sizeof(be));
+    }
+}
+
+template<typename T>
+inline T load_big(const char* p)
+{
+    if constexpr (std::is_same_v<T, float>)
+        return std::bit_cast<float>(load_big<std::int32_t>(p));
+    else if constexpr (std::is_same_v<T, double>)
+        return std::bit_cast<double>(load_big<std::int64_t>(p));
+    else
+    {
+        T be;
+
+        std::memcpy(&be, p, sizeof(be));
+
+        return boost::endian::big_to_native(be);
+    }
+}
+
+// Writes a field of a value, whose data starts at `data_start` of `bytes`.
+// Variable-size fields are appended, their offsets going to `offsets`.
+template<typename V>
+inline void write_compact_field(
+    std::vector<char>& bytes,
+    std::size_t data_start,
+    const schema_field& f,
+    const V& x,
+    std::vector<std::int32_t>& offsets
+)
+{
+    if constexpr (std::is_same_v<V, bool>)
+    {
+        if (x)
+            bytes[data_start + f.offset] |= char(1 << f.bit_offset);
+    }
+    else if constexpr (std::is_arithmetic_v<V>)
+    {
+        store_big(bytes.data() + data_start + f.offset, x);
+    }
+    else if constexpr (std::is_same_v<V, std::optional<std::string>>)
+    {
+        if (x)
+            write_compact_field(bytes, data_start, f, *x, offsets);
+    }
+    else
+    {
+        auto at = bytes.size();
+
+        offsets[f.index] = std::int32_t(at - data_start);
+
+        bytes.resize(at + sizeof(std::int32_t) + x.size());
+        store_big(bytes.data() + at, std::int32_t(x.size()));
+        std::memcpy(bytes.data() + at + sizeof(std::int32_t), x.data(), x.size());
+    }
+}
+
+// Offsets of variable-size fields take a byte each if the data is shorter
+// than 255 bytes, two if it is shorter than 65535, four otherwise. The
+// largest value of each width, -1 once sign extended, stands for null.
+inline std::size_t compact_offset_size(std::int32_t data_length)
+{
+    if (data_length < 255)
+        return 1;
+
+    if (data_length < 65535)
+        return 2;
+
+    return 4;
+}
+
+template<has_compact_codec T>
+inline data to_compact_data(const T& x)
+{
+    const auto& layout = compact_layout_of<T>();
+    const auto& s      = layout.schema;
+
+    // The schema id, then the length of the data if there are variable-size
+    // fields, whose offsets follow the data.
+    auto data_start = sizeof(std::int64_t) + (s.variable_count > 0 ? sizeof(std::int32_t) : 0);
+
+    std::vector<char>         bytes(data_start + s.fixed_size);
+    std::vector<std::int32_t> offsets(s.variable_count, -1);
+
+    store_big(bytes.data(), s.id);
+
+    std::apply(
+        [&](const auto&... f)
+        {
+            std::size_t i {0};
+
+            (write_compact_field(bytes, data_start, layout.fields[i++], x.*f.member, offsets), ...);
+        },
+        compact_codec<T>::fields
+    );
+
+    if (s.variable_count > 0)
+    {
+        auto data_length = std::int32_t(bytes.size() - data_start);
+        auto width       = compact_offset_size(data_length);
+        auto at          = bytes.size();
+
+        bytes.resize(at + width * offsets.size());
+
+        for (auto offset : offsets)
+        {
+            if (width == 1)
+                bytes[at] = char(offset);
+            else if (width == 2)
+                store_big(bytes.data() + at, std::int16_t(offset));
+            else
+                store_big(bytes.data() + at, offset);
+
+            at += width;
+        }
+
+        store_big(bytes.data() + sizeof(std::int64_t), data_length);
+    }
+
+    return {CONSTANT_TYPE_COMPACT, std::move(bytes)};
+}
+
+// Reads a field of a value whose data is `data_length` bytes at `p`,
+// followed by the offset table with entries `width` bytes wide.
+template<typename V>
+inline boost::system::error_code read_compact_field(
+    const char* p,
+    std::int32_t data_length,
+    std::size_t width,
+    const schema_field& f,
+    V& x
+)
+{
+    if constexpr (std::is_same_v<V, bool>)
+    {
+        x = (std::uint8_t(p[f.offset]) >> f.bit_offset) & 1;
+    }
+    else if constexpr (std::is_arithmetic_v<V>)
+    {
+        x = load_big<V>(p + f.offset);
+    }
+    else
+    {
+        auto entry = p + data_length + f.index * width;
+
+        std::int32_t offset = width == 1 ? std::int32_t(std::uint8_t(*entry)) :
+                              width == 2 ? std::int32_t(std::uint16_t(load_big<std::int16_t>(entry))) :
+                                           load_big<std::int32_t>(entry);
+
+        if ((width == 1 && offset == 0xff) || (width == 2 && offset == 0xffff) || offset == -1)
+        {
+            if constexpr (std::is_same_v<V, std::optional<std::string>>)
+            {
+                x.reset();
+
+                return {};
+            }
+            else
+            {
+                return error::malformed_response;
+            }
+        }
+
+        if (offset < 0 || offset > data_length - std::int32_t(sizeof(std::int32_t)))
+            return error::malformed_response;
+
+        auto length = load_big<std::int32_t>(p + offset);
+
+        if (length < 0 || length > data_length - offset - std::int32_t(sizeof(std::int32_t)))
+            return error::malformed_response;
+
+        x = std::string {p + offset + sizeof(std::int32_t), std::size_t(length)};
+    }
+
+    return {};
+}
+
+// Decodes a value of the schema of `T` into `x`. Values of any other
+// schema, another version of the type included, are refused with
+// `error::schema_mismatch`.
+template<has_compact_codec T>
+inline boost::system::error_code from_compact_data(const data& value, T& x)
+{
+    const auto& layout = compact_layout_of<T>();
+    const auto& s      = layout.schema;
+    const auto& bytes  = value.payload;
+
+    if (value.type_id != CONSTANT_TYPE_COMPACT || bytes.size() < sizeof(std::int64_t))
+        return error::malformed_response;
+
+    if (load_big<std::int64_t>(bytes.data()) != s.id)
+        return error::schema_mismatch;
+
+    auto        data_start  = sizeof(std::int64_t);
+    auto        data_length = std::int32_t(bytes.size() - data_start);
+    std::size_t width {0};
+
+    if (s.variable_count > 0)
+    {
+        if (bytes.size() < data_start + sizeof(std::int32_t))
+            return error::malformed_response;
+
+        data_length  = load_big<std::int32_t>(bytes.data() + data_start);
+        data_start  += sizeof(std::int32_t);
+        width        = compact_offset_size(data_length);
+
+        if (data_length < 0 ||
+            bytes.size() - data_start < std::size_t(data_length) + width * s.variable_count)
+            return error::malformed_response;
+    }
+
+    if (data_length < s.fixed_size)
+        return error::malformed_response;
+
+    auto p = bytes.data() + data_start;
+
+    boost::system::error_code err;
+
+    std::apply(
+        [&](const auto&... f)
+        {
+            std::size_t i {0};
+
+            auto read_one = [&](const auto& field)
+            {
+                if (!err)
+                    err = read_compact_field(p, data_length, width, layout.fields[i], x.*field.member);
+
+                ++i;
+            };
+
+            (read_one(f), ...);
+        },
+        compact_codec<T>::fields
+    );
+
+    return err;
+}
+
+// A schema as sent to the members: the type name and a list of fields,
+// each one its kind in an initial frame followed by its name.
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const schema_field& x
+)
+{
+    frame_header initial {};
+
+    initial.length = frame_header::HEADER_SIZE + sizeof(std::int32_t);
+
+    return ss << begin_frame()
+              << initial
+              << std::int32_t(x.kind)
+              << x.name
+              << end_frame();
+}
+
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const schema& x
+)
+{
+    return ss << begin_frame()
+              << x.type_name
+              << range {begin(x.fields), end(x.fields)}
+              << end_frame();
+}
+
+}
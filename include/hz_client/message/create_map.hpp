@@ -10,20 +10,9 @@ namespace hz_client::message
 struct create_map
 {
     std::string name;
+    std::string service_name {"hz:impl:mapService"};
 };
 
-template<auto... Args>
-inline rbs::stream<Args...>&
-operator<<(
-    rbs::stream<Args...>& ss ,
-    const create_map& x
-)
-{
-    using namespace std::string_literals;
-
-    return ss << x.name << std::string {"hz:impl:mapService"};
-}
-
 template<auto... Args>
 inline rbs::stream<Args...>&
 operator>>(
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/string_serialization.hpp"
+
+namespace hz_client::message
+{
+
+struct proxy_definition
+{
+    std::string name;
+    std::string service_name {"hz:impl:mapService"};
+};
+
+// Creates the proxies of several distributed objects with one round trip,
+// where `create_map` takes one per object.
+struct create_proxies
+{
+    std::vector<proxy_definition> proxies;
+};
+
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const proxy_definition& x
+)
+{
+    return ss << x.name << x.service_name;
+}
+
+}
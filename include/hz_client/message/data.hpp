@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <optional>
+
+#include <boost/endian/conversion.hpp>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/frame_header.hpp"
+#include "hz_client/message/frame_reader.hpp"
+#include "hz_client/util/murmur_hash3.hpp"
+
+namespace hz_client::message
+{
+
+// Serialized form of a key or a value, as it is stored by the members.
+struct data
+{
+    static inline constexpr std::int32_t CONSTANT_TYPE_INTEGER = -7;
+    static inline constexpr std::int32_t CONSTANT_TYPE_STRING  = -11;
+    static inline constexpr std::int32_t DATA_OFFSET           = 8;
+
+    data() = default;
+
+    data(std::int32_t type, std::vector<char> bytes)
+        :   type_id {type}
+        ,   payload {std::move(bytes)}
+    {}
+
+    data(int value)
+        :   type_id {CONSTANT_TYPE_INTEGER}
+        ,   payload(sizeof(std::int32_t))
+    {
+        auto be = boost::endian::native_to_big(std::int32_t(value));
+
+        std::memcpy(payload.data(), &be, sizeof(be));
+    }
+
+    data(const std::string& value)
+        :   type_id {CONSTANT_TYPE_STRING}
+        ,   payload(sizeof(std::int32_t) + value.size())
+    {
+        auto be = boost::endian::native_to_big(std::int32_t(value.size()));
+
+        std::memcpy(payload.data(), &be, sizeof(be));
+        std::memcpy(payload.data() + sizeof(be), value.data(), value.size());
+    }
+
+    std::int32_t      type_id {0};
+    std::vector<char> payload;
+};
+
+template<typename T>
+inline std::optional<T> from_data(const data& x);
+
+template<>
+inline std::optional<int> from_data<int>(const data& x)
+{
+    if (x.type_id != data::CONSTANT_TYPE_INTEGER ||
+        x.payload.size() != sizeof(std::int32_t))
+        return std::nullopt;
+
+    std::int32_t be;
+
+    std::memcpy(&be, x.payload.data(), sizeof(be));
+
+    return boost::endian::big_to_native(be);
+}
+
+template<>
+inline std::optional<std::string> from_data<std::string>(const data& x)
+{
+    if (x.type_id != data::CONSTANT_TYPE_STRING ||
+        x.payload.size() < sizeof(std::int32_t))
+        return std::nullopt;
+
+    std::int32_t be;
+
+    std::memcpy(&be, x.payload.data(), sizeof(be));
+
+    auto len = boost::endian::big_to_native(be);
+
+    if (len < 0 || std::size_t(len) > x.payload.size() - sizeof(be))
+        return std::nullopt;
+
+    return std::string {x.payload.data() + sizeof(be), std::size_t(len)};
+}
+
+inline std::int32_t partition_hash(const data& key)
+{
+    return murmur_hash3_x86_32(key.payload.data(), key.payload.size());
+}
+
+inline std::int32_t partition_id(std::int32_t hash, std::int32_t partition_count)
+{
+    if (hash == INT32_MIN)
+        return 0;
+
+    return (hash < 0 ? -hash : hash) % partition_count;
+}
+
+inline std::int32_t partition_id(const data& key, std::int32_t partition_count)
+{
+    return partition_id(partition_hash(key), partition_count);
+}
+
+// Overwrites `x`, reusing the capacity of its payload.
+inline void decode_data(frame_reader& reader, data& x)
+{
+    auto frame = reader.next();
+
+    if (frame.size < std::size_t(data::DATA_OFFSET))
+    {
+        x.type_id = 0;
+        x.payload.clear();
+
+        return;
+    }
+
+    std::int32_t be;
+
+    std::memcpy(&be, frame.content + 4, sizeof(be));
+
+    x.type_id = boost::endian::big_to_native(be);
+    x.payload.assign(frame.content + data::DATA_OFFSET, frame.content + frame.size);
+}
+
+inline data decode_data(frame_reader& reader)
+{
+    data x;
+
+    decode_data(reader, x);
+
+    return x;
+}
+
+inline std::optional<data> decode_nullable_data(frame_reader& reader)
+{
+    if (reader.next_is_null())
+    {
+        reader.next();
+
+        return std::nullopt;
+    }
+
+    return decode_data(reader);
+}
+
+inline std::vector<data> decode_data_list(frame_reader& reader)
+{
+    std::vector<data> items;
+
+    decode_list(
+        reader,
+        [&items](frame_reader& reader)
+        {
+            items.push_back(decode_data(reader));
+        }
+    );
+
+    return items;
+}
+
+inline std::vector<std::optional<data>> decode_nullable_data_list(frame_reader& reader)
+{
+    std::vector<std::optional<data>> items;
+
+    decode_list(
+        reader,
+        [&items](frame_reader& reader)
+        {
+            items.push_back(decode_nullable_data(reader));
+        }
+    );
+
+    return items;
+}
+
+inline std::vector<std::pair<data, data>> decode_entry_list(frame_reader& reader)
+{
+    std::vector<std::pair<data, data>> entries;
+
+    decode_list(
+        reader,
+        [&entries](frame_reader& reader)
+        {
+            auto key = decode_data(reader);
+
+            entries.emplace_back(std::move(key), decode_data(reader));
+        }
+    );
+
+    return entries;
+}
+
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const data& x
+)
+{
+    frame_header header {};
+
+    header.length = frame_header::HEADER_SIZE + data::DATA_OFFSET + x.payload.size();
+
+    ss << header;
+
+    auto prev = ss.byte_order();
+    ss.byte_order(rbs::endian::big);
+
+    ss << std::int32_t(0) << x.type_id;
+
+    ss.byte_order(prev);
+
+    ss.write(x.payload.data(), x.payload.size());
+
+    return ss;
+}
+
+}
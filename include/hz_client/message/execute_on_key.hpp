@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <optional>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/string_serialization.hpp"
+#include "hz_client/message/range_serialization.hpp"
+#include "hz_client/message/data.hpp"
+
+namespace hz_client::message
+{
+
+// Runs `entry_processor` on the member owning `key`. The processor is a
+// serialized object of a class registered on the members, usually built
+// with `to_data` from an `identified_data_serializable` type.
+struct execute_on_key
+{
+    std::string map_name;
+    data entry_processor;
+    data key;
+    std::int64_t thread_id {5000};
+};
+
+struct execute_on_keys
+{
+    std::string map_name;
+    data entry_processor;
+    std::vector<data> keys;
+};
+
+// Runs the processor on every entry of the map, or only on the entries
+// matching `predicate` if one is given.
+struct execute_on_entries
+{
+    std::string map_name;
+    data entry_processor;
+    std::optional<data> predicate;
+};
+
+}
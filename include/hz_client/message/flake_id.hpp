@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/string_serialization.hpp"
+
+namespace hz_client::message
+{
+
+// Reserves `batch_size` ids of a flake id generator, any member may be
+// asked. They are handed out as `base + i * increment` for i below the
+// batch size of the response, which may be smaller than the one asked for.
+struct flake_id_new_batch
+{
+    std::string  name;
+    std::int32_t batch_size {100};
+};
+
+}
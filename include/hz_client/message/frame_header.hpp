@@ -28,7 +28,7 @@ struct frame_header
     static inline constexpr int HEADER_SIZE = 6;
 
     int           length {HEADER_SIZE};
-    std::uint16_t flags;
+    std::uint16_t flags {0};
 };
 
 inline frame_header begin_frame()
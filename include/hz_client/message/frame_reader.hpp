@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <type_traits>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include "hz_client/message/frame_header.hpp"
+
+namespace hz_client::message
+{
+
+struct frame_view
+{
+    frame_header header;
+    const char*  content {nullptr};
+    std::size_t  size {0};
+
+    bool is_null() const
+    {
+        return header.flags & frame_header::IS_NULL_FLAG;
+    }
+
+    bool is_begin() const
+    {
+        return header.flags & frame_header::BEGIN_DATA_STRUCTURE_FLAG;
+    }
+
+    bool is_end() const
+    {
+        return header.flags & frame_header::END_DATA_STRUCTURE_FLAG;
+    }
+};
+
+template<typename T>
+inline T read_fixed(const frame_view& frame, std::size_t offset)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        return frame.content[offset] != 0;
+    }
+    else
+    {
+        T x;
+
+        std::memcpy(&x, frame.content + offset, sizeof(T));
+
+        return boost::endian::little_to_native(x);
+    }
+}
+
+inline boost::uuids::uuid read_uuid(const frame_view& frame, std::size_t offset)
+{
+    boost::uuids::uuid uid {};
+
+    if (read_fixed<bool>(frame, offset))
+        return uid;
+
+    std::memcpy(uid.data, frame.content + offset + 1, sizeof(uid.data));
+
+    std::reverse(std::begin(uid.data), std::begin(uid.data) + 8);
+    std::reverse(std::begin(uid.data) + 8, std::end(uid.data));
+
+    return uid;
+}
+
+class frame_reader
+{
+public:
+
+    frame_reader(const char* data, std::size_t size)
+        :   m_pos {data}
+        ,   m_end {data + size}
+    {}
+
+    explicit frame_reader(const std::vector<char>& message)
+        :   frame_reader {message.data(), message.size()}
+    {}
+
+    bool has_next() const
+    {
+        if (m_end - m_pos < frame_header::HEADER_SIZE)
+            return false;
+
+        auto length = header_at(m_pos).length;
+
+        return length >= frame_header::HEADER_SIZE &&
+               length <= m_end - m_pos;
+    }
+
+    frame_view peek() const
+    {
+        auto header = header_at(m_pos);
+
+        return {
+            header,
+            m_pos + frame_header::HEADER_SIZE,
+            std::size_t(header.length - frame_header::HEADER_SIZE)
+        };
+    }
+
+    frame_view next()
+    {
+        auto frame = peek();
+
+        m_pos += frame.header.length;
+
+        return frame;
+    }
+
+    bool next_is_null() const
+    {
+        return has_next() && peek().is_null();
+    }
+
+    bool next_is_end() const
+    {
+        return has_next() && peek().is_end();
+    }
+
+    // Skips frames up to and including the end frame of the data
+    // structure the reader is currently in.
+    void skip_to_end_of_structure()
+    {
+        int depth {1};
+
+        while (depth > 0 && has_next())
+        {
+            auto frame = next();
+
+            if (frame.is_begin())
+                ++depth;
+            else if (frame.is_end())
+                --depth;
+        }
+    }
+
+    const char* position() const
+    {
+        return m_pos;
+    }
+
+private:
+
+    static frame_header header_at(const char* pos)
+    {
+        frame_header header;
+
+        std::memcpy(&header.length, pos, sizeof(std::int32_t));
+        std::memcpy(&header.flags, pos + sizeof(std::int32_t), sizeof(std::uint16_t));
+
+        boost::endian::little_to_native_inplace(header.length);
+        boost::endian::little_to_native_inplace(header.flags);
+
+        return header;
+    }
+
+    const char* m_pos;
+    const char* m_end;
+};
+
+inline std::string decode_string(frame_reader& reader)
+{
+    auto frame = reader.next();
+
+    return {frame.content, frame.size};
+}
+
+inline std::optional<std::string> decode_nullable_string(frame_reader& reader)
+{
+    if (reader.next_is_null())
+    {
+        reader.next();
+
+        return std::nullopt;
+    }
+
+    return decode_string(reader);
+}
+
+template<typename F>
+inline void decode_list(frame_reader& reader, F&& decode_item)
+{
+    reader.next();
+
+    while (reader.has_next() && !reader.next_is_end())
+        decode_item(reader);
+
+    if (reader.has_next())
+        reader.next();
+}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/frame_header.hpp"
+#include "hz_client/message/frame_reader.hpp"
+#include "hz_client/message/string_serialization.hpp"
+
+namespace hz_client::message
+{
+
+// Position of an iteration inside the partition it runs on. The pointers
+// returned with a batch are sent back to fetch the following batch; the
+// iteration of the partition is over once the last index is negative.
+struct iteration_pointer
+{
+    std::int32_t index {std::numeric_limits<std::int32_t>::max()};
+    std::int32_t size {-1};
+};
+
+inline bool is_iteration_done(const std::vector<iteration_pointer>& pointers)
+{
+    return pointers.empty() || pointers.back().index < 0;
+}
+
+// Fetches up to `batch` keys of the partition the request is sent to.
+struct fetch_keys
+{
+    std::string map_name;
+    std::int32_t batch {100};
+    std::vector<iteration_pointer> pointers {iteration_pointer {}};
+};
+
+struct fetch_entries
+{
+    std::string map_name;
+    std::int32_t batch {100};
+    std::vector<iteration_pointer> pointers {iteration_pointer {}};
+};
+
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const std::vector<iteration_pointer>& x
+)
+{
+    frame_header header {};
+
+    header.length = frame_header::HEADER_SIZE + x.size() * 2 * sizeof(std::int32_t);
+
+    ss << header;
+
+    for (const auto& pointer : x)
+        ss << pointer.index << pointer.size;
+
+    return ss;
+}
+
+inline std::vector<iteration_pointer> decode_iteration_pointers(frame_reader& reader)
+{
+    std::vector<iteration_pointer> pointers;
+
+    auto frame = reader.next();
+
+    for (std::size_t offset = 0; offset + 2 * sizeof(std::int32_t) <= frame.size; offset += 2 * sizeof(std::int32_t))
+    {
+        pointers.push_back({
+            read_fixed<std::int32_t>(frame, offset),
+            read_fixed<std::int32_t>(frame, offset + sizeof(std::int32_t))
+        });
+    }
+
+    return pointers;
+}
+
+inline void decode_variable(frame_reader& reader, std::vector<iteration_pointer>& x)
+{
+    x = decode_iteration_pointers(reader);
+}
+
+}
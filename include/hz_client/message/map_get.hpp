@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/string_serialization.hpp"
+#include "hz_client/message/data.hpp"
+
+namespace hz_client::message
+{
+
+struct map_get
+{
+    std::string map_name;
+    data key;
+    std::int64_t thread_id {5000};
+};
+
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator>>(
+    rbs::stream<Args...>& ss ,
+    map_get& x
+)
+{
+    return ss;
+}
+
+}
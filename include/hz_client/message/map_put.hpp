@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstdint>
+
 #include <rbs/stream.hpp>
 
 #include "hz_client/message/string_serialization.hpp"
 #include "hz_client/message/frame_header.hpp"
+#include "hz_client/message/data.hpp"
 
 namespace hz_client::message
 {
@@ -11,42 +14,12 @@ namespace hz_client::message
 struct map_put
 {
     std::string map_name;
-    int key;
-    int value;
+    data key;
+    data value;
+    std::int64_t thread_id {5000};
+    std::int64_t ttl {-1};
 };
 
-template<auto... Args>
-inline rbs::stream<Args...>&
-operator<<(
-    rbs::stream<Args...>& ss ,
-    const map_put& x
-)
-{
-    using namespace std::string_literals;
-
-    frame_header key_header;
-
-    key_header.flags  = 0;
-    key_header.length = 18;
-
-    auto prev = ss.byte_order();
-    ss.byte_order(rbs::endian::big);
-
-    ss << x.map_name
-       << key_header
-       << 0
-       << -7
-       << x.key
-       << key_header
-       << 0
-       << -7
-       << x.value;
-
-    ss.byte_order(prev);
-
-    return ss;
-}
-
 template<auto... Args>
 inline rbs::stream<Args...>&
 operator>>(
@@ -57,4 +30,4 @@ operator>>(
     return ss;
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <concepts>
+#include <optional>
+
+#include <boost/endian/conversion.hpp>
+
+#include "hz_client/message/data.hpp"
+
+namespace hz_client::message
+{
+
+// Big endian writer for the payload of a `data`, mirroring the member side
+// `ObjectDataOutput`.
+class object_data_output
+{
+public:
+
+    void write_bool(bool x)
+    {
+        m_bytes.push_back(char(x ? 1 : 0));
+    }
+
+    void write_byte(std::int8_t x)
+    {
+        m_bytes.push_back(char(x));
+    }
+
+    void write_short(std::int16_t x)
+    {
+        write_fixed(x);
+    }
+
+    void write_int(std::int32_t x)
+    {
+        write_fixed(x);
+    }
+
+    void write_long(std::int64_t x)
+    {
+        write_fixed(x);
+    }
+
+    void write_float(float x)
+    {
+        std::int32_t bits;
+
+        std::memcpy(&bits, &x, sizeof(bits));
+
+        write_fixed(bits);
+    }
+
+    void write_double(double x)
+    {
+        std::int64_t bits;
+
+        std::memcpy(&bits, &x, sizeof(bits));
+
+        write_fixed(bits);
+    }
+
+    void write_bytes(const char* x, std::size_t n)
+    {
+        m_bytes.insert(end(m_bytes), x, x + n);
+    }
+
+    void write_string(const std::optional<std::string>& x)
+    {
+        if (!x)
+            return write_int(-1);
+
+        write_int(std::int32_t(x->size()));
+        write_bytes(x->data(), x->size());
+    }
+
+    // Nested object, written as its type id followed by its payload.
+    void write_object(const std::optional<data>& x)
+    {
+        if (!x)
+            return write_int(CONSTANT_TYPE_NULL);
+
+        write_int(x->type_id);
+        write_bytes(x->payload.data(), x->payload.size());
+    }
+
+    const std::vector<char>& bytes() const
+    {
+        return m_bytes;
+    }
+
+    std::vector<char> release()
+    {
+        return std::move(m_bytes);
+    }
+
+    static inline constexpr std::int32_t CONSTANT_TYPE_NULL = 0;
+
+private:
+
+    template<typename T>
+    void write_fixed(T x)
+    {
+        auto be = boost::endian::native_to_big(x);
+        auto p  = reinterpret_cast<const char*>(&be);
+
+        m_bytes.insert(end(m_bytes), p, p + sizeof(be));
+    }
+
+    std::vector<char> m_bytes;
+};
+
+// Objects which are known to the members by a factory and a class id, such
+// as entry processors, predicates and aggregators.
+template<typename T>
+concept identified_data_serializable = requires(const T& x, object_data_output& out)
+{
+    { T::factory_id } -> std::convertible_to<std::int32_t>;
+    { T::class_id }   -> std::convertible_to<std::int32_t>;
+    x.write_data(out);
+};
+
+static inline constexpr std::int32_t CONSTANT_TYPE_DATA_SERIALIZABLE = -2;
+
+template<identified_data_serializable T>
+inline data to_data(const T& x)
+{
+    static constexpr std::int8_t IDENTIFIED_FLAG = 1;
+
+    object_data_output out;
+
+    out.write_byte(IDENTIFIED_FLAG);
+    out.write_int(T::factory_id);
+    out.write_int(T::class_id);
+
+    x.write_data(out);
+
+    return {CONSTANT_TYPE_DATA_SERIALIZABLE, out.release()};
+}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <boost/uuid/uuid.hpp>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/frame_header.hpp"
+#include "hz_client/message/frame_reader.hpp"
+#include "hz_client/message/string_serialization.hpp"
+#include "hz_client/message/uuid_serialization.hpp"
+
+namespace hz_client::message
+{
+
+// Logical timestamps of the replicas of a PN counter, as last observed by
+// the client. A replica asked with them answers with a state at least as
+// recent, which is what makes the reads of a session monotonic.
+struct replica_timestamps
+{
+    std::vector<std::pair<boost::uuids::uuid, std::int64_t>> entries;
+
+    // Keeps the later timestamp of each replica.
+    void merge(const replica_timestamps& x)
+    {
+        for (const auto& [replica, timestamp] : x.entries)
+        {
+            auto it = std::find_if(
+                begin(entries),
+                end(entries),
+                [&replica](const auto& e) { return e.first == replica; }
+            );
+
+            if (it == end(entries))
+                entries.emplace_back(replica, timestamp);
+            else
+                it->second = std::max(it->second, timestamp);
+        }
+    }
+};
+
+// Reads the counter on `target_replica`, which is the member the request is
+// sent to.
+struct pn_counter_get
+{
+    boost::uuids::uuid target_replica {};
+    std::string        name;
+    replica_timestamps timestamps;
+};
+
+// Adds `delta` on `target_replica`, completing with the value before or
+// after the update.
+struct pn_counter_add
+{
+    std::int64_t       delta {0};
+    bool               get_before_update {false};
+    boost::uuids::uuid target_replica {};
+    std::string        name;
+    replica_timestamps timestamps;
+};
+
+// A single frame of the entries, each one the uuid of the replica followed
+// by its timestamp.
+static inline constexpr std::size_t REPLICA_TIMESTAMP_SIZE = 17 + sizeof(std::int64_t);
+
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const replica_timestamps& x
+)
+{
+    frame_header header {};
+
+    header.length = int(frame_header::HEADER_SIZE + x.entries.size() * REPLICA_TIMESTAMP_SIZE);
+
+    ss << header;
+
+    for (const auto& [replica, timestamp] : x.entries)
+        ss << replica << timestamp;
+
+    return ss;
+}
+
+inline void decode_variable(frame_reader& reader, replica_timestamps& x)
+{
+    auto frame = reader.next();
+
+    x.entries.clear();
+
+    for (std::size_t offset = 0; offset + REPLICA_TIMESTAMP_SIZE <= frame.size; offset += REPLICA_TIMESTAMP_SIZE)
+    {
+        x.entries.emplace_back(
+            read_uuid(frame, offset),
+            read_fixed<std::int64_t>(frame, offset + 17)
+        );
+    }
+}
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <optional>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/frame_header.hpp"
+#include "hz_client/message/frame_reader.hpp"
+#include "hz_client/message/string_serialization.hpp"
+#include "hz_client/message/optional_serialization.hpp"
+#include "hz_client/message/data.hpp"
+
+namespace hz_client::message
+{
+
+enum class iteration_type : std::uint8_t
+{
+    key   = 0,
+    value = 1,
+    entry = 2
+};
+
+struct key_set_with_predicate
+{
+    std::string map_name;
+    data predicate;
+};
+
+struct values_with_predicate
+{
+    std::string map_name;
+    data predicate;
+};
+
+struct entries_with_predicate
+{
+    std::string map_name;
+    data predicate;
+};
+
+// Without a predicate the projection is applied to every entry.
+struct project_with_predicate
+{
+    std::string map_name;
+    data projection;
+    std::optional<data> predicate;
+};
+
+// Without a predicate every entry is aggregated.
+struct aggregate_with_predicate
+{
+    std::string map_name;
+    data aggregator;
+    std::optional<data> predicate;
+};
+
+// Position of the last entry of each page fetched so far. It is returned
+// with every page and has to be sent back to fetch the following one.
+struct anchor_data_list
+{
+    std::vector<std::int32_t>          pages;
+    std::vector<std::pair<data, data>> anchors;
+};
+
+struct paging_predicate_holder
+{
+    std::int32_t        page_size {100};
+    std::int32_t        page {0};
+    iteration_type      type {iteration_type::entry};
+    anchor_data_list    anchor_list;
+    std::optional<data> predicate;
+    std::optional<data> comparator;
+    std::optional<data> partition_key;
+};
+
+template<iteration_type Type>
+struct query_with_paging_predicate
+{
+    std::string map_name;
+    paging_predicate_holder predicate;
+};
+
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const anchor_data_list& x
+)
+{
+    frame_header pages_header {};
+
+    pages_header.length = frame_header::HEADER_SIZE + x.pages.size() * sizeof(std::int32_t);
+
+    ss << begin_frame() << pages_header;
+
+    for (auto page : x.pages)
+        ss << page;
+
+    ss << begin_frame();
+
+    for (const auto& [key, value] : x.anchors)
+        ss << key << value;
+
+    return ss << end_frame() << end_frame();
+}
+
+template<auto... Args>
+inline rbs::stream<Args...>&
+operator<<(
+    rbs::stream<Args...>& ss ,
+    const paging_predicate_holder& x
+)
+{
+    frame_header initial {};
+
+    initial.length = frame_header::HEADER_SIZE + 9;
+
+    return ss << begin_frame()
+              << initial
+              << x.page_size
+              << x.page
+              << std::uint8_t(x.type)
+              << x.anchor_list
+              << x.predicate
+              << x.comparator
+              << x.partition_key
+              << end_frame();
+}
+
+inline anchor_data_list decode_anchor_data_list(frame_reader& reader)
+{
+    anchor_data_list x;
+
+    reader.next();
+
+    auto pages = reader.next();
+
+    for (std::size_t offset = 0; offset + sizeof(std::int32_t) <= pages.size; offset += sizeof(std::int32_t))
+        x.pages.push_back(read_fixed<std::int32_t>(pages, offset));
+
+    x.anchors = decode_entry_list(reader);
+
+    reader.skip_to_end_of_structure();
+
+    return x;
+}
+
+inline void decode_variable(frame_reader& reader, anchor_data_list& x)
+{
+    x = decode_anchor_data_list(reader);
+}
+
+}
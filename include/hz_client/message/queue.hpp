@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/string_serialization.hpp"
+#include "hz_client/message/data.hpp"
+
+namespace hz_client::message
+{
+
+// Removes up to `max_size` items from the head of the queue and returns
+// them, without waiting for any when the queue is empty.
+struct queue_drain_to
+{
+    std::string  name;
+    std::int32_t max_size {1};
+};
+
+struct queue_add_all
+{
+    std::string       name;
+    std::vector<data> items;
+};
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <boost/endian/conversion.hpp>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/initial_frame.hpp"
+
+namespace hz_client::message
+{
+
+// An already encoded message, such as one read from a capture file. It is
+// sent as it is, except for its correlation id which is replaced by the one
+// of the invocation.
+struct raw_message
+{
+    std::vector<char> bytes;
+};
+
+inline std::uint64_t read_correlation_id(const std::vector<char>& message)
+{
+    static constexpr std::size_t CORRELATION_ID_OFFSET = frame_header::HEADER_SIZE + 4;
+
+    std::uint64_t x {0};
+
+    if (message.size() >= CORRELATION_ID_OFFSET + sizeof(x))
+        std::memcpy(&x, message.data() + CORRELATION_ID_OFFSET, sizeof(x));
+
+    return boost::endian::little_to_native(x);
+}
+
+}
@@ -1,10 +1,30 @@
 #pragma once
 
+#include <cstring>
+#include <type_traits>
+
+#include <boost/endian/conversion.hpp>
+
 #include "hz_client/message/initial_frame.hpp"
+#include "hz_client/message/codec.hpp"
 #include "hz_client/message/range_serialization.hpp"
 #include "hz_client/message/authentication.hpp"
+#include "hz_client/message/backup_listener.hpp"
 #include "hz_client/message/create_map.hpp"
+#include "hz_client/message/create_proxies.hpp"
+#include "hz_client/message/cluster_view.hpp"
 #include "hz_client/message/map_put.hpp"
+#include "hz_client/message/map_get.hpp"
+#include "hz_client/message/execute_on_key.hpp"
+#include "hz_client/message/query.hpp"
+#include "hz_client/message/map_fetch.hpp"
+#include "hz_client/message/ringbuffer.hpp"
+#include "hz_client/message/queue.hpp"
+#include "hz_client/message/flake_id.hpp"
+#include "hz_client/message/send_schema.hpp"
+#include "hz_client/message/pn_counter.hpp"
+#include "hz_client/message/atomic_long.hpp"
+#include "hz_client/message/raw_message.hpp"
 #include "hz_client/message/ping.hpp"
 
 namespace hz_client::message
@@ -17,91 +37,613 @@ struct request
     T entity;
 };
 
-template<auto... Args>
-rbs::stream<Args...>&
-operator<<(
-    rbs::stream<Args...>& ss ,
-    const request<authentication>& req
-)
+// Invocations of retryable messages are sent again after the connection
+// is re-established instead of being failed. Only messages which are safe
+// to be executed more than once should be marked.
+template<typename T>
+struct is_retryable : std::false_type
+{};
+
+template<>
+struct is_retryable<ping> : std::true_type
+{};
+
+template<>
+struct is_retryable<create_map> : std::true_type
+{};
+
+template<>
+struct is_retryable<create_proxies> : std::true_type
+{};
+
+template<>
+struct is_retryable<map_get> : std::true_type
+{};
+
+template<>
+struct is_retryable<key_set_with_predicate> : std::true_type
+{};
+
+template<>
+struct is_retryable<values_with_predicate> : std::true_type
+{};
+
+template<>
+struct is_retryable<entries_with_predicate> : std::true_type
+{};
+
+template<>
+struct is_retryable<project_with_predicate> : std::true_type
+{};
+
+template<>
+struct is_retryable<aggregate_with_predicate> : std::true_type
+{};
+
+template<iteration_type Type>
+struct is_retryable<query_with_paging_predicate<Type>> : std::true_type
+{};
+
+template<>
+struct is_retryable<fetch_keys> : std::true_type
+{};
+
+template<>
+struct is_retryable<fetch_entries> : std::true_type
+{};
+
+template<>
+struct is_retryable<ringbuffer_read_many> : std::true_type
+{};
+
+// A batch fetched twice only leaves a gap in the ids.
+template<>
+struct is_retryable<flake_id_new_batch> : std::true_type
+{};
+
+template<>
+struct is_retryable<send_schema> : std::true_type
+{};
+
+template<>
+struct is_retryable<pn_counter_get> : std::true_type
+{};
+
+template<>
+struct is_retryable<create_cp_group> : std::true_type
+{};
+
+template<>
+struct is_retryable<atomic_long_get> : std::true_type
+{};
+
+template<typename T>
+static inline constexpr bool is_retryable_v = is_retryable<T>::value;
+
+// Requests of shareable messages may wait for the response to an identical
+// one in flight instead of being sent. Only reads are marked: a retryable
+// request which creates something, or hands out ids, has to reach the
+// member once per invocation.
+template<typename T>
+struct is_shareable : std::false_type
+{};
+
+template<>
+struct is_shareable<map_get> : std::true_type
+{};
+
+template<>
+struct is_shareable<key_set_with_predicate> : std::true_type
+{};
+
+template<>
+struct is_shareable<values_with_predicate> : std::true_type
+{};
+
+template<>
+struct is_shareable<entries_with_predicate> : std::true_type
+{};
+
+template<>
+struct is_shareable<project_with_predicate> : std::true_type
+{};
+
+template<>
+struct is_shareable<aggregate_with_predicate> : std::true_type
+{};
+
+template<iteration_type Type>
+struct is_shareable<query_with_paging_predicate<Type>> : std::true_type
+{};
+
+template<>
+struct is_shareable<fetch_keys> : std::true_type
+{};
+
+template<>
+struct is_shareable<fetch_entries> : std::true_type
+{};
+
+template<>
+struct is_shareable<ringbuffer_read_many> : std::true_type
+{};
+
+template<>
+struct is_shareable<pn_counter_get> : std::true_type
+{};
+
+template<>
+struct is_shareable<atomic_long_get> : std::true_type
+{};
+
+template<typename T>
+static inline constexpr bool is_shareable_v = is_shareable<T>::value;
+
+template<>
+struct request_codec<authentication>
 {
-    req.header.length = 40;
+    static inline constexpr std::int32_t message_type = 256;
+    static inline constexpr auto partition = partition_policy::any;
 
-    req.header.flags = uint16_t(
-        frame_header::BEGIN_FRAGMENT_FLAG |
-        frame_header::END_FRAGMENT_FLAG
-    );
+    using layout = fields<
+        field<&authentication::uid>,
+        field<&authentication::serialization_version>,
+        field<&authentication::cluster_name>,
+        field<&authentication::username>,
+        field<&authentication::password>,
+        field<&authentication::client_type>,
+        field<&authentication::client_version>,
+        field<&authentication::instance_name>,
+        list_field<&authentication::labels>
+    >;
+};
 
-    req.header.type           = 256;
-    req.header.partition_id   = -1;
+template<>
+struct request_codec<ping>
+{
+    static inline constexpr std::int32_t message_type = 2816;
+    static inline constexpr auto partition = partition_policy::any;
 
-    return ss << req.header
-              << req.entity
-              << final_frame();
-}
+    using layout = fields<>;
+};
 
-template<auto... Args>
-rbs::stream<Args...>&
-operator<<(
-    rbs::stream<Args...>& ss ,
-    const request<ping>& req
-)
+template<>
+struct request_codec<create_map>
 {
-    req.header.length = 22;
+    static inline constexpr std::int32_t message_type = 1024;
+    static inline constexpr auto partition = partition_policy::any;
 
-    req.header.flags = uint16_t(
-        frame_header::BEGIN_FRAGMENT_FLAG |
-        frame_header::END_FRAGMENT_FLAG |
-        frame_header::IS_FINAL_FLAG
-    );
+    using layout = fields<
+        field<&create_map::name>,
+        field<&create_map::service_name>
+    >;
+};
 
-    req.header.type           = 2816;
-    req.header.partition_id   = -1;
+template<>
+struct request_codec<create_proxies>
+{
+    static inline constexpr std::int32_t message_type = 3584;
+    static inline constexpr auto partition = partition_policy::any;
 
-    return ss << req.header;
-}
+    using layout = fields<
+        list_field<&create_proxies::proxies>
+    >;
+};
 
-template<auto... Args>
+template<>
+struct request_codec<add_local_backup_listener>
+{
+    static inline constexpr std::int32_t message_type = 3840;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<>;
+};
+
+template<>
+struct request_codec<add_cluster_view_listener>
+{
+    static inline constexpr std::int32_t message_type = 768;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<>;
+};
+
+template<>
+struct request_codec<map_put>
+{
+    static inline constexpr std::int32_t message_type = 65792;
+    static inline constexpr auto partition = partition_policy::keyed;
+
+    using layout = fields<
+        field<&map_put::thread_id>,
+        field<&map_put::ttl>,
+        field<&map_put::map_name>,
+        field<&map_put::key>,
+        field<&map_put::value>
+    >;
+};
+
+template<>
+struct request_codec<map_get>
+{
+    static inline constexpr std::int32_t message_type = 66048;
+    static inline constexpr auto partition = partition_policy::keyed;
+
+    using layout = fields<
+        field<&map_get::thread_id>,
+        field<&map_get::map_name>,
+        field<&map_get::key>
+    >;
+};
+
+template<>
+struct request_codec<execute_on_key>
+{
+    static inline constexpr std::int32_t message_type = 77312;
+    static inline constexpr auto partition = partition_policy::keyed;
+
+    using layout = fields<
+        field<&execute_on_key::thread_id>,
+        field<&execute_on_key::map_name>,
+        field<&execute_on_key::entry_processor>,
+        field<&execute_on_key::key>
+    >;
+};
+
+template<>
+struct request_codec<execute_on_keys>
+{
+    static inline constexpr std::int32_t message_type = 78336;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&execute_on_keys::map_name>,
+        field<&execute_on_keys::entry_processor>,
+        list_field<&execute_on_keys::keys>
+    >;
+};
+
+template<>
+struct request_codec<execute_on_entries>
+{
+    static constexpr std::int32_t message_type(const execute_on_entries& x)
+    {
+        return x.predicate ? 78080 : 77824;
+    }
+
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&execute_on_entries::map_name>,
+        field<&execute_on_entries::entry_processor>,
+        trailing_field<&execute_on_entries::predicate>
+    >;
+};
+
+template<>
+struct request_codec<key_set_with_predicate>
+{
+    static inline constexpr std::int32_t message_type = 75264;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&key_set_with_predicate::map_name>,
+        field<&key_set_with_predicate::predicate>
+    >;
+};
+
+template<>
+struct request_codec<values_with_predicate>
+{
+    static inline constexpr std::int32_t message_type = 75520;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&values_with_predicate::map_name>,
+        field<&values_with_predicate::predicate>
+    >;
+};
+
+template<>
+struct request_codec<entries_with_predicate>
+{
+    static inline constexpr std::int32_t message_type = 75776;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&entries_with_predicate::map_name>,
+        field<&entries_with_predicate::predicate>
+    >;
+};
+
+template<>
+struct request_codec<project_with_predicate>
+{
+    static constexpr std::int32_t message_type(const project_with_predicate& x)
+    {
+        return x.predicate ? 80896 : 80640;
+    }
+
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&project_with_predicate::map_name>,
+        field<&project_with_predicate::projection>,
+        trailing_field<&project_with_predicate::predicate>
+    >;
+};
+
+template<>
+struct request_codec<aggregate_with_predicate>
+{
+    static constexpr std::int32_t message_type(const aggregate_with_predicate& x)
+    {
+        return x.predicate ? 80384 : 80128;
+    }
+
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&aggregate_with_predicate::map_name>,
+        field<&aggregate_with_predicate::aggregator>,
+        trailing_field<&aggregate_with_predicate::predicate>
+    >;
+};
+
+template<iteration_type Type>
+struct request_codec<query_with_paging_predicate<Type>>
+{
+    static inline constexpr std::int32_t message_type =
+        Type == iteration_type::key   ? 78848 :
+        Type == iteration_type::value ? 79104 :
+                                        79360;
+
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&query_with_paging_predicate<Type>::map_name>,
+        field<&query_with_paging_predicate<Type>::predicate>
+    >;
+};
+
+template<>
+struct request_codec<fetch_keys>
+{
+    static inline constexpr std::int32_t message_type = 79616;
+    static inline constexpr auto partition = partition_policy::keyed;
+
+    using layout = fields<
+        field<&fetch_keys::batch>,
+        field<&fetch_keys::map_name>,
+        field<&fetch_keys::pointers>
+    >;
+};
+
+template<>
+struct request_codec<fetch_entries>
+{
+    static inline constexpr std::int32_t message_type = 79872;
+    static inline constexpr auto partition = partition_policy::keyed;
+
+    using layout = fields<
+        field<&fetch_entries::batch>,
+        field<&fetch_entries::map_name>,
+        field<&fetch_entries::pointers>
+    >;
+};
+
+template<>
+struct request_codec<ringbuffer_read_many>
+{
+    static inline constexpr std::int32_t message_type = 1509632;
+    static inline constexpr auto partition = partition_policy::keyed;
+
+    using layout = fields<
+        field<&ringbuffer_read_many::start_sequence>,
+        field<&ringbuffer_read_many::min_count>,
+        field<&ringbuffer_read_many::max_count>,
+        field<&ringbuffer_read_many::name>,
+        field<&ringbuffer_read_many::filter>
+    >;
+};
+
+template<>
+struct request_codec<queue_drain_to>
+{
+    static inline constexpr std::int32_t message_type = 199168;
+    static inline constexpr auto partition = partition_policy::keyed;
+
+    using layout = fields<
+        field<&queue_drain_to::max_size>,
+        field<&queue_drain_to::name>
+    >;
+};
+
+template<>
+struct request_codec<queue_add_all>
+{
+    static inline constexpr std::int32_t message_type = 200704;
+    static inline constexpr auto partition = partition_policy::keyed;
+
+    using layout = fields<
+        field<&queue_add_all::name>,
+        list_field<&queue_add_all::items>
+    >;
+};
+
+template<>
+struct request_codec<flake_id_new_batch>
+{
+    static inline constexpr std::int32_t message_type = 1835264;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&flake_id_new_batch::batch_size>,
+        field<&flake_id_new_batch::name>
+    >;
+};
+
+template<>
+struct request_codec<send_schema>
+{
+    static inline constexpr std::int32_t message_type = 4864;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&send_schema::schema>
+    >;
+};
+
+template<>
+struct request_codec<pn_counter_get>
+{
+    static inline constexpr std::int32_t message_type = 1900800;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&pn_counter_get::target_replica>,
+        field<&pn_counter_get::name>,
+        field<&pn_counter_get::timestamps>
+    >;
+};
+
+template<>
+struct request_codec<pn_counter_add>
+{
+    static inline constexpr std::int32_t message_type = 1901056;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&pn_counter_add::delta>,
+        field<&pn_counter_add::get_before_update>,
+        field<&pn_counter_add::target_replica>,
+        field<&pn_counter_add::name>,
+        field<&pn_counter_add::timestamps>
+    >;
+};
+
+template<>
+struct request_codec<create_cp_group>
+{
+    static inline constexpr std::int32_t message_type = 1966336;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&create_cp_group::proxy_name>
+    >;
+};
+
+template<>
+struct request_codec<atomic_long_add_and_get>
+{
+    static inline constexpr std::int32_t message_type = 590592;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&atomic_long_add_and_get::delta>,
+        field<&atomic_long_add_and_get::group_id>,
+        field<&atomic_long_add_and_get::name>
+    >;
+};
+
+template<>
+struct request_codec<atomic_long_get>
+{
+    static inline constexpr std::int32_t message_type = 591104;
+    static inline constexpr auto partition = partition_policy::any;
+
+    using layout = fields<
+        field<&atomic_long_get::group_id>,
+        field<&atomic_long_get::name>
+    >;
+};
+
+// Encodes any message with a `request_codec`. The initial frame holds the
+// fixed-size fields, so its length is known at compile time; a message
+// without variable-size fields is a single, final frame.
+template<auto... Args, has_request_codec T>
 rbs::stream<Args...>&
 operator<<(
     rbs::stream<Args...>& ss ,
-    const request<create_map>& req
+    const request<T>& req
 )
 {
-    req.header.length = 22;
+    using codec  = request_codec<T>;
+    using layout = layout_traits<typename codec::layout>;
+
+    check_layout<codec>();
+
+    static constexpr std::int32_t length = REQUEST_INITIAL_FRAME_SIZE + layout::fixed_size;
 
+    req.header.length = length;
+
+    // The backup-aware flag is set by the connection, before encoding.
     req.header.flags = uint16_t(
-        frame_header::BEGIN_FRAGMENT_FLAG |
-        frame_header::END_FRAGMENT_FLAG
+        frame_header::UNFRAGMENTED_MESSAGE |
+        (layout::has_variable ? 0 : frame_header::IS_FINAL_FLAG) |
+        (req.header.flags & frame_header::BACKUP_AWARE_FLAG)
     );
 
-    req.header.type           = 1024;
-    req.header.partition_id   = -1;
+    req.header.type = message_type_of<codec>(req.entity);
+
+    if constexpr (codec::partition == partition_policy::any)
+        req.header.partition_id = -1;
+
+    ss << req.header;
 
-    return ss << req.header << req.entity << final_frame();
+    encode_fields(ss, req.entity, typename codec::layout {});
+
+    if constexpr (layout::has_variable)
+        ss << final_frame();
+
+    return ss;
+}
+
+// At most the encoded size of `req`, its frame headers left out, which is
+// what large messages are told apart by.
+template<typename T>
+inline std::size_t estimated_size(const request<T>& req)
+{
+    return REQUEST_INITIAL_FRAME_SIZE
+         + fields_payload_size(req.entity, typename request_codec<T>::layout {});
+}
+
+inline std::size_t estimated_size(const request<raw_message>& req)
+{
+    return req.entity.bytes.size();
 }
 
 template<auto... Args>
 rbs::stream<Args...>&
 operator<<(
     rbs::stream<Args...>& ss ,
-    const request<map_put>& req
+    const request<raw_message>& req
 )
 {
-    req.header.length = 38;
+    const auto& bytes = req.entity.bytes;
 
-    req.header.flags = uint16_t(
-        frame_header::BEGIN_FRAGMENT_FLAG |
-        frame_header::END_FRAGMENT_FLAG
-    );
+    if (bytes.size() < REQUEST_INITIAL_FRAME_SIZE)
+    {
+        ss.write(bytes.data(), bytes.size());
+
+        return ss;
+    }
+
+    auto read = [&bytes]<typename T>(std::size_t offset, T& x)
+    {
+        std::memcpy(&x, bytes.data() + offset, sizeof(T));
+        boost::endian::little_to_native_inplace(x);
+    };
+
+    read(0, req.header.length);
+    read(4, req.header.flags);
+    read(6, req.header.type);
+    read(18, req.header.partition_id);
 
-    req.header.type           = 65792;
-    req.header.partition_id   = 50;
+    ss << req.header;
+    ss.write(bytes.data() + REQUEST_INITIAL_FRAME_SIZE, bytes.size() - REQUEST_INITIAL_FRAME_SIZE);
 
-    return ss << req.header
-              << std::int64_t(5000)
-              << std::int64_t(-1)
-              << req.entity
-              << final_frame();
+    return ss;
 }
 
 }
\ No newline at end of file
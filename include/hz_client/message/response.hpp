@@ -0,0 +1,564 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <optional>
+
+#include <boost/system/error_code.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/message/frame_reader.hpp"
+#include "hz_client/message/codec.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/authentication.hpp"
+#include "hz_client/message/backup_listener.hpp"
+#include "hz_client/message/create_map.hpp"
+#include "hz_client/message/create_proxies.hpp"
+#include "hz_client/message/cluster_view.hpp"
+#include "hz_client/message/map_put.hpp"
+#include "hz_client/message/map_get.hpp"
+#include "hz_client/message/execute_on_key.hpp"
+#include "hz_client/message/query.hpp"
+#include "hz_client/message/map_fetch.hpp"
+#include "hz_client/message/ringbuffer.hpp"
+#include "hz_client/message/queue.hpp"
+#include "hz_client/message/flake_id.hpp"
+#include "hz_client/message/send_schema.hpp"
+#include "hz_client/message/pn_counter.hpp"
+#include "hz_client/message/atomic_long.hpp"
+#include "hz_client/message/ping.hpp"
+
+namespace hz_client::message
+{
+
+// Offsets inside the content of the initial frame of a response.
+static inline constexpr std::size_t RESPONSE_TYPE_OFFSET        = 0;
+static inline constexpr std::size_t RESPONSE_BACKUP_ACKS_OFFSET = 12;
+static inline constexpr std::size_t RESPONSE_FIXED_OFFSET       = 13;
+
+// Events carry a partition id where responses carry the backup acks.
+static inline constexpr std::size_t EVENT_FIXED_OFFSET = 16;
+
+static inline constexpr std::int32_t EXCEPTION_MESSAGE_TYPE = 0;
+
+template<typename T>
+struct response;
+
+template<>
+struct response<authentication>
+{
+    std::uint8_t       status {0};
+    boost::uuids::uuid member_uuid {};
+    std::uint8_t       serialization_version {0};
+    std::int32_t       partition_count {0};
+    boost::uuids::uuid cluster_id {};
+    bool               failover_supported {false};
+};
+
+template<>
+struct response<ping>
+{};
+
+template<>
+struct response<create_map>
+{};
+
+template<>
+struct response<create_proxies>
+{};
+
+// The registration id is left out, the listener is never removed.
+template<>
+struct response<add_local_backup_listener>
+{};
+
+template<>
+struct response<add_cluster_view_listener>
+{};
+
+template<>
+struct response<map_put>
+{
+    std::optional<data> previous;
+};
+
+template<>
+struct response<map_get>
+{
+    std::optional<data> value;
+};
+
+template<>
+struct response<execute_on_key>
+{
+    std::optional<data> result;
+};
+
+template<>
+struct response<execute_on_keys>
+{
+    std::vector<std::pair<data, data>> results;
+};
+
+template<>
+struct response<execute_on_entries>
+{
+    std::vector<std::pair<data, data>> results;
+};
+
+template<>
+struct response<key_set_with_predicate>
+{
+    std::vector<data> keys;
+};
+
+template<>
+struct response<values_with_predicate>
+{
+    std::vector<data> values;
+};
+
+template<>
+struct response<entries_with_predicate>
+{
+    std::vector<std::pair<data, data>> entries;
+};
+
+template<>
+struct response<project_with_predicate>
+{
+    std::vector<std::optional<data>> results;
+};
+
+template<>
+struct response<aggregate_with_predicate>
+{
+    std::optional<data> result;
+};
+
+template<>
+struct response<fetch_keys>
+{
+    std::vector<iteration_pointer> pointers;
+    std::vector<data>              keys;
+};
+
+template<>
+struct response<fetch_entries>
+{
+    std::vector<iteration_pointer>     pointers;
+    std::vector<std::pair<data, data>> entries;
+};
+
+// The sequences of the items, sent when a filter is given, follow the items
+// and are not decoded; `next_sequence` is where the next read starts.
+template<>
+struct response<ringbuffer_read_many>
+{
+    std::int32_t      read_count {0};
+    std::int64_t      next_sequence {0};
+    std::vector<data> items;
+};
+
+template<>
+struct response<queue_drain_to>
+{
+    std::vector<data> items;
+};
+
+template<>
+struct response<queue_add_all>
+{
+    bool changed {false};
+};
+
+template<>
+struct response<flake_id_new_batch>
+{
+    std::int64_t base {0};
+    std::int64_t increment {0};
+    std::int32_t batch_size {0};
+};
+
+// The members the schema is replicated to are left out.
+template<>
+struct response<send_schema>
+{};
+
+// Both PN counter operations answer with the value and the timestamps of
+// the replicas as of the response.
+struct pn_counter_response
+{
+    std::int64_t       value {0};
+    std::int32_t       replica_count {0};
+    replica_timestamps timestamps;
+};
+
+template<>
+struct response<pn_counter_get> : pn_counter_response
+{};
+
+template<>
+struct response<pn_counter_add> : pn_counter_response
+{};
+
+template<>
+struct response<create_cp_group>
+{
+    raft_group_id group_id;
+};
+
+template<>
+struct response<atomic_long_add_and_get>
+{
+    std::int64_t value {0};
+};
+
+template<>
+struct response<atomic_long_get>
+{
+    std::int64_t value {0};
+};
+
+template<>
+struct response_codec<authentication>
+{
+    using layout = fields<
+        field<&response<authentication>::status>,
+        field<&response<authentication>::member_uuid>,
+        field<&response<authentication>::serialization_version>,
+        field<&response<authentication>::partition_count>,
+        field<&response<authentication>::cluster_id>,
+        field<&response<authentication>::failover_supported>
+    >;
+};
+
+template<>
+struct response_codec<ping>
+{
+    using layout = fields<>;
+};
+
+template<>
+struct response_codec<create_map>
+{
+    using layout = fields<>;
+};
+
+template<>
+struct response_codec<create_proxies>
+{
+    using layout = fields<>;
+};
+
+template<>
+struct response_codec<add_local_backup_listener>
+{
+    using layout = fields<>;
+};
+
+template<>
+struct response_codec<add_cluster_view_listener>
+{
+    using layout = fields<>;
+};
+
+template<>
+struct response_codec<map_put>
+{
+    using layout = fields<
+        field<&response<map_put>::previous>
+    >;
+};
+
+template<>
+struct response_codec<map_get>
+{
+    using layout = fields<
+        field<&response<map_get>::value>
+    >;
+};
+
+template<>
+struct response_codec<execute_on_key>
+{
+    using layout = fields<
+        field<&response<execute_on_key>::result>
+    >;
+};
+
+template<>
+struct response_codec<execute_on_keys>
+{
+    using layout = fields<
+        field<&response<execute_on_keys>::results>
+    >;
+};
+
+template<>
+struct response_codec<execute_on_entries>
+{
+    using layout = fields<
+        field<&response<execute_on_entries>::results>
+    >;
+};
+
+template<>
+struct response_codec<key_set_with_predicate>
+{
+    using layout = fields<
+        field<&response<key_set_with_predicate>::keys>
+    >;
+};
+
+template<>
+struct response_codec<values_with_predicate>
+{
+    using layout = fields<
+        field<&response<values_with_predicate>::values>
+    >;
+};
+
+template<>
+struct response_codec<entries_with_predicate>
+{
+    using layout = fields<
+        field<&response<entries_with_predicate>::entries>
+    >;
+};
+
+template<>
+struct response_codec<project_with_predicate>
+{
+    using layout = fields<
+        field<&response<project_with_predicate>::results>
+    >;
+};
+
+template<>
+struct response_codec<aggregate_with_predicate>
+{
+    using layout = fields<
+        field<&response<aggregate_with_predicate>::result>
+    >;
+};
+
+template<>
+struct response_codec<fetch_keys>
+{
+    using layout = fields<
+        field<&response<fetch_keys>::pointers>,
+        field<&response<fetch_keys>::keys>
+    >;
+};
+
+template<>
+struct response_codec<fetch_entries>
+{
+    using layout = fields<
+        field<&response<fetch_entries>::pointers>,
+        field<&response<fetch_entries>::entries>
+    >;
+};
+
+template<>
+struct response_codec<ringbuffer_read_many>
+{
+    using layout = fields<
+        field<&response<ringbuffer_read_many>::read_count>,
+        field<&response<ringbuffer_read_many>::next_sequence>,
+        field<&response<ringbuffer_read_many>::items>
+    >;
+};
+
+template<>
+struct response_codec<queue_drain_to>
+{
+    using layout = fields<
+        field<&response<queue_drain_to>::items>
+    >;
+};
+
+template<>
+struct response_codec<queue_add_all>
+{
+    using layout = fields<
+        field<&response<queue_add_all>::changed>
+    >;
+};
+
+template<>
+struct response_codec<flake_id_new_batch>
+{
+    using layout = fields<
+        field<&response<flake_id_new_batch>::base>,
+        field<&response<flake_id_new_batch>::increment>,
+        field<&response<flake_id_new_batch>::batch_size>
+    >;
+};
+
+template<>
+struct response_codec<send_schema>
+{
+    using layout = fields<>;
+};
+
+template<>
+struct response_codec<pn_counter_get>
+{
+    using layout = fields<
+        field<&pn_counter_response::value>,
+        field<&pn_counter_response::replica_count>,
+        field<&pn_counter_response::timestamps>
+    >;
+};
+
+template<>
+struct response_codec<pn_counter_add>
+{
+    using layout = response_codec<pn_counter_get>::layout;
+};
+
+template<>
+struct response_codec<create_cp_group>
+{
+    using layout = fields<
+        field<&response<create_cp_group>::group_id>
+    >;
+};
+
+template<>
+struct response_codec<atomic_long_add_and_get>
+{
+    using layout = fields<
+        field<&response<atomic_long_add_and_get>::value>
+    >;
+};
+
+template<>
+struct response_codec<atomic_long_get>
+{
+    using layout = fields<
+        field<&response<atomic_long_get>::value>
+    >;
+};
+
+// Decodes any response with a `response_codec`. Fixed-size fields are read
+// from the initial frame at offsets known at compile time, frames following
+// the listed variable-size ones are ignored.
+template<has_response_codec T>
+inline boost::system::error_code decode(frame_reader& reader, response<T>& x)
+{
+    using codec  = response_codec<T>;
+    using layout = layout_traits<typename codec::layout>;
+
+    check_layout<codec>();
+
+    auto initial = reader.next();
+
+    if (initial.size < RESPONSE_FIXED_OFFSET + layout::fixed_size)
+        return error::malformed_response;
+
+    return decode_fields(reader, initial, RESPONSE_FIXED_OFFSET, x, typename codec::layout {});
+}
+
+template<typename T>
+inline boost::system::error_code decode_response(
+    const std::vector<char>& message,
+    response<T>& x
+)
+{
+    frame_reader reader {message};
+
+    if (!reader.has_next())
+        return error::malformed_response;
+
+    auto initial = reader.peek();
+
+    if (initial.size < RESPONSE_FIXED_OFFSET)
+        return error::malformed_response;
+
+    if (read_fixed<std::int32_t>(initial, RESPONSE_TYPE_OFFSET) == EXCEPTION_MESSAGE_TYPE)
+        return error::remote_exception;
+
+    return decode(reader, x);
+}
+
+template<>
+struct event_codec<partitions_view_event>
+{
+    static inline constexpr std::int32_t message_type = 771;
+
+    using layout = fields<
+        field<&partitions_view_event::version>,
+        field<&partitions_view_event::partitions>
+    >;
+};
+
+template<>
+struct event_codec<backup_event>
+{
+    static inline constexpr std::int32_t message_type = 3842;
+
+    using layout = fields<
+        field<&backup_event::source_correlation_id>
+    >;
+};
+
+// Number of backups a member made of a backup-aware invocation, which are
+// to be acked before the invocation completes.
+inline std::uint8_t backup_acks(const std::vector<char>& message)
+{
+    frame_reader reader {message};
+
+    if (!reader.has_next())
+        return 0;
+
+    auto initial = reader.peek();
+
+    if (initial.size < RESPONSE_FIXED_OFFSET)
+        return 0;
+
+    return read_fixed<std::uint8_t>(initial, RESPONSE_BACKUP_ACKS_OFFSET);
+}
+
+inline std::int32_t event_type(const std::vector<char>& message)
+{
+    frame_reader reader {message};
+
+    if (!reader.has_next())
+        return EXCEPTION_MESSAGE_TYPE;
+
+    auto initial = reader.peek();
+
+    if (initial.size < EVENT_FIXED_OFFSET)
+        return EXCEPTION_MESSAGE_TYPE;
+
+    return read_fixed<std::int32_t>(initial, RESPONSE_TYPE_OFFSET);
+}
+
+// Decodes an event of the type `event_codec<T>` is declared for, which the
+// listener is expected to check with `event_type` first.
+template<has_event_codec T>
+inline boost::system::error_code decode_event(const std::vector<char>& message, T& x)
+{
+    using codec  = event_codec<T>;
+    using layout = layout_traits<typename codec::layout>;
+
+    check_layout<codec>();
+
+    if (event_type(message) != codec::message_type)
+        return error::malformed_response;
+
+    frame_reader reader {message};
+
+    auto initial = reader.next();
+
+    if (initial.size < EVENT_FIXED_OFFSET + layout::fixed_size)
+        return error::malformed_response;
+
+    return decode_fields(reader, initial, EVENT_FIXED_OFFSET, x, typename codec::layout {});
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <optional>
+
+#include <rbs/stream.hpp>
+
+#include "hz_client/message/string_serialization.hpp"
+#include "hz_client/message/optional_serialization.hpp"
+#include "hz_client/message/data.hpp"
+
+namespace hz_client::message
+{
+
+// Reads up to `max_count` items from `start_sequence` on. The member waits
+// until at least `min_count` items are there, so a read at the tail of the
+// ringbuffer stays pending until it is written to. Items the filter drops
+// are skipped without being counted.
+struct ringbuffer_read_many
+{
+    std::string         name;
+    std::int64_t        start_sequence {0};
+    std::int32_t        min_count {1};
+    std::int32_t        max_count {1};
+    std::optional<data> filter;
+};
+
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "hz_client/message/compact.hpp"
+
+namespace hz_client::message
+{
+
+// Registers a Compact schema with the cluster, any member may be asked. It
+// responds once the schema is replicated to every member, which it is
+// before any value of the schema may be sent.
+struct send_schema
+{
+    message::schema schema;
+};
+
+}
@@ -16,12 +16,9 @@ operator<<(
     const uuid& uid
 )
 {
+    // A fixed-size field, the two longs are written even if null.
     ss << uid.is_nil();
 
-    if (uid.is_nil()) {
-        return ss;
-    }
-
     auto copy_uid = uid;
 
     std::reverse(
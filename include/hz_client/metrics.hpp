@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+// Cost accounting is compiled in only when HZ_CLIENT_WITH_METRICS is
+// defined. Otherwise `HZ_CLIENT_METRIC` discards its argument and the
+// connection carries no counters at all.
+#if defined(HZ_CLIENT_WITH_METRICS)
+#define HZ_CLIENT_METRIC(...) __VA_ARGS__
+#else
+#define HZ_CLIENT_METRIC(...)
+#endif
+
+namespace hz_client::metrics
+{
+
+// Allocations made by the current thread. Only counted while the hooks in
+// `hz_client/metrics_allocation_hooks.hpp` are linked in, zero otherwise.
+inline thread_local std::uint64_t thread_allocations {0};
+
+inline std::uint64_t allocations()
+{
+    return thread_allocations;
+}
+
+struct message_counters
+{
+    std::uint64_t invocations {0};
+    std::uint64_t request_bytes {0};
+    std::uint64_t response_bytes {0};
+
+    // Allocations made while encoding and registering the invocation, and
+    // while assembling and dispatching its response up to the completion
+    // handler, which is not accounted for.
+    std::uint64_t allocations {0};
+
+    // Bytes copied by the client besides serialization, e.g. keeping a
+    // retryable message or assembling a response.
+    std::uint64_t bytes_copied {0};
+};
+
+struct connection_counters
+{
+    // Completed socket operations, each one at least a system call.
+    std::uint64_t read_calls {0};
+    std::uint64_t write_calls {0};
+
+    std::uint64_t frames_read {0};
+    std::uint64_t messages_written {0};
+    std::uint64_t bytes_read {0};
+    std::uint64_t bytes_written {0};
+
+    // Invocations which joined an identical one in flight instead of being
+    // sent, see `connection::invoke_shared`.
+    std::uint64_t shared_invocations {0};
+
+    // Backup-aware invocations completed without the acks of all their
+    // backups, see `connection::async_enable_backup_acks`.
+    std::uint64_t backup_ack_timeouts {0};
+
+    // Completions handed to the completion executor, and the times it was
+    // woken to run them, see `connection::set_completion_executor`.
+    std::uint64_t offloaded_completions {0};
+    std::uint64_t completion_wakeups {0};
+
+    // Messages encoded on the serialization executor, see
+    // `connection::set_serialization_executor`.
+    std::uint64_t detached_serializations {0};
+
+    // Keyed by request message type.
+    std::unordered_map<std::int32_t, message_counters> by_type;
+
+    double frames_per_read() const
+    {
+        return read_calls ? double(frames_read) / read_calls : 0;
+    }
+
+    double messages_per_write() const
+    {
+        return write_calls ? double(messages_written) / write_calls : 0;
+    }
+};
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <new>
+#include <cstdlib>
+
+#include "hz_client/metrics.hpp"
+
+// Replaces the global allocation functions to count allocations per thread
+// into `metrics::thread_allocations`. Include it in exactly one translation
+// unit of a program, e.g. a test or a benchmark.
+
+// Once inlined, GCC sees the `free` of a pointer which came from
+// `operator new` and takes it for a mismatch.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t n)
+{
+    ++hz_client::metrics::thread_allocations;
+
+    if (auto p = std::malloc(n ? n : 1))
+        return p;
+
+    throw std::bad_alloc {};
+}
+
+void* operator new[](std::size_t n)
+{
+    return ::operator new(n);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/compression.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/query.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+// One page of a paged query. The page keeps the response as it arrived and
+// decodes the items only while they are visited, so a page never costs
+// more than the response it came in.
+template<message::iteration_type Type>
+class query_page
+{
+public:
+
+    query_page() = default;
+
+    // `message` has to be a well formed paged query response.
+    explicit query_page(std::vector<char> message);
+
+    std::size_t size() const;
+    bool empty() const;
+
+    // Calls `visit(key)`, `visit(value)` or `visit(key, value)` for every
+    // item of the page, depending on the iteration type. Compressed values
+    // are restored; a value which fails to decompress is passed as is.
+    template<typename F>
+    void for_each(F&& visit) const;
+
+private:
+
+    std::vector<char> m_message;
+    std::size_t       m_size {0};
+};
+
+// Streams the result of a predicate query page by page. As soon as a page
+// arrives the following one is requested, so the next page is usually on
+// its way while the caller works on the current one. At most one page is
+// buffered besides the one handed to the caller.
+//
+// Only one `async_next` may be outstanding at a time, and the query has to
+// outlive it.
+template<message::iteration_type Type>
+class paged_query
+{
+    using error_code = boost::system::error_code;
+
+public:
+
+    using page_type = query_page<Type>;
+
+    paged_query(
+        connection& conn,
+        std::string map_name,
+        std::int32_t page_size,
+        std::optional<message::data> predicate = {},
+        std::optional<message::data> comparator = {}
+    );
+
+    // Completes with the next page. An empty page marks the end of the
+    // results.
+    template<typename CompletionToken>
+    auto async_next(CompletionToken&& token);
+
+private:
+
+    void fetch();
+    void on_fetched(error_code err, std::vector<char> response);
+    void deliver();
+
+    connection&                                              m_conn;
+    std::string                                              m_map_name;
+    message::paging_predicate_holder                         m_holder;
+    bool                                                     m_fetching {false};
+    bool                                                     m_exhausted {false};
+    std::optional<std::pair<error_code, page_type>>          m_ready;
+    std::function<void(error_code, page_type)>               m_waiter;
+};
+
+template<message::iteration_type Type>
+query_page<Type>::query_page(std::vector<char> message)
+    :   m_message {std::move(message)}
+{
+    message::frame_reader reader {m_message};
+
+    reader.next();
+    reader.next();
+
+    std::size_t frames {0};
+
+    while (reader.has_next() && !reader.peek().is_end())
+    {
+        reader.next();
+        ++frames;
+    }
+
+    m_size = Type == message::iteration_type::entry ? frames / 2 : frames;
+}
+
+template<message::iteration_type Type>
+std::size_t query_page<Type>::size() const
+{
+    return m_size;
+}
+
+template<message::iteration_type Type>
+bool query_page<Type>::empty() const
+{
+    return m_size == 0;
+}
+
+template<message::iteration_type Type>
+template<typename F>
+void query_page<Type>::for_each(F&& visit) const
+{
+    if (m_size == 0)
+        return;
+
+    message::frame_reader reader {m_message};
+
+    reader.next();
+    reader.next();
+
+    for (std::size_t i = 0; i < m_size; ++i)
+    {
+        auto x = message::decode_data(reader);
+
+        if constexpr (Type == message::iteration_type::key)
+        {
+            visit(std::move(x));
+        }
+        else if constexpr (Type == message::iteration_type::value)
+        {
+            decompress(x);
+            visit(std::move(x));
+        }
+        else
+        {
+            auto value = message::decode_data(reader);
+
+            decompress(value);
+            visit(std::move(x), std::move(value));
+        }
+    }
+}
+
+template<message::iteration_type Type>
+paged_query<Type>::paged_query(
+    connection& conn,
+    std::string map_name,
+    std::int32_t page_size,
+    std::optional<message::data> predicate,
+    std::optional<message::data> comparator
+)
+    :   m_conn {conn}
+    ,   m_map_name {std::move(map_name)}
+{
+    m_holder.page_size  = page_size > 0 ? page_size : 1;
+    m_holder.type       = Type;
+    m_holder.predicate  = std::move(predicate);
+    m_holder.comparator = std::move(comparator);
+}
+
+template<message::iteration_type Type>
+template<typename CompletionToken>
+auto paged_query<Type>::async_next(CompletionToken&& token)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code, page_type)
+    >(
+        [this](auto& composable) mutable
+        {
+            m_waiter = make_shallow_copyable(
+                [composable = std::move(composable)](error_code err, page_type page) mutable
+                {
+                    composable.complete(err, std::move(page));
+                }
+            );
+
+            if (!m_ready && !m_fetching)
+            {
+                if (m_exhausted)
+                    m_ready.emplace(error_code{}, page_type{});
+                else
+                    fetch();
+            }
+
+            // Whatever is at hand already is handed over through the
+            // executor, never from within this call.
+            boost::asio::post(m_conn.sck().get_executor(), [this] { deliver(); });
+        },
+        token
+    );
+}
+
+template<message::iteration_type Type>
+void paged_query<Type>::fetch()
+{
+    message::request<message::query_with_paging_predicate<Type>> req;
+
+    req.entity = {m_map_name, m_holder};
+
+    m_fetching = true;
+
+    m_conn.invoke(
+        std::move(req),
+        [this](const error_code& err, std::vector<char> response)
+        {
+            on_fetched(err, std::move(response));
+        }
+    );
+}
+
+template<message::iteration_type Type>
+void paged_query<Type>::on_fetched(error_code err, std::vector<char> response)
+{
+    m_fetching = false;
+
+    if (!err)
+    {
+        message::frame_reader reader {response};
+
+        if (!reader.has_next() || reader.peek().size < message::RESPONSE_FIXED_OFFSET)
+            err = error::malformed_response;
+        else if (message::read_fixed<std::int32_t>(reader.peek(), message::RESPONSE_TYPE_OFFSET) == message::EXCEPTION_MESSAGE_TYPE)
+            err = error::remote_exception;
+    }
+
+    if (err)
+    {
+        m_exhausted = true;
+        m_ready.emplace(err, page_type{});
+
+        return deliver();
+    }
+
+    // The anchor list follows the items and carries the position to resume
+    // from with the next page.
+    message::frame_reader reader {response};
+
+    reader.next();
+    reader.next();
+    reader.skip_to_end_of_structure();
+
+    m_holder.anchor_list = message::decode_anchor_data_list(reader);
+    ++m_holder.page;
+
+    page_type page {std::move(response)};
+
+    if (page.size() < std::size_t(m_holder.page_size))
+        m_exhausted = true;
+
+    m_ready.emplace(error_code{}, std::move(page));
+
+    deliver();
+}
+
+template<message::iteration_type Type>
+void paged_query<Type>::deliver()
+{
+    if (!m_waiter || !m_ready)
+        return;
+
+    auto waiter = std::move(m_waiter);
+    auto [err, page] = std::move(*m_ready);
+
+    m_waiter = nullptr;
+    m_ready.reset();
+
+    if (!m_exhausted && !m_fetching)
+        fetch();
+
+    waiter(err, std::move(page));
+}
+
+}
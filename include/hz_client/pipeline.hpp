@@ -0,0 +1,212 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+
+#include "hz_client/connection.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+// Keeps up to `depth` invocations of `T` in flight on a connection. Requests
+// beyond the depth are queued and submitted as slots free up; every refill
+// round is flushed with a single write. Results are handed back in the
+// order the requests are added, each one as soon as it and every request
+// added before it are complete. A result waiting for an earlier one keeps
+// its slot until then, so that at most `depth` responses are held behind
+// a slow request.
+//
+// The pipeline has to outlive the invocations it submits.
+template<typename T>
+class pipeline
+{
+    using error_code = boost::system::error_code;
+
+public:
+
+    using result_handler = std::function<
+        void(std::size_t index, error_code, std::vector<char>)
+    >;
+
+    pipeline(connection& conn, std::size_t depth, result_handler on_result);
+
+    void add(message::request<T> req);
+
+    std::size_t depth() const;
+    std::size_t in_flight() const;
+
+    // Completes once every request added so far is handed back.
+    template<typename CompletionToken>
+    auto async_wait(CompletionToken&& token);
+
+private:
+
+    struct slot
+    {
+        bool              done {false};
+        error_code        err;
+        std::vector<char> response;
+    };
+
+    // `ready` of the slots in front are about to be handed back, and make
+    // room already.
+    void submit_queued(std::size_t ready = 0);
+    void on_complete(std::size_t index, error_code err, std::vector<char> response);
+
+    connection&                       m_conn;
+    std::size_t                       m_depth;
+    result_handler                    m_on_result;
+    std::deque<message::request<T>>   m_queued;
+    std::deque<slot>                  m_slots;
+    std::size_t                       m_next_index;
+    std::size_t                       m_next_delivery;
+    std::size_t                       m_in_flight;
+    std::vector<std::function<void()>> m_waiters;
+};
+
+template<typename T>
+pipeline<T>::pipeline(connection& conn, std::size_t depth, result_handler on_result)
+    :   m_conn {conn}
+    ,   m_depth {depth > 0 ? depth : 1}
+    ,   m_on_result {std::move(on_result)}
+    ,   m_next_index {0}
+    ,   m_next_delivery {0}
+    ,   m_in_flight {0}
+{}
+
+template<typename T>
+void pipeline<T>::add(message::request<T> req)
+{
+    m_queued.push_back(std::move(req));
+
+    submit_queued();
+}
+
+template<typename T>
+std::size_t pipeline<T>::depth() const
+{
+    return m_depth;
+}
+
+template<typename T>
+std::size_t pipeline<T>::in_flight() const
+{
+    return m_in_flight;
+}
+
+template<typename T>
+void pipeline<T>::submit_queued(std::size_t ready)
+{
+    if (m_queued.empty() || m_slots.size() - ready >= m_depth)
+        return;
+
+    m_conn.hold_writes();
+
+    while (!m_queued.empty() && m_slots.size() - ready < m_depth)
+    {
+        auto index = m_next_index++;
+
+        ++m_in_flight;
+        m_slots.emplace_back();
+
+        auto req = std::move(m_queued.front());
+
+        m_queued.pop_front();
+
+        m_conn.invoke(
+            std::move(req),
+            [this, index](const error_code& err, std::vector<char> response)
+            {
+                on_complete(index, err, std::move(response));
+            }
+        );
+    }
+
+    m_conn.release_writes();
+}
+
+template<typename T>
+void pipeline<T>::on_complete(
+    std::size_t index,
+    error_code err,
+    std::vector<char> response
+)
+{
+    --m_in_flight;
+
+    auto& completed = m_slots[index - m_next_delivery];
+
+    completed.done     = true;
+    completed.err      = err;
+    completed.response = std::move(response);
+
+    std::size_t ready {0};
+
+    while (ready < m_slots.size() && m_slots[ready].done)
+        ++ready;
+
+    // Refill before handing results back, so the freed slots are already
+    // on the wire while the results are being processed.
+    submit_queued(ready);
+
+    for (; ready > 0; --ready)
+    {
+        auto front = std::move(m_slots.front());
+
+        m_slots.pop_front();
+
+        m_on_result(m_next_delivery++, front.err, std::move(front.response));
+    }
+
+    if (m_slots.empty() && m_queued.empty() && !m_waiters.empty())
+    {
+        auto waiters = std::move(m_waiters);
+
+        m_waiters.clear();
+
+        for (auto& waiter : waiters)
+            waiter();
+    }
+}
+
+template<typename T>
+template<typename CompletionToken>
+auto pipeline<T>::async_wait(CompletionToken&& token)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code)
+    >(
+        [this](auto& composable) mutable
+        {
+            // Never completed from within this call.
+            if (m_slots.empty() && m_queued.empty())
+            {
+                return boost::asio::post(
+                    m_conn.sck().get_executor(),
+                    [composable = std::move(composable)]() mutable
+                    {
+                        composable.complete(error_code{});
+                    }
+                );
+            }
+
+            m_waiters.emplace_back(
+                make_shallow_copyable(
+                    [composable = std::move(composable)]() mutable
+                    {
+                        composable.complete(error_code{});
+                    }
+                )
+            );
+        },
+        token
+    );
+}
+
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/message/pn_counter.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+struct pn_counter_options
+{
+    // Deltas added locally are sent at the latest this long after the
+    // first one of them.
+    std::chrono::microseconds flush_interval {std::chrono::milliseconds {1}};
+
+    // Or as soon as this many adds are pending.
+    std::int64_t max_pending_adds {4096};
+};
+
+// A PN counter whose increments are summed up locally and sent as a single
+// delta, so that an increment costs an atomic add rather than a round trip.
+//
+// Deltas are sent one add at a time, to the member of the connection, with
+// the replica timestamps of every response so far: a replica never answers
+// with a state older than the one the client has seen, so the values read
+// through the counter are monotonic as long as it only increments. Pending
+// deltas are lost if the counter is destroyed without them being sent.
+//
+// The delta of a failed add is taken back into the local sum, and sent
+// again with the next flush, only if the add was never written, as one
+// which was may have been applied: its delta adds up in `in_doubt`
+// instead. Once the connection is closed or unavailable, nothing is sent
+// again until the next add, and every waiter fails with the error.
+//
+// The counter has to outlive the invocations it makes.
+class pn_counter
+{
+    using error_code = boost::system::error_code;
+
+public:
+
+    inline pn_counter(
+        connection& conn,
+        std::string name,
+        pn_counter_options options = {}
+    );
+
+    inline const std::string& name() const;
+
+    // Adds `delta` to the local sum, lock-free and from any thread.
+    inline void add(std::int64_t delta);
+
+    // Sends the deltas added so far right away. To be called from the
+    // thread running the io_context.
+    inline void flush();
+
+    // Completes with the value of the counter, the deltas added before the
+    // call included, which are sent first. To be called from the thread
+    // running the io_context.
+    template<typename CompletionToken>
+    auto async_get(CompletionToken&& token);
+
+    // Sum of the deltas of the adds which failed after being written, which
+    // the cluster may or may not have applied. To be called from the thread
+    // running the io_context.
+    inline std::int64_t in_doubt() const;
+
+private:
+
+    using waiter_t = std::function<void(error_code, std::int64_t)>;
+
+    inline void arm_timer();
+    inline void on_flushed(
+        error_code err,
+        std::int64_t delta,
+        bool unsent,
+        std::vector<char>& response
+    );
+
+    template<typename T>
+    void send(message::request<T> req, std::int64_t delta);
+
+    connection&               m_conn;
+    std::string               m_name;
+    pn_counter_options        m_options;
+
+    std::atomic<std::int64_t> m_delta {0};
+    std::atomic<std::int64_t> m_pending_adds {0};
+    std::atomic<bool>         m_flush_posted {false};
+
+    boost::asio::steady_timer m_flush_timer;
+    bool                      m_flush_scheduled {false};
+    bool                      m_flushing {false};
+    std::int64_t              m_in_doubt {0};
+
+    message::replica_timestamps m_timestamps;
+
+    // Waiters of the add in flight, and of the next one.
+    std::vector<waiter_t>     m_round_waiters;
+    std::vector<waiter_t>     m_waiters;
+};
+
+inline pn_counter::pn_counter(
+    connection& conn,
+    std::string name,
+    pn_counter_options options
+)
+    :   m_conn {conn}
+    ,   m_name {std::move(name)}
+    ,   m_options {options}
+    ,   m_flush_timer {conn.sck().get_executor()}
+{
+    if (m_options.max_pending_adds < 1)
+        m_options.max_pending_adds = 1;
+}
+
+inline const std::string& pn_counter::name() const
+{
+    return m_name;
+}
+
+inline void pn_counter::add(std::int64_t delta)
+{
+    m_delta.fetch_add(delta, std::memory_order_relaxed);
+
+    auto pending = m_pending_adds.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    if (pending == 1)
+        boost::asio::post(m_conn.sck().get_executor(), [this] { arm_timer(); });
+
+    if (pending >= m_options.max_pending_adds && !m_flush_posted.exchange(true, std::memory_order_acq_rel))
+    {
+        boost::asio::post(
+            m_conn.sck().get_executor(),
+            [this]
+            {
+                m_flush_posted.store(false, std::memory_order_release);
+
+                flush();
+            }
+        );
+    }
+}
+
+inline void pn_counter::flush()
+{
+    if (m_flush_scheduled)
+    {
+        m_flush_scheduled = false;
+        m_flush_timer.cancel();
+    }
+
+    // The deltas added meanwhile go out once the add in flight completes.
+    if (m_flushing)
+        return;
+
+    // An add racing this may leave its delta in this round and its count
+    // in the next one, which then only costs an add of zero.
+    auto pending = m_pending_adds.exchange(0, std::memory_order_acq_rel);
+    auto delta   = m_delta.exchange(0, std::memory_order_acq_rel);
+
+    if (pending == 0 && delta == 0 && m_waiters.empty())
+        return;
+
+    m_flushing      = true;
+    m_round_waiters = std::exchange(m_waiters, {});
+
+    // A read with nothing to add is not a write on the replica.
+    if (pending == 0 && delta == 0)
+    {
+        message::request<message::pn_counter_get> req;
+
+        req.entity = {m_conn.member_uuid(), m_name, m_timestamps};
+
+        return send(std::move(req), 0);
+    }
+
+    message::request<message::pn_counter_add> req;
+
+    req.entity = {delta, false, m_conn.member_uuid(), m_name, m_timestamps};
+
+    send(std::move(req), delta);
+}
+
+template<typename CompletionToken>
+auto pn_counter::async_get(CompletionToken&& token)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code, std::int64_t)
+    >(
+        [this](auto& composable) mutable
+        {
+            m_waiters.push_back(
+                make_shallow_copyable(
+                    [composable = std::move(composable)](error_code err, std::int64_t value) mutable
+                    {
+                        composable.complete(err, value);
+                    }
+                )
+            );
+
+            flush();
+        },
+        token
+    );
+}
+
+inline std::int64_t pn_counter::in_doubt() const
+{
+    return m_in_doubt;
+}
+
+inline void pn_counter::arm_timer()
+{
+    if (m_flush_scheduled || m_pending_adds.load(std::memory_order_acquire) == 0)
+        return;
+
+    m_flush_scheduled = true;
+
+    m_flush_timer.expires_after(m_options.flush_interval);
+    m_flush_timer.async_wait(
+        [this](const error_code& err)
+        {
+            if (!err && m_flush_scheduled)
+            {
+                m_flush_scheduled = false;
+
+                flush();
+            }
+        }
+    );
+}
+
+template<typename T>
+void pn_counter::send(message::request<T> req, std::int64_t delta)
+{
+    m_conn.invoke(
+        std::move(req),
+        [this, delta, writes = m_conn.writes_started()](error_code err, std::vector<char> response)
+        {
+            on_flushed(err, delta, err && writes == m_conn.writes_started(), response);
+        }
+    );
+}
+
+inline void pn_counter::on_flushed(
+    error_code err,
+    std::int64_t delta,
+    bool unsent,
+    std::vector<char>& response
+)
+{
+    // Reads are answered alike.
+    message::response<message::pn_counter_add> res;
+
+    if (!err)
+        err = message::decode_response(response, res);
+
+    if (!err)
+        m_timestamps.merge(res.timestamps);
+
+    // Retrying would only fail alike, until the connection is back and
+    // adds are made again.
+    bool unavailable = err == error::connection_closed || err == error::not_connected;
+
+    if (err && unsent)
+    {
+        m_delta.fetch_add(delta, std::memory_order_relaxed);
+
+        // Counted as an add of its own, for the timer to send it again.
+        if (!unavailable)
+            m_pending_adds.fetch_add(1, std::memory_order_acq_rel);
+    }
+    else if (err)
+    {
+        m_in_doubt += delta;
+    }
+
+    m_flushing = false;
+
+    auto waiters = std::exchange(m_round_waiters, {});
+
+    if (unavailable)
+    {
+        m_pending_adds.store(0, std::memory_order_release);
+
+        if (m_flush_scheduled)
+        {
+            m_flush_scheduled = false;
+            m_flush_timer.cancel();
+        }
+
+        for (auto& waiter : std::exchange(m_waiters, {}))
+            waiters.push_back(std::move(waiter));
+    }
+
+    for (auto& waiter : waiters)
+        waiter(err, res.value);
+
+    if (!m_waiters.empty() || m_pending_adds.load(std::memory_order_acquire) >= m_options.max_pending_adds)
+        flush();
+    else if (m_pending_adds.load(std::memory_order_acquire) > 0)
+        arm_timer();
+}
+
+}
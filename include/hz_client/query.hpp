@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <optional>
+
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/object_data_output.hpp"
+
+namespace hz_client
+{
+
+// Predicates, projections and aggregators are evaluated by the members.
+// Each of them is serialized with `message::to_data` before it is passed
+// to a query, e.g. `to_data(equal_predicate {"age", 42})`.
+
+struct sql_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 0;
+
+    std::string expression;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(expression);
+    }
+};
+
+struct and_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 1;
+
+    std::vector<message::data> predicates;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_int(std::int32_t(predicates.size()));
+
+        for (const auto& x : predicates)
+            out.write_object(x);
+    }
+};
+
+struct between_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 2;
+
+    std::string   attribute;
+    message::data from;
+    message::data to;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute);
+        out.write_object(to);
+        out.write_object(from);
+    }
+};
+
+struct equal_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 3;
+
+    std::string   attribute;
+    message::data value;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute);
+        out.write_object(value);
+    }
+};
+
+struct greater_less_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 4;
+
+    std::string   attribute;
+    message::data value;
+    bool          equal {false};
+    bool          less {false};
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute);
+        out.write_object(value);
+        out.write_bool(equal);
+        out.write_bool(less);
+    }
+};
+
+struct like_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 5;
+
+    std::string attribute;
+    std::string expression;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute);
+        out.write_string(expression);
+    }
+};
+
+struct in_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 7;
+
+    std::string                attribute;
+    std::vector<message::data> values;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute);
+        out.write_int(std::int32_t(values.size()));
+
+        for (const auto& x : values)
+            out.write_object(x);
+    }
+};
+
+struct not_equal_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 9;
+
+    std::string   attribute;
+    message::data value;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute);
+        out.write_object(value);
+    }
+};
+
+struct not_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 10;
+
+    message::data predicate;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_object(predicate);
+    }
+};
+
+struct or_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 11;
+
+    std::vector<message::data> predicates;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_int(std::int32_t(predicates.size()));
+
+        for (const auto& x : predicates)
+            out.write_object(x);
+    }
+};
+
+struct true_predicate
+{
+    static inline constexpr std::int32_t factory_id = -20;
+    static inline constexpr std::int32_t class_id   = 14;
+
+    void write_data(message::object_data_output&) const
+    {}
+};
+
+struct single_attribute_projection
+{
+    static inline constexpr std::int32_t factory_id = -30;
+    static inline constexpr std::int32_t class_id   = 0;
+
+    std::string attribute_path;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute_path);
+    }
+};
+
+struct multi_attribute_projection
+{
+    static inline constexpr std::int32_t factory_id = -30;
+    static inline constexpr std::int32_t class_id   = 1;
+
+    std::vector<std::string> attribute_paths;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_int(std::int32_t(attribute_paths.size()));
+
+        for (const auto& x : attribute_paths)
+            out.write_string(x);
+    }
+};
+
+struct identity_projection
+{
+    static inline constexpr std::int32_t factory_id = -30;
+    static inline constexpr std::int32_t class_id   = 2;
+
+    void write_data(message::object_data_output&) const
+    {}
+};
+
+// Aggregators travel with their initial, empty state.
+struct count_aggregator
+{
+    static inline constexpr std::int32_t factory_id = -29;
+    static inline constexpr std::int32_t class_id   = 4;
+
+    std::optional<std::string> attribute_path;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute_path);
+        out.write_long(0);
+    }
+};
+
+struct long_average_aggregator
+{
+    static inline constexpr std::int32_t factory_id = -29;
+    static inline constexpr std::int32_t class_id   = 12;
+
+    std::optional<std::string> attribute_path;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute_path);
+        out.write_long(0);
+        out.write_long(0);
+    }
+};
+
+struct long_sum_aggregator
+{
+    static inline constexpr std::int32_t factory_id = -29;
+    static inline constexpr std::int32_t class_id   = 13;
+
+    std::optional<std::string> attribute_path;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute_path);
+        out.write_long(0);
+    }
+};
+
+struct max_aggregator
+{
+    static inline constexpr std::int32_t factory_id = -29;
+    static inline constexpr std::int32_t class_id   = 14;
+
+    std::optional<std::string> attribute_path;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute_path);
+        out.write_object(std::nullopt);
+    }
+};
+
+struct min_aggregator
+{
+    static inline constexpr std::int32_t factory_id = -29;
+    static inline constexpr std::int32_t class_id   = 15;
+
+    std::optional<std::string> attribute_path;
+
+    void write_data(message::object_data_output& out) const
+    {
+        out.write_string(attribute_path);
+        out.write_object(std::nullopt);
+    }
+};
+
+}
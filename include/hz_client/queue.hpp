@@ -0,0 +1,403 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/queue.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+class queue
+{
+public:
+
+    inline queue(connection& conn, std::string name);
+
+    inline const std::string& name() const;
+
+    // Completes with whether the queue changed.
+    template<typename CompletionToken>
+    auto async_add_all(
+        std::vector<message::data> items,
+        CompletionToken&& token
+    );
+
+    // Completes with up to `max_size` items taken from the head of the
+    // queue, none if it is empty.
+    template<typename CompletionToken>
+    auto async_drain_to(
+        std::int32_t max_size,
+        CompletionToken&& token
+    );
+
+private:
+
+    template<typename T, typename Result, typename Extract, typename CompletionToken>
+    auto invoke_for(
+        message::request<T> req,
+        Extract extract,
+        CompletionToken&& token
+    );
+
+    connection& m_conn;
+    std::string m_name;
+};
+
+struct queue_consumer_options
+{
+    // Most items taken with one request, and so handed out in one batch.
+    std::int32_t batch_size {100};
+
+    // Number of drains kept in flight.
+    std::size_t drains_in_flight {2};
+
+    // Drains do not wait for items. Once one comes back empty, no other is
+    // sent for this long.
+    std::chrono::milliseconds idle_wait {10};
+};
+
+// Takes the items of a queue in batches, keeping `drains_in_flight` drains
+// pipelined while there are items and polling every `idle_wait` while the
+// queue is empty. Batches are handed out in the order the drains were sent.
+//
+// Only one `async_next` may be outstanding at a time, and the consumer has
+// to outlive the invocations it submits. Items drained but not handed out
+// yet are lost with the consumer.
+class queue_consumer
+{
+    using error_code = boost::system::error_code;
+
+public:
+
+    inline queue_consumer(
+        connection& conn,
+        std::string name,
+        queue_consumer_options options = {}
+    );
+
+    // Swaps `items` with the next batch, which is never empty. The vector
+    // passed in is kept to decode a later batch into, as with
+    // `ringbuffer_consumer::async_next`. `items` has to outlive the
+    // operation.
+    template<typename CompletionToken>
+    auto async_next(std::vector<message::data>& items, CompletionToken&& token);
+
+    // Stops polling and fails a pending `async_next` with
+    // `error::connection_closed`. Drains in flight still complete.
+    inline void close();
+
+private:
+
+    struct drain
+    {
+        bool       done {false};
+        error_code err;
+
+        message::response<message::queue_drain_to> response;
+    };
+
+    inline void fill();
+    inline void on_drained(drain& d, error_code err);
+    inline void deliver();
+
+    connection&                             m_conn;
+    std::string                             m_name;
+    queue_consumer_options                  m_options;
+    bool                                    m_started {false};
+    std::int32_t                            m_partition_id {-1};
+
+    // References to its elements stay valid as drains are added at the
+    // back and removed at the front.
+    std::deque<drain>                       m_drains;
+    std::vector<std::vector<message::data>> m_spare;
+    boost::asio::steady_timer               m_idle_timer;
+    bool                                    m_idle {false};
+    error_code                              m_error;
+    std::vector<message::data>*             m_out {nullptr};
+    std::function<void(error_code)>         m_waiter;
+};
+
+inline queue::queue(connection& conn, std::string name)
+    :   m_conn {conn}
+    ,   m_name {std::move(name)}
+{}
+
+inline const std::string& queue::name() const
+{
+    return m_name;
+}
+
+template<typename CompletionToken>
+auto queue::async_add_all(
+    std::vector<message::data> items,
+    CompletionToken&& token
+)
+{
+    message::request<message::queue_add_all> req;
+
+    req.entity = {m_name, std::move(items)};
+
+    return invoke_for<message::queue_add_all, bool>(
+        std::move(req),
+        [](auto& res) { return res.changed; },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename CompletionToken>
+auto queue::async_drain_to(
+    std::int32_t max_size,
+    CompletionToken&& token
+)
+{
+    message::request<message::queue_drain_to> req;
+
+    req.entity = {m_name, max_size};
+
+    return invoke_for<message::queue_drain_to, std::vector<message::data>>(
+        std::move(req),
+        [](auto& res) { return std::move(res.items); },
+        std::forward<CompletionToken>(token)
+    );
+}
+
+template<typename T, typename Result, typename Extract, typename CompletionToken>
+auto queue::invoke_for(
+    message::request<T> req,
+    Extract extract,
+    CompletionToken&& token
+)
+{
+    // Every operation of the queue goes to the partition owning its name.
+    req.header.partition_id = message::partition_id(message::data {m_name}, m_conn.partition_count());
+
+    return boost::asio::async_compose<
+        CompletionToken, void(boost::system::error_code, Result)
+    >(
+        [
+            this,
+            req     = std::move(req),
+            extract = std::move(extract)
+        ]
+        (auto& composable) mutable
+        {
+            auto message = std::move(req);
+            auto take    = std::move(extract);
+
+            m_conn.invoke(
+                std::move(message),
+                make_shallow_copyable(
+                    [composable = std::move(composable), take = std::move(take)](
+                        boost::system::error_code err,
+                        std::vector<char> response
+                    ) mutable
+                    {
+                        message::response<T> res;
+
+                        if (!err)
+                            err = message::decode_response(response, res);
+
+                        if (err)
+                            return composable.complete(err, Result {});
+
+                        composable.complete(err, take(res));
+                    }
+                )
+            );
+        },
+        token
+    );
+}
+
+inline queue_consumer::queue_consumer(
+    connection& conn,
+    std::string name,
+    queue_consumer_options options
+)
+    :   m_conn {conn}
+    ,   m_name {std::move(name)}
+    ,   m_options {std::move(options)}
+    ,   m_idle_timer {conn.sck().get_executor()}
+{
+    if (m_options.batch_size < 1)
+        m_options.batch_size = 1;
+
+    if (m_options.drains_in_flight < 1)
+        m_options.drains_in_flight = 1;
+}
+
+template<typename CompletionToken>
+auto queue_consumer::async_next(
+    std::vector<message::data>& items,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code)
+    >(
+        [this, &items](auto& composable) mutable
+        {
+            m_out    = &items;
+            m_waiter = make_shallow_copyable(
+                [composable = std::move(composable)](error_code err) mutable
+                {
+                    composable.complete(err);
+                }
+            );
+
+            if (!m_started)
+            {
+                m_started      = true;
+                m_partition_id = message::partition_id(message::data {m_name}, m_conn.partition_count());
+
+                fill();
+            }
+
+            // Whatever is at hand already is handed over through the
+            // executor, never from within this call.
+            boost::asio::post(m_conn.sck().get_executor(), [this] { deliver(); });
+        },
+        token
+    );
+}
+
+inline void queue_consumer::close()
+{
+    if (!m_error)
+        m_error = make_error_code(error::connection_closed);
+
+    m_idle_timer.cancel();
+
+    deliver();
+}
+
+inline void queue_consumer::fill()
+{
+    if (m_error || m_idle)
+        return;
+
+    // The drains leave with a single write.
+    m_conn.hold_writes();
+
+    while (m_drains.size() < m_options.drains_in_flight)
+    {
+        auto& d = m_drains.emplace_back();
+
+        if (!m_spare.empty())
+        {
+            d.response.items = std::move(m_spare.back());
+
+            m_spare.pop_back();
+        }
+
+        message::request<message::queue_drain_to> req;
+
+        req.header.partition_id = m_partition_id;
+        req.entity = {m_name, m_options.batch_size};
+
+        m_conn.invoke_into(
+            std::move(req),
+            d.response,
+            [this, &d](const error_code& err)
+            {
+                on_drained(d, err);
+            }
+        );
+    }
+
+    m_conn.release_writes();
+}
+
+inline void queue_consumer::on_drained(drain& d, error_code err)
+{
+    d.done = true;
+    d.err  = err;
+
+    deliver();
+}
+
+inline void queue_consumer::deliver()
+{
+    // Empty and failed drains at the front are done with right away, the
+    // first failure ending the consumption.
+    while (!m_drains.empty() && m_drains.front().done)
+    {
+        auto& front = m_drains.front();
+
+        if (front.err && !m_error)
+            m_error = front.err;
+
+        if (!front.err && !front.response.items.empty())
+            break;
+
+        if (!front.err && !m_idle && !m_error)
+        {
+            m_idle = true;
+
+            m_idle_timer.expires_after(m_options.idle_wait);
+            m_idle_timer.async_wait(
+                [this](const error_code& err)
+                {
+                    if (err)
+                        return;
+
+                    m_idle = false;
+
+                    fill();
+                }
+            );
+        }
+
+        m_spare.push_back(std::move(front.response.items));
+        m_drains.pop_front();
+    }
+
+    if (!m_waiter)
+        return;
+
+    error_code err;
+
+    if (!m_drains.empty() && m_drains.front().done)
+    {
+        auto& front = m_drains.front();
+
+        std::swap(*m_out, front.response.items);
+
+        m_spare.push_back(std::move(front.response.items));
+        m_drains.pop_front();
+    }
+    else if (m_error)
+    {
+        err = m_error;
+    }
+    else
+    {
+        return fill();
+    }
+
+    fill();
+
+    auto waiter = std::move(m_waiter);
+
+    m_waiter = nullptr;
+    m_out    = nullptr;
+
+    waiter(err);
+}
+
+}
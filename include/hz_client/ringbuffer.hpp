@@ -0,0 +1,448 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <functional>
+
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+
+#include "hz_client/error.hpp"
+#include "hz_client/connection.hpp"
+#include "hz_client/message/data.hpp"
+#include "hz_client/message/ringbuffer.hpp"
+#include "hz_client/message/request.hpp"
+#include "hz_client/message/response.hpp"
+#include "hz_client/util/make_shallow_copyable.hpp"
+
+namespace hz_client
+{
+
+class ringbuffer
+{
+public:
+
+    inline ringbuffer(connection& conn, std::string name);
+
+    inline const std::string& name() const;
+
+    // Completes with what was read, see `message::ringbuffer_read_many`.
+    template<typename CompletionToken>
+    auto async_read_many(
+        std::int64_t start_sequence,
+        std::int32_t min_count,
+        std::int32_t max_count,
+        std::optional<message::data> filter,
+        CompletionToken&& token
+    );
+
+private:
+
+    connection& m_conn;
+    std::string m_name;
+};
+
+struct ringbuffer_consumer_options
+{
+    // Sequence of the first item to be read.
+    std::int64_t start_sequence {0};
+
+    // Most items read with one request, and so handed out in one batch.
+    std::int32_t batch_size {100};
+
+    // Items a read waits for at the tail of the ringbuffer, at least one.
+    std::int32_t min_count {1};
+
+    // Number of reads kept in flight, each one over the `batch_size`
+    // sequences following those of the previous one.
+    std::size_t reads_in_flight {4};
+
+    // Items not matching the filter are skipped by the member, a read then
+    // covering as many sequences as it takes to find its items. Where the
+    // next read starts is only known once the previous one is back, so a
+    // single read is in flight with a filter.
+    std::optional<message::data> filter;
+};
+
+// Reads a ringbuffer from `start_sequence` on, in batches handed out in
+// sequence order.
+//
+// Up to `reads_in_flight` reads are pipelined, each one covering the
+// `batch_size` sequences following the previous one, as long as the
+// consumer is behind the tail. A read which comes back short has hit the
+// tail: the rest of its sequences are read again right away, and no read
+// is sent ahead of it until one comes back full again. Reads ahead of the
+// tail, which the member turns down, are sent again once the consumer has
+// caught up with them.
+//
+// Only one `async_next` may be outstanding at a time, and the consumer has
+// to outlive the invocations it submits. Errors, items lost to being
+// overwritten included, end the consumption.
+class ringbuffer_consumer
+{
+    using error_code = boost::system::error_code;
+
+public:
+
+    inline ringbuffer_consumer(
+        connection& conn,
+        std::string name,
+        ringbuffer_consumer_options options = {}
+    );
+
+    // Swaps `items` with the next batch. The vector passed in is kept to
+    // decode a later batch into, so passing the same one every time keeps
+    // the storage of the items going round instead of being allocated per
+    // batch. `items` has to outlive the operation.
+    template<typename CompletionToken>
+    auto async_next(std::vector<message::data>& items, CompletionToken&& token);
+
+    // Sequence following the last item handed out, where the consumption
+    // would be resumed.
+    inline std::int64_t sequence() const;
+
+private:
+
+    struct batch
+    {
+        std::vector<message::data> items;
+        std::int64_t               next_sequence {0};
+    };
+
+    // Sequences [start, end) still to be read; a window is done once they
+    // are all read and its batches are handed out.
+    struct window
+    {
+        std::int64_t start {0};
+        std::int64_t end {0};
+        bool         reading {false};
+        std::deque<batch> ready;
+
+        message::response<message::ringbuffer_read_many> response;
+    };
+
+    inline void fill();
+    inline void read(window& w);
+    inline void on_read(window& w, error_code err);
+    inline void deliver();
+    inline std::vector<message::data> take_spare();
+
+    connection&                             m_conn;
+    std::string                             m_name;
+    ringbuffer_consumer_options             m_options;
+    bool                                    m_started {false};
+    std::int32_t                            m_partition_id {-1};
+    std::int64_t                            m_next_window {0};
+    std::int64_t                            m_sequence {0};
+    bool                                    m_at_tail {false};
+
+    // References to its elements stay valid as windows are added at the
+    // back and removed at the front, which is all the reads rely on.
+    std::deque<window>                      m_windows;
+    std::vector<std::vector<message::data>> m_spare;
+    error_code                              m_error;
+    std::vector<message::data>*             m_out {nullptr};
+    std::function<void(error_code)>         m_waiter;
+};
+
+inline ringbuffer::ringbuffer(connection& conn, std::string name)
+    :   m_conn {conn}
+    ,   m_name {std::move(name)}
+{}
+
+inline const std::string& ringbuffer::name() const
+{
+    return m_name;
+}
+
+template<typename CompletionToken>
+auto ringbuffer::async_read_many(
+    std::int64_t start_sequence,
+    std::int32_t min_count,
+    std::int32_t max_count,
+    std::optional<message::data> filter,
+    CompletionToken&& token
+)
+{
+    using result_t = message::response<message::ringbuffer_read_many>;
+
+    message::request<message::ringbuffer_read_many> req;
+
+    req.header.partition_id = message::partition_id(message::data {m_name}, m_conn.partition_count());
+    req.entity = {m_name, start_sequence, min_count, max_count, std::move(filter)};
+
+    return boost::asio::async_compose<
+        CompletionToken, void(boost::system::error_code, result_t)
+    >(
+        [
+            this,
+            req = std::move(req)
+        ]
+        (auto& composable) mutable
+        {
+            auto message = std::move(req);
+
+            m_conn.invoke(
+                std::move(message),
+                make_shallow_copyable(
+                    [composable = std::move(composable)](
+                        boost::system::error_code err,
+                        std::vector<char> response
+                    ) mutable
+                    {
+                        result_t result;
+
+                        if (!err)
+                            err = message::decode_response(response, result);
+
+                        composable.complete(err, std::move(result));
+                    }
+                )
+            );
+        },
+        token
+    );
+}
+
+inline ringbuffer_consumer::ringbuffer_consumer(
+    connection& conn,
+    std::string name,
+    ringbuffer_consumer_options options
+)
+    :   m_conn {conn}
+    ,   m_name {std::move(name)}
+    ,   m_options {std::move(options)}
+{
+    if (m_options.batch_size < 1)
+        m_options.batch_size = 1;
+
+    if (m_options.reads_in_flight < 1 || m_options.filter)
+        m_options.reads_in_flight = 1;
+
+    m_options.min_count = std::clamp(m_options.min_count, 1, m_options.batch_size);
+
+    m_next_window = m_options.start_sequence;
+    m_sequence    = m_options.start_sequence;
+}
+
+template<typename CompletionToken>
+auto ringbuffer_consumer::async_next(
+    std::vector<message::data>& items,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<
+        CompletionToken, void(error_code)
+    >(
+        [this, &items](auto& composable) mutable
+        {
+            m_out    = &items;
+            m_waiter = make_shallow_copyable(
+                [composable = std::move(composable)](error_code err) mutable
+                {
+                    composable.complete(err);
+                }
+            );
+
+            if (!m_started)
+            {
+                m_started      = true;
+                m_partition_id = message::partition_id(message::data {m_name}, m_conn.partition_count());
+
+                fill();
+            }
+
+            // Whatever is at hand already is handed over through the
+            // executor, never from within this call.
+            boost::asio::post(m_conn.sck().get_executor(), [this] { deliver(); });
+        },
+        token
+    );
+}
+
+inline std::int64_t ringbuffer_consumer::sequence() const
+{
+    return m_sequence;
+}
+
+inline void ringbuffer_consumer::fill()
+{
+    if (m_error)
+        return;
+
+    // The reads leave with a single write.
+    m_conn.hold_writes();
+
+    for (auto& w : m_windows)
+    {
+        if (m_at_tail && &w != &m_windows.front())
+            break;
+
+        if (!w.reading && w.start < w.end)
+            read(w);
+    }
+
+    while (m_windows.size() < m_options.reads_in_flight && !(m_at_tail && !m_windows.empty()))
+    {
+        auto& w = m_windows.emplace_back();
+
+        w.start = m_next_window;
+        w.end   = m_next_window + m_options.batch_size;
+
+        m_next_window = w.end;
+
+        read(w);
+    }
+
+    m_conn.release_writes();
+}
+
+inline void ringbuffer_consumer::read(window& w)
+{
+    message::request<message::ringbuffer_read_many> req;
+
+    auto count = std::int32_t(w.end - w.start);
+
+    req.header.partition_id = m_partition_id;
+    req.entity = {
+        m_name,
+        w.start,
+        std::min(m_options.min_count, count),
+        count,
+        m_options.filter
+    };
+
+    w.reading = true;
+
+    if (w.response.items.capacity() == 0)
+        w.response.items = take_spare();
+
+    m_conn.invoke_into(
+        std::move(req),
+        w.response,
+        [this, &w](const error_code& err)
+        {
+            on_read(w, err);
+        }
+    );
+}
+
+inline void ringbuffer_consumer::on_read(window& w, error_code err)
+{
+    w.reading = false;
+
+    if (m_error)
+        return;
+
+    auto& res = w.response;
+
+    // A filtered read goes past its window as far as its items took it, and
+    // the next window starts from there.
+    if (!err && m_options.filter && res.next_sequence > w.end)
+    {
+        w.end         = res.next_sequence;
+        m_next_window = std::max(m_next_window, w.end);
+    }
+
+    if (!err && (res.next_sequence <= w.start || res.next_sequence > w.end))
+        err = error::malformed_response;
+
+    if (err)
+    {
+        // The member turns down reads which start past the tail. Those are
+        // sent again once they are the front window.
+        if (&w != &m_windows.front())
+        {
+            m_at_tail = true;
+
+            return;
+        }
+
+        m_error = err;
+
+        return deliver();
+    }
+
+    if (!res.items.empty())
+    {
+        batch b {take_spare(), res.next_sequence};
+
+        std::swap(b.items, res.items);
+
+        w.ready.push_back(std::move(b));
+    }
+
+    w.start   = res.next_sequence;
+    m_at_tail = w.start < w.end;
+
+    if (m_at_tail)
+        read(w);
+
+    deliver();
+}
+
+inline void ringbuffer_consumer::deliver()
+{
+    if (!m_waiter)
+        return;
+
+    while (!m_windows.empty())
+    {
+        auto& front = m_windows.front();
+
+        if (!front.ready.empty() || front.reading || front.start < front.end)
+            break;
+
+        m_windows.pop_front();
+    }
+
+    error_code err;
+
+    if (!m_windows.empty() && !m_windows.front().ready.empty())
+    {
+        auto& ready = m_windows.front().ready;
+        auto& b     = ready.front();
+
+        std::swap(*m_out, b.items);
+
+        m_sequence = b.next_sequence;
+        m_spare.push_back(std::move(b.items));
+
+        ready.pop_front();
+    }
+    else if (m_error)
+    {
+        err = m_error;
+    }
+    else
+    {
+        return fill();
+    }
+
+    fill();
+
+    auto waiter = std::move(m_waiter);
+
+    m_waiter = nullptr;
+    m_out    = nullptr;
+
+    waiter(err);
+}
+
+inline std::vector<message::data> ringbuffer_consumer::take_spare()
+{
+    if (m_spare.empty())
+        return {};
+
+    auto items = std::move(m_spare.back());
+
+    m_spare.pop_back();
+
+    return items;
+}
+
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+#include "hz_client/message/data.hpp"
+
+namespace hz_client
+{
+
+struct skew_profiler_options
+{
+    // One invocation and one key in this many are recorded on average, the
+    // others cost a counter decrement. Each one is recorded with the same
+    // chance, independently of the others, so that a pattern of accesses
+    // repeating with the period of the sampling is not mistaken for skew.
+    std::uint32_t sample_every {64};
+
+    // Keys tracked for `hot_keys`. The counts of the keys reported are
+    // overestimated by at most the sampled keys over `top_keys`.
+    std::size_t top_keys {16};
+};
+
+struct partition_profile
+{
+    // Sampled invocations, see `skew_snapshot::sample_every`.
+    std::uint64_t requests {0};
+    std::uint64_t request_bytes {0};
+    std::uint64_t responses {0};
+    std::uint64_t response_bytes {0};
+
+    // From the request being queued for writing to its response being
+    // read, over the sampled responses.
+    std::chrono::nanoseconds total_latency {0};
+    std::chrono::nanoseconds max_latency {0};
+
+    std::chrono::nanoseconds mean_latency() const
+    {
+        if (responses == 0)
+            return std::chrono::nanoseconds {0};
+
+        return total_latency / std::int64_t(responses);
+    }
+};
+
+struct hot_key
+{
+    // The key as it was first sampled, with the hash partitioning it.
+    message::data key;
+    std::int32_t  hash {0};
+
+    // Sampled occurrences, of which at most `error` may belong to the keys
+    // the entry took over from.
+    std::uint64_t count {0};
+    std::uint64_t error {0};
+};
+
+struct skew_snapshot
+{
+    std::uint32_t                  sample_every {1};
+    std::chrono::nanoseconds       elapsed {0};
+
+    // Indexed by partition id, up to the highest one seen. Invocations not
+    // bound to a partition are not recorded.
+    std::vector<partition_profile> partitions;
+
+    // Most frequent keys first.
+    std::vector<hot_key>           hot_keys;
+
+    // Estimated from the samples.
+    double requests_per_second(std::int32_t partition) const
+    {
+        if (std::size_t(partition) >= partitions.size() || elapsed.count() <= 0)
+            return 0;
+
+        return double(partitions[partition].requests) * sample_every
+            / std::chrono::duration<double>(elapsed).count();
+    }
+};
+
+// Sampled record of the load the client puts on each partition and of its
+// hottest keys, to find the source of skew between members without logging
+// every request. Invocations are sampled by the connections it is attached
+// to, see `connection::set_profiler`, and keys by the maps over them. Keys
+// are counted with the space-saving algorithm over a fixed number of slots,
+// so memory stays bounded however many keys there are.
+//
+// To be used from the thread running the io_context.
+class skew_profiler
+{
+public:
+
+    using clock = std::chrono::steady_clock;
+
+    inline explicit skew_profiler(skew_profiler_options options = {});
+
+    // Whether the next invocation is to be recorded.
+    inline bool sample();
+
+    inline void record_request(std::int32_t partition, std::size_t bytes);
+    inline void record_response(
+        std::int32_t partition,
+        std::size_t bytes,
+        clock::duration latency
+    );
+
+    // Counts `key`, whose partitioning hash is `hash`, if it is sampled.
+    inline void record_key(const message::data& key, std::int32_t hash);
+
+    inline skew_snapshot snapshot() const;
+
+    // Forgets everything recorded so far.
+    inline void reset();
+
+private:
+
+    inline partition_profile* profile_of(std::int32_t partition);
+
+    // Slot of `key`, looked up by its hash, or `m_keys.size()`.
+    inline std::size_t slot_of(const message::data& key, std::int32_t hash) const;
+
+    // How many of the next ones go unrecorded before the one which is,
+    // geometrically distributed, drawn from an xorshift64* generator.
+    inline std::uint64_t next_skip();
+
+    skew_profiler_options          m_options;
+    clock::time_point              m_started;
+    std::uint64_t                  m_random {0x9e3779b97f4a7c15};
+    std::uint64_t                  m_invocation_skip {0};
+    std::uint64_t                  m_key_skip {0};
+    std::vector<partition_profile> m_partitions;
+
+    // Space-saving slots, and the slots of the keys of each hash in them.
+    // Keys of the same hash are told apart by their bytes.
+    std::vector<hot_key>                               m_keys;
+    std::unordered_multimap<std::int32_t, std::size_t> m_key_slots;
+};
+
+inline skew_profiler::skew_profiler(skew_profiler_options options)
+    :   m_options {options}
+    ,   m_started {clock::now()}
+{
+    if (m_options.sample_every == 0)
+        m_options.sample_every = 1;
+
+    m_keys.reserve(m_options.top_keys);
+
+    m_invocation_skip = next_skip();
+    m_key_skip        = next_skip();
+}
+
+inline bool skew_profiler::sample()
+{
+    if (m_invocation_skip > 0)
+    {
+        --m_invocation_skip;
+
+        return false;
+    }
+
+    m_invocation_skip = next_skip();
+
+    return true;
+}
+
+inline void skew_profiler::record_request(std::int32_t partition, std::size_t bytes)
+{
+    if (auto* p = profile_of(partition))
+    {
+        ++p->requests;
+        p->request_bytes += bytes;
+    }
+}
+
+inline void skew_profiler::record_response(
+    std::int32_t partition,
+    std::size_t bytes,
+    clock::duration latency
+)
+{
+    if (auto* p = profile_of(partition))
+    {
+        ++p->responses;
+        p->response_bytes += bytes;
+        p->total_latency  += latency;
+        p->max_latency     = std::max<std::chrono::nanoseconds>(p->max_latency, latency);
+    }
+}
+
+inline void skew_profiler::record_key(const message::data& key, std::int32_t hash)
+{
+    if (m_options.top_keys == 0)
+        return;
+
+    if (m_key_skip > 0)
+    {
+        --m_key_skip;
+
+        return;
+    }
+
+    m_key_skip = next_skip();
+
+    if (auto slot = slot_of(key, hash); slot < m_keys.size())
+    {
+        ++m_keys[slot].count;
+
+        return;
+    }
+
+    if (m_keys.size() < m_options.top_keys)
+    {
+        m_key_slots.emplace(hash, m_keys.size());
+        m_keys.push_back({key, hash, 1, 0});
+
+        return;
+    }
+
+    // The least counted key makes room, its count becoming the error of
+    // the one taking over.
+    auto least = std::min_element(
+        begin(m_keys),
+        end(m_keys),
+        [](const hot_key& a, const hot_key& b) { return a.count < b.count; }
+    );
+
+    auto slot          = std::size_t(least - begin(m_keys));
+    auto [first, last] = m_key_slots.equal_range(least->hash);
+
+    m_key_slots.erase(
+        std::find_if(first, last, [slot](const auto& x) { return x.second == slot; })
+    );
+    m_key_slots.emplace(hash, slot);
+
+    least->key   = key;
+    least->hash  = hash;
+    least->error = least->count;
+    ++least->count;
+}
+
+inline skew_snapshot skew_profiler::snapshot() const
+{
+    skew_snapshot x;
+
+    x.sample_every = m_options.sample_every;
+    x.elapsed      = clock::now() - m_started;
+    x.partitions   = m_partitions;
+    x.hot_keys     = m_keys;
+
+    std::sort(
+        begin(x.hot_keys),
+        end(x.hot_keys),
+        [](const hot_key& a, const hot_key& b) { return a.count > b.count; }
+    );
+
+    return x;
+}
+
+inline void skew_profiler::reset()
+{
+    m_started         = clock::now();
+    m_invocation_skip = next_skip();
+    m_key_skip        = next_skip();
+
+    m_partitions.clear();
+    m_keys.clear();
+    m_key_slots.clear();
+}
+
+inline std::size_t skew_profiler::slot_of(const message::data& key, std::int32_t hash) const
+{
+    auto [first, last] = m_key_slots.equal_range(hash);
+
+    for (auto it = first; it != last; ++it)
+    {
+        const auto& x = m_keys[it->second].key;
+
+        if (x.type_id == key.type_id && x.payload == key.payload)
+            return it->second;
+    }
+
+    return m_keys.size();
+}
+
+inline std::uint64_t skew_profiler::next_skip()
+{
+    if (m_options.sample_every == 1)
+        return 0;
+
+    m_random ^= m_random >> 12;
+    m_random ^= m_random << 25;
+    m_random ^= m_random >> 27;
+
+    // Uniform over (0, 1], from the top 53 bits.
+    auto u = double(((m_random * 0x2545f4914f6cdd1d) >> 11) + 1) * 0x1.0p-53;
+
+    return std::uint64_t(std::log(u) / std::log1p(-1.0 / m_options.sample_every));
+}
+
+inline partition_profile* skew_profiler::profile_of(std::int32_t partition)
+{
+    if (partition < 0)
+        return nullptr;
+
+    if (std::size_t(partition) >= m_partitions.size())
+        m_partitions.resize(std::size_t(partition) + 1);
+
+    return &m_partitions[partition];
+}
+
+}
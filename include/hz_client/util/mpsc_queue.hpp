@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace hz_client
+{
+
+// Bounded lock-free queue for many producers and a single consumer, after
+// Dmitry Vyukov's bounded MPMC queue. Each cell carries a sequence number
+// telling whether it is free for the producer claiming its position or
+// holds a value for the consumer; producers only contend on the head.
+template<typename T>
+class mpsc_queue
+{
+public:
+
+    // The capacity is rounded up to a power of two.
+    explicit mpsc_queue(std::size_t capacity);
+
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    // Safe to be called from any thread. `x` is left untouched when the
+    // queue is full.
+    bool try_push(T&& x);
+
+    // Consumer only.
+    bool try_pop(T& x);
+    bool empty() const;
+
+    std::size_t capacity() const;
+
+private:
+
+    static inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    struct cell
+    {
+        std::atomic<std::size_t> sequence;
+        T                        value;
+    };
+
+    static std::size_t round_up(std::size_t n);
+
+    std::size_t                                    m_mask;
+    std::unique_ptr<cell[]>                        m_cells;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_head;
+    alignas(CACHE_LINE_SIZE) std::size_t            m_tail;
+};
+
+template<typename T>
+mpsc_queue<T>::mpsc_queue(std::size_t capacity)
+    :   m_mask {round_up(capacity) - 1}
+    ,   m_cells {new cell[m_mask + 1]}
+    ,   m_head {0}
+    ,   m_tail {0}
+{
+    for (std::size_t i = 0; i <= m_mask; ++i)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template<typename T>
+bool mpsc_queue<T>::try_push(T&& x)
+{
+    auto pos = m_head.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        auto& c   = m_cells[pos & m_mask];
+        auto  seq = c.sequence.load(std::memory_order_acquire);
+        auto  dif = std::intptr_t(seq) - std::intptr_t(pos);
+
+        if (dif == 0)
+        {
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                c.value = std::move(x);
+                c.sequence.store(pos + 1, std::memory_order_release);
+
+                return true;
+            }
+        }
+        else if (dif < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+bool mpsc_queue<T>::try_pop(T& x)
+{
+    auto& c = m_cells[m_tail & m_mask];
+
+    if (c.sequence.load(std::memory_order_acquire) != m_tail + 1)
+        return false;
+
+    x = std::move(c.value);
+    c.sequence.store(m_tail + m_mask + 1, std::memory_order_release);
+    ++m_tail;
+
+    return true;
+}
+
+template<typename T>
+bool mpsc_queue<T>::empty() const
+{
+    return m_cells[m_tail & m_mask].sequence.load(std::memory_order_acquire) != m_tail + 1;
+}
+
+template<typename T>
+std::size_t mpsc_queue<T>::capacity() const
+{
+    return m_mask + 1;
+}
+
+template<typename T>
+std::size_t mpsc_queue<T>::round_up(std::size_t n)
+{
+    std::size_t x {2};
+
+    while (x < n)
+        x <<= 1;
+
+    return x;
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace hz_client
+{
+
+// MurmurHash3_x86_32 as used by the members to map a key to its partition.
+inline std::int32_t murmur_hash3_x86_32(
+    const char* data,
+    std::size_t len,
+    std::uint32_t seed = 0x01000193
+)
+{
+    constexpr std::uint32_t c1 = 0xcc9e2d51;
+    constexpr std::uint32_t c2 = 0x1b873593;
+
+    auto rotl = [](std::uint32_t x, int r) {
+        return (x << r) | (x >> (32 - r));
+    };
+
+    auto bytes = reinterpret_cast<const std::uint8_t*>(data);
+    auto n_blocks = len / 4;
+    std::uint32_t h1 = seed;
+
+    for (std::size_t i = 0; i < n_blocks; ++i)
+    {
+        std::uint32_t k1 = std::uint32_t(bytes[i * 4]) |
+                           std::uint32_t(bytes[i * 4 + 1]) << 8 |
+                           std::uint32_t(bytes[i * 4 + 2]) << 16 |
+                           std::uint32_t(bytes[i * 4 + 3]) << 24;
+
+        k1 *= c1;
+        k1 = rotl(k1, 15);
+        k1 *= c2;
+
+        h1 ^= k1;
+        h1 = rotl(h1, 13);
+        h1 = h1 * 5 + 0xe6546b64;
+    }
+
+    auto tail = bytes + n_blocks * 4;
+    std::uint32_t k1 = 0;
+
+    switch (len & 3)
+    {
+        case 3: k1 ^= std::uint32_t(tail[2]) << 16; [[fallthrough]];
+        case 2: k1 ^= std::uint32_t(tail[1]) << 8;  [[fallthrough]];
+        case 1: k1 ^= std::uint32_t(tail[0]);
+                k1 *= c1;
+                k1 = rotl(k1, 15);
+                k1 *= c2;
+                h1 ^= k1;
+    }
+
+    h1 ^= std::uint32_t(len);
+    h1 ^= h1 >> 16;
+    h1 *= 0x85ebca6b;
+    h1 ^= h1 >> 13;
+    h1 *= 0xc2b2ae35;
+    h1 ^= h1 >> 16;
+
+    return static_cast<std::int32_t>(h1);
+}
+
+}
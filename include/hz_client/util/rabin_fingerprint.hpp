@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace hz_client
+{
+
+inline constexpr std::uint64_t RABIN_FINGERPRINT_INIT = 0xc15d213aa4d7a795;
+
+constexpr std::array<std::uint64_t, 256> make_rabin_fingerprint_table()
+{
+    std::array<std::uint64_t, 256> table {};
+
+    for (std::uint64_t i = 0; i < 256; ++i)
+    {
+        auto fp = i;
+
+        for (int j = 0; j < 8; ++j)
+            fp = (fp >> 1) ^ (RABIN_FINGERPRINT_INIT & (0 - (fp & 1)));
+
+        table[i] = fp;
+    }
+
+    return table;
+}
+
+inline constexpr auto RABIN_FINGERPRINT_TABLE = make_rabin_fingerprint_table();
+
+// 64 bit Rabin fingerprint as the members compute it for the ids of Compact
+// schemas. Integers are fed to it as their four bytes, least significant
+// first, and strings as their length followed by their bytes.
+class rabin_fingerprint
+{
+public:
+
+    constexpr void add(std::uint8_t x)
+    {
+        m_value = (m_value >> 8) ^ RABIN_FINGERPRINT_TABLE[(m_value ^ x) & 0xff];
+    }
+
+    constexpr void add(std::int32_t x)
+    {
+        auto u = std::uint32_t(x);
+
+        for (int i = 0; i < 4; ++i)
+            add(std::uint8_t(u >> (8 * i)));
+    }
+
+    constexpr void add(std::string_view x)
+    {
+        add(std::int32_t(x.size()));
+
+        for (auto c : x)
+            add(std::uint8_t(c));
+    }
+
+    constexpr std::int64_t value() const
+    {
+        return std::int64_t(m_value);
+    }
+
+private:
+
+    std::uint64_t m_value {RABIN_FINGERPRINT_INIT};
+};
+
+}
@@ -1,6 +1,2908 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/uuid/random_generator.hpp>
+
+#include <hz_client/atomic_long.hpp>
+#include <hz_client/busy_poll.hpp>
+#include <hz_client/capture.hpp>
+#include <hz_client/cluster.hpp>
+#include <hz_client/compact.hpp>
+#include <hz_client/compression.hpp>
+#include <hz_client/connection.hpp>
+#include <hz_client/flake_id_generator.hpp>
+#include <hz_client/map.hpp>
+#include <hz_client/map_scan.hpp>
+#include <hz_client/metrics.hpp>
+#include <hz_client/metrics_allocation_hooks.hpp>
+#include <hz_client/paged_query.hpp>
+#include <hz_client/pipeline.hpp>
+#include <hz_client/pn_counter.hpp>
+#include <hz_client/query.hpp>
+#include <hz_client/queue.hpp>
+#include <hz_client/ringbuffer.hpp>
+#include <hz_client/skew_profiler.hpp>
+
+#include "stand_in_member.hpp"
+
+using error_code = boost::system::error_code;
+
+namespace
+{
+
+hz_client::message::authentication credentials()
+{
+    hz_client::message::authentication req;
+
+    req.cluster_name  = "dev";
+    req.instance_name = "connection-test";
+    req.uid           = boost::uuids::random_generator()();
+
+    return req;
+}
+
+// Connects and authenticates `conn`, then runs `body` on the io_context.
+template<typename F>
+void with_session(
+    boost::asio::io_context& ctx,
+    hz_client::connection& conn,
+    const stand_in_member& member,
+    F body
+)
+{
+    conn.async_connect(
+        member.endpoint(),
+        [&conn, body](const error_code& err) mutable
+        {
+            REQUIRE_FALSE(err);
+
+            conn.async_authenticate(
+                credentials(),
+                [body](const error_code& err) mutable
+                {
+                    REQUIRE_FALSE(err);
+
+                    body();
+                }
+            );
+        }
+    );
+
+    ctx.run();
+}
+
+// An envelope of `bytes` claiming to restore to a string of `original_size`.
+hz_client::message::data envelope(
+    hz_client::compression_algorithm algorithm,
+    std::uint32_t original_size,
+    std::vector<char> bytes
+)
+{
+    std::vector<char> payload(hz_client::COMPRESSION_ENVELOPE_HEADER);
+
+    auto type_id = boost::endian::native_to_big(hz_client::message::data::CONSTANT_TYPE_STRING);
+    auto size    = boost::endian::native_to_big(original_size);
+
+    payload[0] = char(algorithm);
+    std::memcpy(payload.data() + 1, &type_id, sizeof(type_id));
+    std::memcpy(payload.data() + 5, &size, sizeof(size));
+    payload.insert(end(payload), begin(bytes), end(bytes));
+
+    return {hz_client::COMPRESSED_TYPE_ID, std::move(payload)};
+}
+
+std::vector<char> bytes(std::initializer_list<int> x)
+{
+    return {begin(x), end(x)};
+}
+
+template<typename T>
+std::vector<char> encode(const hz_client::message::request<T>& req)
+{
+    std::stringbuf encoded;
+
+    rbs::serialize_le(req, encoded);
+
+    auto x = encoded.str();
+
+    return {begin(x), end(x)};
+}
+
+struct get_runner
+{
+    hz_client::connection& conn;
+    int                    left;
+    int                    in_flight {0};
+};
+
+void issue_get(std::shared_ptr<get_runner> r)
+{
+    --r->left;
+    ++r->in_flight;
+
+    hz_client::message::request<hz_client::message::map_get> req;
+
+    req.entity = {"map", 42};
+
+    r->conn.invoke(
+        std::move(req),
+        [r](const error_code& err, std::vector<char>)
+        {
+            REQUIRE_FALSE(err);
+
+            --r->in_flight;
+
+            if (r->left > 0)
+                issue_get(r);
+            else if (r->in_flight == 0)
+                r->conn.close();
+        }
+    );
+}
+
+// Keeps `depth` map_get invocations in flight until `total` are complete,
+// then closes the connection.
+void run_gets(hz_client::connection& conn, int depth, int total)
+{
+    auto r = std::make_shared<get_runner>(get_runner {conn, total});
+
+    for (int i = 0; i < depth && r->left > 0; ++i)
+        issue_get(r);
+}
+
+// Runs `total` map_get invocations one after the other, each decoded into
+// the same response.
+void run_gets_into(
+    hz_client::connection& conn,
+    hz_client::message::response<hz_client::message::map_get>& res,
+    int total
+)
+{
+    if (total == 0)
+        return conn.close();
+
+    hz_client::message::request<hz_client::message::map_get> req;
+
+    req.entity = {"map", 42};
+
+    conn.invoke_into(
+        std::move(req),
+        res,
+        [&conn, &res, total](const error_code& err)
+        {
+            REQUIRE_FALSE(err);
+
+            run_gets_into(conn, res, total - 1);
+        }
+    );
+}
+
+struct order
+{
+    std::int64_t               id {0};
+    std::int32_t               quantity {0};
+    bool                       paid {false};
+    bool                       gift {false};
+    double                     price {0};
+    std::string                sku;
+    std::optional<std::string> note;
+};
+
+}
+
+template<>
+struct hz_client::message::compact_codec<order>
+{
+    static inline constexpr const char* type_name = "order";
+
+    static inline constexpr auto fields = std::tuple {
+        compact_field {"id", &order::id},
+        compact_field {"quantity", &order::quantity},
+        compact_field {"paid", &order::paid},
+        compact_field {"gift", &order::gift},
+        compact_field {"price", &order::price},
+        compact_field {"sku", &order::sku},
+        compact_field {"note", &order::note}
+    };
+};
+
 TEST_CASE("async_connect", "[connection]")
 {
-    throw std::runtime_error { "Not implemented yet." };
-}
\ No newline at end of file
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    error_code result {hz_client::error::not_connected};
+
+    conn.async_connect(
+        member.endpoint(),
+        [&](const error_code& err)
+        {
+            result = err;
+
+            conn.close();
+        }
+    );
+
+    ctx.run();
+
+    REQUIRE_FALSE(result);
+}
+
+TEST_CASE("async_authenticate takes the partition count", "[connection]")
+{
+    stand_in_member         member {17};
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    with_session(ctx, conn, member, [&] { conn.close(); });
+
+    REQUIRE(conn.partition_count() == 17);
+}
+
+TEST_CASE("invoke completes with the response", "[connection]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    std::vector<char> response;
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            conn.invoke(
+                hz_client::message::request<hz_client::message::ping>{},
+                [&](const error_code& err, std::vector<char> x)
+                {
+                    REQUIRE_FALSE(err);
+
+                    response = std::move(x);
+
+                    conn.close();
+                }
+            );
+        }
+    );
+
+    hz_client::message::response<hz_client::message::ping> res;
+
+    REQUIRE_FALSE(response.empty());
+    REQUIRE_FALSE(hz_client::message::decode_response(response, res));
+}
+
+TEST_CASE("invoke_into fills caller-owned storage", "[connection]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    std::vector<char> buffer;
+    std::size_t       size {0};
+
+    hz_client::message::response<hz_client::message::map_get> res;
+
+    res.value = hz_client::message::data {42};
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            conn.invoke_into(
+                hz_client::message::request<hz_client::message::ping>{},
+                buffer,
+                [&](const error_code& err, std::size_t n)
+                {
+                    REQUIRE_FALSE(err);
+
+                    size = n;
+
+                    run_gets_into(conn, res, 1);
+                }
+            );
+        }
+    );
+
+    REQUIRE(size > 0);
+    REQUIRE(size == buffer.size());
+    REQUIRE_FALSE(res.value);
+}
+
+TEST_CASE("invoke fails when not connected", "[connection]")
+{
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    error_code result;
+
+    conn.invoke(
+        hz_client::message::request<hz_client::message::ping>{},
+        [&](const error_code& err, std::vector<char>) { result = err; }
+    );
+
+    ctx.run();
+
+    REQUIRE(result == hz_client::error::not_connected);
+}
+
+TEST_CASE("pipelined invocations all complete", "[connection]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    with_session(ctx, conn, member, [&] { run_gets(conn, 256, 20000); });
+
+    REQUIRE(member.requests() == 20000 + 1);
+}
+
+TEST_CASE("size or deadline flushing writes pipelined invocations", "[connection]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::flush_policy policy;
+
+    policy.mode      = hz_client::flush_mode::size_or_deadline;
+    policy.max_delay = std::chrono::microseconds {50};
+    policy.no_delay  = true;
+    policy.cork      = true;
+
+    conn.set_flush_policy(policy);
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    std::uint64_t writes {0};
+    std::uint64_t messages {0};
+#endif
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+#if defined(HZ_CLIENT_WITH_METRICS)
+            writes   = conn.counters().write_calls;
+            messages = conn.counters().messages_written;
+#endif
+
+            run_gets(conn, 100, 100);
+        }
+    );
+
+    REQUIRE(member.requests() == 100 + 1);
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    // All of them with a single write, where an immediate one would have
+    // gone out on its own.
+    REQUIRE(conn.counters().write_calls - writes == 1);
+    REQUIRE(conn.counters().messages_written - messages == 100);
+#endif
+}
+
+TEST_CASE("adaptive flushing holds writes while invocations are in flight", "[connection]")
+{
+    using namespace std::chrono_literals;
+
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::flush_policy policy;
+
+    // Held for `max_delay`, whatever round trip the delayed responses
+    // average out to.
+    policy.mode         = hz_client::flush_mode::adaptive;
+    policy.max_delay    = 20ms;
+    policy.rtt_fraction = 16;
+
+    conn.set_flush_policy(policy);
+
+    boost::asio::steady_timer spacing {ctx};
+
+    int completed {0};
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    std::uint64_t writes {0};
+    std::uint64_t messages {0};
+#endif
+
+    auto get = [&](std::function<void()> then)
+    {
+        hz_client::message::request<hz_client::message::map_get> req;
+
+        req.entity = {"map", 42};
+
+        conn.invoke(
+            std::move(req),
+            [&, then](const error_code& err, std::vector<char>)
+            {
+                REQUIRE_FALSE(err);
+
+                ++completed;
+
+                if (then)
+                    then();
+            }
+        );
+    };
+
+    // Gets a while apart, all of them issued within the hold time, none of
+    // them while a write is in progress.
+    std::function<void(int)> spaced = [&](int left)
+    {
+        if (left == 1)
+            return get([&] { conn.close(); });
+
+        get(nullptr);
+
+        spacing.expires_after(200us);
+        spacing.async_wait([&, left](const error_code&) { spaced(left - 1); });
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            member.delay_responses(50ms);
+
+            // A delayed round trip is observed first.
+            get(
+                [&]
+                {
+#if defined(HZ_CLIENT_WITH_METRICS)
+                    writes   = conn.counters().write_calls;
+                    messages = conn.counters().messages_written;
+#endif
+
+                    // Written right away, nothing else being in flight.
+                    get(nullptr);
+
+                    spacing.expires_after(200us);
+                    spacing.async_wait([&](const error_code&) { spaced(5); });
+                }
+            );
+        }
+    );
+
+    REQUIRE(completed == 1 + 1 + 5);
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    // The spaced gets went together, where immediate flushing writes each
+    // one on its own.
+    REQUIRE(conn.counters().write_calls - writes == 2);
+    REQUIRE(conn.counters().messages_written - messages == 1 + 5);
+#endif
+}
+
+TEST_CASE("pipeline hands results back in order within its depth", "[pipeline]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    using get_pipeline = hz_client::pipeline<hz_client::message::map_get>;
+
+    std::vector<std::size_t> delivered;
+    std::size_t              max_in_flight {0};
+    bool                     waited {false};
+    bool                     initiating {false};
+
+    std::unique_ptr<get_pipeline> gets;
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            gets = std::make_unique<get_pipeline>(
+                conn,
+                8,
+                [&](std::size_t index, const error_code& err, std::vector<char>)
+                {
+                    REQUIRE_FALSE(err);
+
+                    delivered.push_back(index);
+                    max_in_flight = std::max(max_in_flight, gets->in_flight());
+                }
+            );
+
+            for (int i = 0; i < 1000; ++i)
+            {
+                hz_client::message::request<hz_client::message::map_get> req;
+
+                req.entity = {"map", i};
+
+                gets->add(std::move(req));
+            }
+
+            gets->async_wait(
+                [&](const error_code& err)
+                {
+                    REQUIRE_FALSE(err);
+
+                    initiating = true;
+
+                    // With nothing left to wait for.
+                    gets->async_wait(
+                        [&](const error_code& err)
+                        {
+                            REQUIRE_FALSE(err);
+                            REQUIRE_FALSE(initiating);
+
+                            waited = true;
+
+                            conn.close();
+                        }
+                    );
+
+                    initiating = false;
+                }
+            );
+        }
+    );
+
+    REQUIRE(waited);
+    REQUIRE(delivered.size() == 1000);
+    REQUIRE(std::is_sorted(begin(delivered), end(delivered)));
+    REQUIRE(delivered.back() == 999);
+    REQUIRE(max_in_flight <= 8);
+    REQUIRE(member.requests() == 1000 + 1);
+}
+
+TEST_CASE("pipeline fails its queue without recursing once disconnected", "[pipeline]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    using get_pipeline = hz_client::pipeline<hz_client::message::map_get>;
+
+    constexpr std::size_t total = 200000;
+
+    std::size_t delivered {0};
+    std::size_t closed {0};
+
+    get_pipeline gets {
+        conn,
+        4,
+        [&](std::size_t index, const error_code& err, std::vector<char>)
+        {
+            REQUIRE(index == delivered++);
+
+            if (err == hz_client::error::connection_closed)
+                ++closed;
+        }
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            for (std::size_t i = 0; i < total; ++i)
+            {
+                hz_client::message::request<hz_client::message::map_get> req;
+
+                req.entity = {"map", 42};
+
+                gets.add(std::move(req));
+            }
+
+            // The queued requests fail one refill after the other, each
+            // one of them from its own handler.
+            conn.close();
+        }
+    );
+
+    REQUIRE(delivered == total);
+    REQUIRE(closed == total);
+}
+
+TEST_CASE("busy polling runs the io_context until out of work", "[connection]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    conn.set_busy_poll(std::chrono::microseconds {50});
+
+    hz_client::busy_poll_options options;
+
+    options.spin_for  = std::chrono::microseconds {100};
+    options.yield_for = std::chrono::microseconds {100};
+
+    conn.async_connect(
+        member.endpoint(),
+        [&](const error_code& err)
+        {
+            REQUIRE_FALSE(err);
+
+            conn.async_authenticate(
+                credentials(),
+                [&](const error_code& err)
+                {
+                    REQUIRE_FALSE(err);
+
+                    run_gets(conn, 16, 1000);
+                }
+            );
+        }
+    );
+
+    REQUIRE_FALSE(hz_client::run_busy_polling(ctx, options));
+    REQUIRE(member.requests() == 1000 + 1);
+}
+
+TEST_CASE("invocations are sent again or failed once the link drops", "[connection]")
+{
+    using namespace std::chrono_literals;
+
+    for (bool redo_operations : {false, true})
+    {
+        hz_client::reconnect_options options;
+
+        options.initial_backoff = 10ms;
+        options.redo_operations = redo_operations;
+
+        stand_in_member         member {271, 2};
+        boost::asio::io_context ctx;
+        hz_client::connection   conn {ctx, options};
+
+        error_code get_result {hz_client::error::not_connected};
+        error_code put_result {hz_client::error::not_connected};
+        int        completed {0};
+
+        auto complete = [&](error_code& result)
+        {
+            return [&](const error_code& err, std::vector<char>)
+            {
+                result = err;
+
+                if (++completed == 2)
+                    conn.close();
+            };
+        };
+
+        with_session(
+            ctx,
+            conn,
+            member,
+            [&]
+            {
+                // Whether or not the get is answered before the link drops,
+                // the put sent along with it never is.
+                member.drop_link_on(stand_in_member::MAP_PUT_TYPE);
+
+                hz_client::message::request<hz_client::message::map_get> get;
+                hz_client::message::request<hz_client::message::map_put> put;
+
+                get.entity = {"map", 42};
+                put.entity = {"map", 42, 42};
+
+                conn.invoke(std::move(get), complete(get_result));
+                conn.invoke(std::move(put), complete(put_result));
+            }
+        );
+
+        REQUIRE(completed == 2);
+        REQUIRE_FALSE(get_result);
+
+        if (redo_operations)
+            REQUIRE_FALSE(put_result);
+        else
+            REQUIRE(put_result == hz_client::error::connection_lost);
+    }
+}
+
+TEST_CASE("reconnecting gives up on unanswered authentications", "[connection]")
+{
+    using namespace std::chrono_literals;
+
+    hz_client::reconnect_options options;
+
+    options.initial_backoff        = 10ms;
+    options.max_attempts           = 2;
+    options.authentication_timeout = 50ms;
+
+    stand_in_member         member {271, 3};
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx, options};
+
+    error_code result;
+    auto       dropped = std::chrono::steady_clock::now();
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            member.ignore_authentications();
+            member.drop_link_on(stand_in_member::MAP_GET_TYPE);
+
+            hz_client::message::request<hz_client::message::map_get> req;
+
+            req.entity = {"map", 42};
+
+            dropped = std::chrono::steady_clock::now();
+
+            conn.invoke(
+                std::move(req),
+                [&](const error_code& err, std::vector<char>)
+                {
+                    result = err;
+
+                    conn.close();
+                }
+            );
+        }
+    );
+
+    // Kept through both attempts, each of which timed out.
+    REQUIRE(result == hz_client::error::connection_lost);
+    REQUIRE(std::chrono::steady_clock::now() - dropped >= 2 * 50ms);
+}
+
+TEST_CASE("backup-aware puts complete once their backups are acked", "[connection]")
+{
+    using namespace std::chrono_literals;
+
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+    hz_client::map          map {conn, "map"};
+
+    int  completed {0};
+    auto unacked_started = std::chrono::steady_clock::now();
+    auto unacked_took    = std::chrono::steady_clock::duration {};
+
+    auto put_unacked = [&]
+    {
+        member.drop_backup_acks();
+
+        unacked_started = std::chrono::steady_clock::now();
+
+        map.async_put(
+            0,
+            0,
+            [&](const error_code& err, std::optional<hz_client::message::data>)
+            {
+                REQUIRE_FALSE(err);
+
+                unacked_took = std::chrono::steady_clock::now() - unacked_started;
+
+                conn.close();
+            }
+        );
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            conn.async_enable_backup_acks(
+                50ms,
+                [&](const error_code& err)
+                {
+                    REQUIRE_FALSE(err);
+
+                    // Acked before the response for some, after it for the
+                    // others.
+                    for (int i = 0; i < 10; ++i)
+                    {
+                        map.async_put(
+                            i,
+                            i,
+                            [&](const error_code& err, std::optional<hz_client::message::data>)
+                            {
+                                REQUIRE_FALSE(err);
+
+                                if (++completed == 10)
+                                    put_unacked();
+                            }
+                        );
+                    }
+                }
+            );
+        }
+    );
+
+    REQUIRE(completed == 10);
+    REQUIRE(unacked_took >= 50ms);
+    REQUIRE(member.requests() == 1 + 1 + 10 + 1);
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    REQUIRE(conn.counters().backup_ack_timeouts == 1);
+#endif
+}
+
+TEST_CASE("compressed values are restored as they were", "[compression]")
+{
+    hz_client::message::data original {
+        hz_client::message::data::CONSTANT_TYPE_STRING,
+        std::vector<char>(64 * 1024, 'x')
+    };
+
+    for (auto algorithm : {hz_client::compression_algorithm::lz4, hz_client::compression_algorithm::zstd})
+    {
+        if (!hz_client::is_compression_supported(algorithm))
+            continue;
+
+        auto x = hz_client::compress(original, {algorithm, 4096, 3});
+
+        REQUIRE(hz_client::is_compressed(x));
+        REQUIRE(x.payload.size() < original.payload.size());
+        REQUIRE_FALSE(hz_client::decompress(x));
+        REQUIRE(x.type_id == original.type_id);
+        REQUIRE(x.payload == original.payload);
+    }
+
+    // Below the threshold, or without an algorithm, values are left alone.
+    auto small = hz_client::compress(42, {hz_client::compression_algorithm::lz4, 4096, 3});
+    auto plain = hz_client::compress(original, {});
+
+    REQUIRE_FALSE(hz_client::is_compressed(small));
+    REQUIRE_FALSE(hz_client::is_compressed(plain));
+
+    // An uncompressed envelope, as a member may hand back.
+    auto none = envelope(hz_client::compression_algorithm::none, 3, {'a', 'b', 'c'});
+
+    REQUIRE_FALSE(hz_client::decompress(none));
+    REQUIRE(none.payload == std::vector<char> {'a', 'b', 'c'});
+}
+
+TEST_CASE("corrupt compression envelopes are rejected", "[compression]")
+{
+    using hz_client::compression_algorithm;
+
+    hz_client::message::data truncated {hz_client::COMPRESSED_TYPE_ID, {char(0), char(0)}};
+
+    REQUIRE(hz_client::decompress(truncated) == hz_client::error::decompression_failed);
+
+    // Sizes which the bytes cannot account for fail before being allocated.
+    auto oversized = envelope(compression_algorithm::none, 0xffffffff, {'a'});
+    auto undersized = envelope(compression_algorithm::none, 0, {'a'});
+
+    REQUIRE(hz_client::decompress(oversized) == hz_client::error::decompression_failed);
+    REQUIRE(hz_client::decompress(undersized) == hz_client::error::decompression_failed);
+
+    if (hz_client::is_compression_supported(compression_algorithm::lz4))
+    {
+        auto inflated = envelope(compression_algorithm::lz4, 0xffffffff, {'a', 'b'});
+        auto garbage  = envelope(compression_algorithm::lz4, 64, std::vector<char>(8, char(0xff)));
+
+        REQUIRE(hz_client::decompress(inflated) == hz_client::error::decompression_failed);
+        REQUIRE(hz_client::decompress(garbage) == hz_client::error::decompression_failed);
+    }
+
+    if (hz_client::is_compression_supported(compression_algorithm::zstd))
+    {
+        auto garbage = envelope(compression_algorithm::zstd, 0xffffffff, std::vector<char>(8, char(0xff)));
+
+        REQUIRE(hz_client::decompress(garbage) == hz_client::error::decompression_failed);
+    }
+
+    auto unknown = envelope(compression_algorithm(9), 1, {'a'});
+
+    REQUIRE(hz_client::decompress(unknown) == hz_client::error::unsupported_compression);
+}
+
+TEST_CASE("map coalesces puts to the same key", "[map]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::map_options options;
+
+    options.coalescing.enabled = true;
+    options.coalescing.window  = std::chrono::seconds {10};
+
+    hz_client::map map {conn, "map", options};
+
+    int completed {0};
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                map.async_put(
+                    i % 2,
+                    i,
+                    [&](const error_code& err, std::optional<hz_client::message::data>)
+                    {
+                        REQUIRE_FALSE(err);
+
+                        if (++completed == 100)
+                            conn.close();
+                    }
+                );
+            }
+
+            map.flush();
+        }
+    );
+
+    REQUIRE(completed == 100);
+    REQUIRE(member.requests() == 1 + 2);
+}
+
+TEST_CASE("a get sends the put of its key pending ahead of it", "[map]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::map_options options;
+
+    options.coalescing.enabled = true;
+    options.coalescing.window  = std::chrono::seconds {10};
+
+    hz_client::map map {conn, "map", options};
+
+    std::vector<std::string> completed;
+
+    auto started = std::chrono::steady_clock::now();
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            map.async_put(
+                7,
+                1,
+                [&](const error_code& err, std::optional<hz_client::message::data>)
+                {
+                    REQUIRE_FALSE(err);
+
+                    completed.push_back("put");
+                }
+            );
+            map.async_get(
+                7,
+                [&](const error_code& err, std::optional<hz_client::message::data>)
+                {
+                    REQUIRE_FALSE(err);
+
+                    completed.push_back("get");
+
+                    conn.close();
+                }
+            );
+        }
+    );
+
+    // Neither waited for the window, whose timer is cancelled as well.
+    REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds {5});
+    REQUIRE(completed == std::vector<std::string> {"put", "get"});
+    REQUIRE(member.requests() == 1 + 2);
+}
+
+TEST_CASE("puts pending at destruction complete as closed", "[map]")
+{
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::map_options options;
+
+    options.coalescing.enabled = true;
+    options.coalescing.window  = std::chrono::seconds {10};
+
+    int        completed {0};
+    error_code result;
+
+    {
+        hz_client::map map {conn, "map", options};
+
+        for (int i = 0; i < 3; ++i)
+        {
+            map.async_put(
+                i % 2,
+                i,
+                [&](const error_code& err, std::optional<hz_client::message::data>)
+                {
+                    result = err;
+
+                    ++completed;
+                }
+            );
+        }
+    }
+
+    ctx.run();
+
+    REQUIRE(completed == 3);
+    REQUIRE(result == hz_client::error::connection_closed);
+}
+
+TEST_CASE("generated codecs match the wire bytes of the protocol", "[codec]")
+{
+    using namespace hz_client::message;
+
+    request<map_get> get;
+
+    get.header.correlation_id = 42;
+    get.header.partition_id   = 3;
+    get.entity                = {"map", data {7}};
+
+    REQUIRE(encode(get) == bytes({
+        // Initial frame: length, flags, type, correlation id, partition id
+        // and the thread id, the only fixed-size field.
+        0x1e, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x02, 0x01, 0x00,
+        0x2a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+        0x88, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        // Map name.
+        0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 'm', 'a', 'p',
+        // Key: partition hash, type id and payload, big endian.
+        0x12, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xf9, 0x00, 0x00, 0x00, 0x07,
+        // End of the message.
+        0x06, 0x00, 0x00, 0x00, 0x00, 0x28
+    }));
+
+    // Without variable-size fields the initial frame is the final one, and
+    // a message for any member has no partition.
+    request<ping> ping;
+
+    ping.header.correlation_id = 1;
+    ping.header.partition_id   = 3;
+
+    REQUIRE(encode(ping) == bytes({
+        0x16, 0x00, 0x00, 0x00, 0x00, 0xe0, 0x00, 0x0b, 0x00, 0x00,
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff
+    }));
+
+    // Fixed-size fields are read at the offsets the layout gives them,
+    // past the type, the correlation id and the backup acks.
+    auto authenticated = bytes({
+        0x3c, 0x00, 0x00, 0x00, 0x00, 0xe0, 0x01, 0x01, 0x00, 0x00,
+        0x2a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        // Status, member uuid, serialization version, partition count.
+        0x00,
+        0x00, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01, 0x00,
+        0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x09, 0x08,
+        0x01, 0x0f, 0x01, 0x00, 0x00,
+        // Null cluster id, failover supported.
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01
+    });
+
+    response<authentication> auth;
+
+    REQUIRE_FALSE(decode_response(authenticated, auth));
+    REQUIRE(auth.status == 0);
+    REQUIRE(auth.member_uuid == boost::uuids::uuid {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}});
+    REQUIRE(auth.serialization_version == 1);
+    REQUIRE(auth.partition_count == 271);
+    REQUIRE(auth.cluster_id.is_nil());
+    REQUIRE(auth.failover_supported);
+
+    auto found = bytes({
+        0x13, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x01, 0x02, 0x01, 0x00,
+        0x2a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x12, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xf9, 0x00, 0x00, 0x00, 0x07,
+        0x06, 0x00, 0x00, 0x00, 0x00, 0x28
+    });
+
+    auto missing = bytes({
+        0x13, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x01, 0x02, 0x01, 0x00,
+        0x2a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x06, 0x00, 0x00, 0x00, 0x00, 0x04,
+        0x06, 0x00, 0x00, 0x00, 0x00, 0x28
+    });
+
+    response<map_get> value;
+
+    REQUIRE_FALSE(decode_response(found, value));
+    REQUIRE(value.value);
+    REQUIRE(value.value->type_id == data::CONSTANT_TYPE_INTEGER);
+    REQUIRE(value.value->payload == data {7}.payload);
+
+    REQUIRE_FALSE(decode_response(missing, value));
+    REQUIRE_FALSE(value.value);
+}
+
+TEST_CASE("only reads are shareable", "[map]")
+{
+    using namespace hz_client::message;
+
+    STATIC_REQUIRE(is_shareable_v<map_get>);
+    STATIC_REQUIRE(is_shareable_v<query_with_paging_predicate<iteration_type::key>>);
+    STATIC_REQUIRE(is_shareable_v<atomic_long_get>);
+
+    // Retryable, yet each invocation has to reach the member.
+    STATIC_REQUIRE_FALSE(is_shareable_v<create_map>);
+    STATIC_REQUIRE_FALSE(is_shareable_v<flake_id_new_batch>);
+    STATIC_REQUIRE_FALSE(is_shareable_v<send_schema>);
+    STATIC_REQUIRE_FALSE(is_shareable_v<create_cp_group>);
+}
+
+TEST_CASE("identical reads in flight share one request", "[map]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::map_options options;
+
+    options.share_reads = true;
+
+    hz_client::map map {conn, "map", options};
+
+    int completed {0};
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                map.async_get(
+                    i % 2,
+                    [&](const error_code& err, std::optional<hz_client::message::data>)
+                    {
+                        REQUIRE_FALSE(err);
+
+                        if (++completed == 100)
+                            conn.close();
+                    }
+                );
+            }
+        }
+    );
+
+    REQUIRE(completed == 100);
+    REQUIRE(member.requests() == 1 + 2);
+}
+
+TEST_CASE("entry processors run on a key, on keys and on entries", "[map]")
+{
+    using hz_client::message::from_data;
+
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+    hz_client::map          map {conn, "map"};
+
+    hz_client::message::data processor {std::string {"increment"}};
+
+    auto predicate = hz_client::message::to_data(hz_client::sql_predicate {"age > 42"});
+    int  completed {0};
+
+    auto complete = [&]
+    {
+        if (++completed == 4)
+            conn.close();
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            map.async_execute_on_key(
+                7,
+                processor,
+                [&](const error_code& err, std::optional<hz_client::message::data> result)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(result);
+                    REQUIRE(from_data<int>(*result) == 7);
+
+                    complete();
+                }
+            );
+
+            map.async_execute_on_keys(
+                {1, 2, 3},
+                processor,
+                [&](const error_code& err, std::vector<std::pair<hz_client::message::data, hz_client::message::data>> results)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(results.size() == 3);
+
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        REQUIRE(from_data<int>(results[i].first) == i + 1);
+                        REQUIRE(from_data<std::string>(results[i].second) == "increment");
+                    }
+
+                    complete();
+                }
+            );
+
+            map.async_execute_on_entries(
+                processor,
+                std::nullopt,
+                [&](const error_code& err, std::vector<std::pair<hz_client::message::data, hz_client::message::data>> results)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(results.size() == stand_in_member::MAP_ENTRIES);
+                    REQUIRE(from_data<std::string>(results.back().second) == "increment");
+
+                    complete();
+                }
+            );
+
+            map.async_execute_on_entries(
+                processor,
+                predicate,
+                [&](const error_code& err, std::vector<std::pair<hz_client::message::data, hz_client::message::data>> results)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(results.size() == stand_in_member::MAP_ENTRIES);
+                    REQUIRE(results.front().second.type_id == predicate.type_id);
+                    REQUIRE(results.front().second.payload == predicate.payload);
+
+                    complete();
+                }
+            );
+        }
+    );
+
+    REQUIRE(completed == 4);
+}
+
+TEST_CASE("predicate queries send their predicate and decode their results", "[query]")
+{
+    using hz_client::message::from_data;
+
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+    hz_client::map          map {conn, "map"};
+
+    auto predicate = hz_client::message::to_data(
+        hz_client::and_predicate {{
+            hz_client::message::to_data(hz_client::equal_predicate {"age", 42}),
+            hz_client::message::to_data(hz_client::like_predicate {"name", "a%"})
+        }}
+    );
+
+    int completed {0};
+
+    auto complete = [&]
+    {
+        if (++completed == 5)
+            conn.close();
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            map.async_key_set(
+                predicate,
+                [&](const error_code& err, std::vector<hz_client::message::data> keys)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(keys.size() == stand_in_member::MAP_ENTRIES);
+                    REQUIRE(from_data<int>(keys.back()) == stand_in_member::MAP_ENTRIES - 1);
+
+                    complete();
+                }
+            );
+
+            map.async_values(
+                predicate,
+                [&](const error_code& err, std::vector<hz_client::message::data> values)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(values.size() == stand_in_member::MAP_ENTRIES);
+                    REQUIRE(from_data<int>(values[21]) == 42);
+
+                    complete();
+                }
+            );
+
+            map.async_entry_set(
+                predicate,
+                [&](const error_code& err, std::vector<std::pair<hz_client::message::data, hz_client::message::data>> entries)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(entries.size() == stand_in_member::MAP_ENTRIES);
+
+                    for (auto& [key, value] : entries)
+                        REQUIRE(2 * *from_data<int>(key) == from_data<int>(value));
+
+                    complete();
+                }
+            );
+
+            map.async_project(
+                hz_client::message::data {std::string {"key"}},
+                predicate,
+                [&](const error_code& err, std::vector<std::optional<hz_client::message::data>> results)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(results.size() == stand_in_member::MAP_ENTRIES);
+                    REQUIRE(results.front());
+                    REQUIRE(from_data<int>(*results.front()) == 0);
+
+                    complete();
+                }
+            );
+
+            map.async_aggregate(
+                hz_client::message::data {std::string {"count"}},
+                std::nullopt,
+                [&](const error_code& err, std::optional<hz_client::message::data> result)
+                {
+                    REQUIRE_FALSE(err);
+                    REQUIRE(result);
+                    REQUIRE(from_data<int>(*result) == stand_in_member::MAP_ENTRIES);
+
+                    complete();
+                }
+            );
+        }
+    );
+
+    auto received = member.last_predicate();
+
+    REQUIRE(completed == 5);
+    REQUIRE(received.type_id == predicate.type_id);
+    REQUIRE(received.payload == predicate.payload);
+}
+
+TEST_CASE("paged queries stream every entry page by page", "[query]")
+{
+    using hz_client::message::from_data;
+    using entry_query = hz_client::paged_query<hz_client::message::iteration_type::entry>;
+
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    auto predicate = hz_client::message::to_data(hz_client::sql_predicate {"age > 42"});
+
+    std::vector<int>         keys;
+    std::vector<std::size_t> page_sizes;
+    bool                     initiating {false};
+
+    std::unique_ptr<entry_query>     query;
+    std::function<void()>            next;
+
+    next = [&]
+    {
+        initiating = true;
+
+        query->async_next(
+            [&](const error_code& err, entry_query::page_type page)
+            {
+                REQUIRE_FALSE(err);
+                REQUIRE_FALSE(initiating);
+
+                page_sizes.push_back(page.size());
+
+                page.for_each(
+                    [&](hz_client::message::data key, hz_client::message::data value)
+                    {
+                        keys.push_back(*from_data<int>(key));
+
+                        REQUIRE(from_data<int>(value) == 2 * keys.back());
+                    }
+                );
+
+                if (page.empty())
+                    return conn.close();
+
+                next();
+            }
+        );
+
+        initiating = false;
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            query = std::make_unique<entry_query>(conn, "map", 100, predicate);
+
+            next();
+        }
+    );
+
+    auto received = member.last_predicate();
+
+    REQUIRE(page_sizes == std::vector<std::size_t> {100, 100, 50, 0});
+    REQUIRE(keys.size() == stand_in_member::MAP_ENTRIES);
+    REQUIRE(std::is_sorted(begin(keys), end(keys)));
+    REQUIRE(keys.back() == stand_in_member::MAP_ENTRIES - 1);
+    REQUIRE(received.payload == predicate.payload);
+}
+
+TEST_CASE("map scans visit every entry once, partition by partition", "[scan]")
+{
+    using hz_client::message::from_data;
+    using entry_scan = hz_client::map_scan<hz_client::message::iteration_type::entry>;
+
+    stand_in_member         member {7};
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    std::vector<int>      keys;
+    std::size_t           batches {0};
+    bool                  initiating {false};
+    std::function<void()> next;
+
+    std::unique_ptr<entry_scan> scan;
+
+    next = [&]
+    {
+        initiating = true;
+
+        scan->async_next(
+            [&](const error_code& err, entry_scan::batch_type batch)
+            {
+                REQUIRE_FALSE(err);
+                REQUIRE_FALSE(initiating);
+
+                if (batch.items.empty())
+                    return conn.close();
+
+                REQUIRE(batch.items.size() <= 10);
+
+                ++batches;
+
+                for (auto& [key, value] : batch.items)
+                {
+                    keys.push_back(*from_data<int>(key));
+
+                    REQUIRE(keys.back() % 7 == batch.partition_id);
+                    REQUIRE(from_data<int>(value) == 2 * keys.back());
+                }
+
+                next();
+            }
+        );
+
+        initiating = false;
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            scan = std::make_unique<entry_scan>(conn, "map", hz_client::map_scan_options {10, 3});
+
+            next();
+        }
+    );
+
+    std::sort(begin(keys), end(keys));
+
+    REQUIRE(keys.size() == stand_in_member::MAP_ENTRIES);
+    REQUIRE(std::adjacent_find(begin(keys), end(keys)) == end(keys));
+    REQUIRE(batches >= stand_in_member::MAP_ENTRIES / 10);
+}
+
+TEST_CASE("cluster map scans fetch each partition from its owner", "[scan][cluster]")
+{
+    using hz_client::message::from_data;
+    using entry_scan = hz_client::map_scan<hz_client::message::iteration_type::entry>;
+
+    stand_in_member         first {7};
+    stand_in_member         second {7};
+    boost::asio::io_context ctx;
+
+    // Whichever of them is asked, the even partitions are on the first one
+    // and the odd ones on the second.
+    first.share_partitions_with(second);
+    second.share_partitions_with(first);
+
+    hz_client::cluster_options options;
+
+    options.members     = {first.endpoint(), second.endpoint()};
+    options.credentials = credentials();
+
+    hz_client::cluster cluster {ctx, std::move(options)};
+
+    std::vector<int>      keys;
+    std::function<void()> next;
+
+    std::unique_ptr<entry_scan> scan;
+
+    next = [&]
+    {
+        scan->async_next(
+            [&](const error_code& err, entry_scan::batch_type batch)
+            {
+                REQUIRE_FALSE(err);
+
+                if (batch.items.empty())
+                    return cluster.close();
+
+                for (auto& [key, value] : batch.items)
+                {
+                    keys.push_back(*from_data<int>(key));
+
+                    REQUIRE(keys.back() % 7 == batch.partition_id);
+                }
+
+                next();
+            }
+        );
+    };
+
+    error_code result {hz_client::error::not_connected};
+
+    cluster.async_start(
+        [&](const error_code& err)
+        {
+            result = err;
+
+            if (err)
+                return cluster.close();
+
+            scan = std::make_unique<entry_scan>(cluster, "map", hz_client::map_scan_options {10, 3});
+
+            next();
+        }
+    );
+
+    ctx.run();
+
+    REQUIRE_FALSE(result);
+
+    std::sort(begin(keys), end(keys));
+
+    REQUIRE(keys.size() == stand_in_member::MAP_ENTRIES);
+    REQUIRE(std::adjacent_find(begin(keys), end(keys)) == end(keys));
+
+    // Past its authentication, each of them served at least one fetch for
+    // every partition it owns.
+    REQUIRE(first.requests() >= 1 + 4);
+    REQUIRE(second.requests() >= 1 + 3);
+}
+
+TEST_CASE("a captured session replays to the same responses", "[capture]")
+{
+    auto path = std::filesystem::temp_directory_path() / "connection-test.hzcap";
+
+    // Records an entry processor, a query and a get.
+    {
+        hz_client::capture_writer capture {path.string()};
+
+        stand_in_member         member;
+        boost::asio::io_context ctx;
+        hz_client::connection   conn {ctx};
+        hz_client::map          map {conn, "map"};
+
+        conn.set_capture(&capture);
+
+        int completed {0};
+
+        auto complete = [&](const error_code& err, auto&&...)
+        {
+            REQUIRE_FALSE(err);
+
+            if (++completed == 3)
+                conn.close();
+        };
+
+        with_session(
+            ctx,
+            conn,
+            member,
+            [&]
+            {
+                map.async_execute_on_key(7, hz_client::message::data {std::string {"increment"}}, complete);
+                map.async_key_set(hz_client::message::to_data(hz_client::sql_predicate {"age > 42"}), complete);
+                map.async_get(42, complete);
+            }
+        );
+
+        REQUIRE(completed == 3);
+        REQUIRE(capture.dropped() == 0);
+    }
+
+    // Responses with their correlation id left out, by that of their
+    // request, authentications aside.
+    auto without_correlation_id = [](std::vector<char> message)
+    {
+        std::fill_n(message.begin() + 10, sizeof(std::uint64_t), 0);
+
+        return message;
+    };
+
+    std::vector<std::vector<char>>                 requests;
+    std::map<std::uint64_t, std::vector<char>>     responses;
+
+    {
+        hz_client::capture_reader reader {path.string()};
+        hz_client::capture_record record;
+
+        while (reader.next(record))
+        {
+            std::int32_t type;
+
+            std::memcpy(&type, record.message.data() + 6, sizeof(type));
+
+            if (record.direction == hz_client::capture_direction::incoming)
+                responses[hz_client::message::read_correlation_id(record.message)] = without_correlation_id(record.message);
+            else if (type != stand_in_member::AUTHENTICATION_TYPE)
+                requests.push_back(record.message);
+        }
+    }
+
+    std::filesystem::remove(path);
+
+    REQUIRE(requests.size() == 3);
+
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    std::size_t replayed {0};
+
+    hz_client::pipeline<hz_client::message::raw_message> replay {
+        conn,
+        2,
+        [&](std::size_t index, const error_code& err, std::vector<char> response)
+        {
+            REQUIRE_FALSE(err);
+
+            auto original = responses.find(hz_client::message::read_correlation_id(requests[index]));
+
+            REQUIRE(original != responses.end());
+            REQUIRE(without_correlation_id(response) == original->second);
+
+            if (++replayed == requests.size())
+                conn.close();
+        }
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            for (const auto& x : requests)
+                replay.add({{}, {x}});
+        }
+    );
+
+    REQUIRE(replayed == requests.size());
+}
+
+TEST_CASE("ringbuffer consumer hands out batches in sequence order", "[ringbuffer]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::ringbuffer_consumer_options options;
+
+    options.start_sequence  = 5;
+    options.batch_size      = 64;
+    options.reads_in_flight = 4;
+
+    hz_client::ringbuffer_consumer consumer {conn, "events", options};
+
+    std::vector<hz_client::message::data> items;
+    std::vector<int>                      received;
+
+    std::function<void()> next = [&]
+    {
+        consumer.async_next(
+            items,
+            [&](const error_code& err)
+            {
+                REQUIRE_FALSE(err);
+
+                for (const auto& item : items)
+                    received.push_back(*hz_client::message::from_data<int>(item));
+
+                if (received.size() < 1000)
+                    next();
+                else
+                    conn.close();
+            }
+        );
+    };
+
+    with_session(ctx, conn, member, next);
+
+    REQUIRE(received.size() == 1024);
+    REQUIRE(consumer.sequence() == 5 + 1024);
+
+    for (std::size_t i = 0; i < received.size(); ++i)
+        REQUIRE(received[i] == int(5 + i));
+}
+
+TEST_CASE("filtered ringbuffer reads move past their window", "[ringbuffer]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::ringbuffer_consumer_options options;
+
+    options.start_sequence  = 5;
+    options.batch_size      = 64;
+    options.reads_in_flight = 4;
+    options.filter          = hz_client::message::data {"even"};
+
+    hz_client::ringbuffer_consumer consumer {conn, "events", options};
+
+    std::vector<hz_client::message::data> items;
+    std::vector<int>                      received;
+
+    std::function<void()> next = [&]
+    {
+        consumer.async_next(
+            items,
+            [&](const error_code& err)
+            {
+                REQUIRE_FALSE(err);
+
+                for (const auto& item : items)
+                    received.push_back(*hz_client::message::from_data<int>(item));
+
+                if (received.size() < 500)
+                    next();
+                else
+                    conn.close();
+            }
+        );
+    };
+
+    with_session(ctx, conn, member, next);
+
+    // Every read covers twice the sequences of its items, none of which is
+    // read twice.
+    REQUIRE(received.size() == 512);
+    REQUIRE(consumer.sequence() == 6 + 2 * 511 + 1);
+    REQUIRE(member.requests() == 1 + 8);
+
+    for (std::size_t i = 0; i < received.size(); ++i)
+        REQUIRE(received[i] == int(6 + 2 * i));
+}
+
+TEST_CASE("queue consumer polls while the queue is empty", "[queue]")
+{
+    using namespace std::chrono_literals;
+
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::queue_consumer_options options;
+
+    options.batch_size       = 64;
+    options.drains_in_flight = 2;
+    options.idle_wait        = 5ms;
+
+    hz_client::queue_consumer consumer {conn, "jobs", options};
+    boost::asio::steady_timer offer {ctx};
+
+    std::vector<hz_client::message::data> items;
+    std::vector<int>                      received;
+
+    member.offer(150);
+
+    std::function<void()> next = [&]
+    {
+        consumer.async_next(
+            items,
+            [&](const error_code& err)
+            {
+                REQUIRE_FALSE(err);
+                REQUIRE_FALSE(items.empty());
+
+                for (const auto& item : items)
+                    received.push_back(*hz_client::message::from_data<int>(item));
+
+                if (received.size() == 200)
+                    return conn.close();
+
+                // The queue runs dry, and is only offered more once the
+                // consumer has been polling it for a while.
+                if (received.size() == 150)
+                {
+                    offer.expires_after(50ms);
+                    offer.async_wait([&](const error_code&) { member.offer(50); });
+                }
+
+                next();
+            }
+        );
+    };
+
+    with_session(ctx, conn, member, next);
+
+    REQUIRE(received.size() == 200);
+
+    for (std::size_t i = 0; i < received.size(); ++i)
+        REQUIRE(received[i] == int(i));
+
+    // Polled every `idle_wait` at most, rather than drained back to back.
+    REQUIRE(member.requests() > 1 + 4 + 2);
+    REQUIRE(member.requests() < 1 + 4 + 2 * (50 / 5 + 4));
+}
+
+TEST_CASE("flake ids come from prefetched batches", "[flake_id]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::flake_id_options options;
+
+    options.prefetch_count = 100;
+
+    hz_client::flake_id_generator generator {conn, "ids", options};
+
+    std::vector<std::int64_t> ids;
+
+    std::function<void()> next = [&]
+    {
+        generator.async_new_id(
+            [&](const error_code& err, std::int64_t id)
+            {
+                REQUIRE_FALSE(err);
+
+                ids.push_back(id);
+
+                if (ids.size() < 1000)
+                    next();
+                else
+                    conn.close();
+            }
+        );
+    };
+
+    with_session(ctx, conn, member, next);
+
+    REQUIRE(ids.size() == 1000);
+
+    for (std::size_t i = 0; i < ids.size(); ++i)
+        REQUIRE(ids[i] == std::int64_t(i));
+
+    // Ten batches handed out, and the reserve asked for when the last one
+    // was taken into use if it got out before the connection was closed.
+    REQUIRE(member.requests() >= 1 + 10);
+    REQUIRE(member.requests() <= 1 + 10 + 1);
+}
+
+TEST_CASE("compact schemas are sent once, before the first value", "[compact]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::compact_schemas schemas;
+    hz_client::map_options     options;
+
+    options.schemas = &schemas;
+
+    hz_client::map map {conn, "orders", options};
+
+    // Two-byte offsets, for data of 255 bytes or more.
+    order sent {42, 3, true, false, 9.5, std::string(300, 's'), std::nullopt};
+    order received;
+
+    auto value = schemas.to_data(sent);
+
+    REQUIRE_FALSE(hz_client::message::from_compact_data(value, received));
+    REQUIRE(received.id == sent.id);
+    REQUIRE(received.quantity == sent.quantity);
+    REQUIRE(received.paid);
+    REQUIRE_FALSE(received.gift);
+    REQUIRE(received.price == sent.price);
+    REQUIRE(received.sku == sent.sku);
+    REQUIRE_FALSE(received.note);
+
+    const auto& schema = hz_client::message::schema_of<order>();
+
+    // Two longs and an int, then a byte of booleans.
+    REQUIRE(schema.fixed_size == 8 + 8 + 4 + 1);
+    REQUIRE(schema.variable_count == 2);
+
+    int completed {0};
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            for (int i = 0; i < 10; ++i)
+            {
+                map.async_put(
+                    i,
+                    schemas.to_data(order {i, i}),
+                    [&](const error_code& err, std::optional<hz_client::message::data>)
+                    {
+                        REQUIRE_FALSE(err);
+
+                        if (++completed == 10)
+                            conn.close();
+                    }
+                );
+            }
+        }
+    );
+
+    REQUIRE(completed == 10);
+    REQUIRE_FALSE(schemas.has_unpublished());
+    REQUIRE(member.requests() == 1 + 1 + 10);
+}
+
+TEST_CASE("submitted invocations complete on the completion executor", "[connection]")
+{
+    stand_in_member           member;
+    boost::asio::io_context   ctx;
+    boost::asio::thread_pool  pool {1};
+    hz_client::connection     conn {ctx};
+    std::atomic<int>          completed {0};
+    std::atomic<bool>         failed {false};
+    std::atomic<bool>         on_io_thread {false};
+    std::thread::id           io_thread;
+
+    conn.set_completion_executor(pool.get_executor());
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            io_thread = std::this_thread::get_id();
+
+            for (int i = 0; i < 100; ++i)
+            {
+                hz_client::message::request<hz_client::message::map_get> req;
+
+                req.entity = {"map", i};
+
+                conn.submit(
+                    std::move(req),
+                    // Catch2 assertions are not to be made off the main
+                    // thread, the outcome is checked once the pool is done.
+                    [&](const error_code& err, std::vector<char>)
+                    {
+                        if (err)
+                            failed = true;
+
+                        if (std::this_thread::get_id() == io_thread)
+                            on_io_thread = true;
+
+                        if (++completed == 100)
+                            boost::asio::post(ctx, [&] { conn.close(); });
+                    }
+                );
+            }
+        }
+    );
+
+    pool.join();
+
+    REQUIRE(completed == 100);
+    REQUIRE_FALSE(failed);
+    REQUIRE_FALSE(on_io_thread);
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    REQUIRE(conn.counters().offloaded_completions == 100);
+    REQUIRE(conn.counters().completion_wakeups >= 1);
+    REQUIRE(conn.counters().completion_wakeups <= 100);
+#endif
+}
+
+TEST_CASE("submissions to a full queue fail through the io_context", "[connection]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx, {}, 4};
+
+    int  succeeded {0};
+    int  rejected {0};
+    bool initiating {false};
+
+    auto complete = [&]
+    {
+        if (succeeded + rejected == 8)
+            conn.close();
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            // Nothing is drained before this returns, so half of them find
+            // the queue full.
+            for (int i = 0; i < 8; ++i)
+            {
+                hz_client::message::request<hz_client::message::map_get> req;
+
+                req.entity = {"map", i};
+
+                initiating = true;
+
+                conn.submit(
+                    std::move(req),
+                    [&](const error_code& err, std::vector<char>)
+                    {
+                        REQUIRE_FALSE(initiating);
+
+                        if (err == hz_client::error::submission_queue_full)
+                            ++rejected;
+                        else if (!err)
+                            ++succeeded;
+
+                        complete();
+                    }
+                );
+
+                initiating = false;
+            }
+        }
+    );
+
+    REQUIRE(succeeded == 4);
+    REQUIRE(rejected == 4);
+    REQUIRE(member.requests() == 1 + 4);
+}
+
+TEST_CASE("submissions from several threads all complete", "[connection]")
+{
+    static constexpr int PRODUCERS = 4;
+    static constexpr int EACH      = 250;
+
+    stand_in_member          member;
+    boost::asio::io_context  ctx;
+    hz_client::connection    conn {ctx};
+    std::vector<std::thread> producers;
+    std::atomic<bool>        failed {false};
+    int                      completed {0};
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            for (int p = 0; p < PRODUCERS; ++p)
+            {
+                producers.emplace_back(
+                    [&, p]
+                    {
+                        for (int i = 0; i < EACH; ++i)
+                        {
+                            hz_client::message::request<hz_client::message::map_get> req;
+
+                            req.entity = {"map", p * EACH + i};
+
+                            // Completed on the io_context's thread.
+                            conn.submit(
+                                std::move(req),
+                                [&](const error_code& err, std::vector<char>)
+                                {
+                                    if (err)
+                                        failed = true;
+
+                                    if (++completed == PRODUCERS * EACH)
+                                        conn.close();
+                                }
+                            );
+                        }
+                    }
+                );
+            }
+        }
+    );
+
+    for (auto& t : producers)
+        t.join();
+
+    REQUIRE_FALSE(failed);
+    REQUIRE(completed == PRODUCERS * EACH);
+    REQUIRE(member.requests() == 1 + PRODUCERS * EACH);
+}
+
+TEST_CASE("large messages are encoded off the io thread", "[connection]")
+{
+    stand_in_member          member;
+    boost::asio::io_context  ctx;
+    boost::asio::thread_pool pool {1};
+    hz_client::connection    conn {ctx};
+    hz_client::map           map {conn, "map"};
+
+    conn.set_serialization_executor(pool.get_executor(), 1024);
+
+    std::vector<int> completed;
+
+    auto done = [&](int i)
+    {
+        return [&, i](const error_code& err, std::optional<hz_client::message::data>)
+        {
+            REQUIRE_FALSE(err);
+
+            completed.push_back(i);
+
+            if (completed.size() == 11)
+                conn.close();
+        };
+    };
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            hz_client::message::data large {
+                hz_client::message::data::CONSTANT_TYPE_STRING,
+                std::vector<char>(1 << 20, 'x')
+            };
+
+            // The small ones are held until the large one is encoded, so
+            // that they go out after it.
+            map.async_put(0, std::move(large), done(0));
+
+            for (int i = 1; i < 11; ++i)
+                map.async_get(i, done(i));
+        }
+    );
+
+    pool.join();
+
+    REQUIRE(completed.size() == 11);
+    REQUIRE(std::is_sorted(completed.begin(), completed.end()));
+    REQUIRE(member.requests() == 1 + 11);
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    REQUIRE(conn.counters().detached_serializations == 1);
+#endif
+}
+
+TEST_CASE("messages ahead of one being encoded are not held back by it", "[connection]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    boost::asio::io_context serializer;
+    hz_client::connection   conn {ctx};
+    hz_client::map          map {conn, "map"};
+
+    // Nothing is encoded until the message ahead is answered.
+    conn.set_serialization_executor(serializer.get_executor(), 1024);
+
+    std::vector<int> completed;
+    std::thread      encoding;
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            hz_client::message::data large {
+                hz_client::message::data::CONSTANT_TYPE_STRING,
+                std::vector<char>(1 << 20, 'x')
+            };
+
+            conn.hold_writes();
+
+            map.async_get(
+                1,
+                [&](const error_code& err, std::optional<hz_client::message::data>)
+                {
+                    REQUIRE_FALSE(err);
+
+                    completed.push_back(1);
+
+                    encoding = std::thread {[&] { serializer.run(); }};
+                }
+            );
+            map.async_put(
+                0,
+                std::move(large),
+                [&](const error_code& err, std::optional<hz_client::message::data>)
+                {
+                    REQUIRE_FALSE(err);
+
+                    completed.push_back(0);
+                }
+            );
+            map.async_get(
+                2,
+                [&](const error_code& err, std::optional<hz_client::message::data>)
+                {
+                    REQUIRE_FALSE(err);
+
+                    completed.push_back(2);
+
+                    conn.close();
+                }
+            );
+
+            conn.release_writes();
+        }
+    );
+
+    if (encoding.joinable())
+        encoding.join();
+
+    REQUIRE(completed == std::vector<int> {1, 0, 2});
+    REQUIRE(member.requests() == 1 + 3);
+}
+
+TEST_CASE("skew profiler finds the hot key and its partition", "[profiler]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+    hz_client::map          map {conn, "map"};
+    hz_client::skew_profiler profiler {{.sample_every = 1, .top_keys = 4}};
+
+    conn.set_profiler(&profiler);
+
+    int completed {0};
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            // Key 7 is every other get, the rest are all different.
+            for (int i = 0; i < 100; ++i)
+            {
+                map.async_get(
+                    i % 2 ? 7 : 1000 + i,
+                    [&](const error_code& err, std::optional<hz_client::message::data>)
+                    {
+                        REQUIRE_FALSE(err);
+
+                        if (++completed == 100)
+                            conn.close();
+                    }
+                );
+            }
+        }
+    );
+
+    auto snapshot = profiler.snapshot();
+    auto hot      = hz_client::message::data {7};
+    auto hash     = hz_client::message::partition_hash(hot);
+    auto hottest  = hz_client::message::partition_id(hash, conn.partition_count());
+
+    REQUIRE(completed == 100);
+    REQUIRE(snapshot.hot_keys.size() == 4);
+    REQUIRE(snapshot.hot_keys[0].hash == hash);
+    REQUIRE(snapshot.hot_keys[0].key.payload == hot.payload);
+    REQUIRE(snapshot.hot_keys[0].count - snapshot.hot_keys[0].error <= 50);
+    REQUIRE(snapshot.hot_keys[0].count >= 50);
+
+    std::uint64_t requests {0};
+
+    for (auto& p : snapshot.partitions)
+    {
+        REQUIRE(p.responses == p.requests);
+        REQUIRE(p.max_latency >= p.mean_latency());
+
+        requests += p.requests;
+    }
+
+    REQUIRE(requests == 100);
+    REQUIRE(snapshot.partitions[hottest].requests >= 50);
+    REQUIRE(snapshot.requests_per_second(hottest) > 0);
+}
+
+TEST_CASE("skew profiler tells apart keys of the same hash", "[profiler]")
+{
+    hz_client::skew_profiler profiler {{.sample_every = 1, .top_keys = 2}};
+
+    // A collision, with the hash of neither.
+    for (int i = 0; i < 3; ++i)
+        profiler.record_key(hz_client::message::data {1}, 42);
+
+    profiler.record_key(hz_client::message::data {2}, 42);
+
+    auto snapshot = profiler.snapshot();
+
+    REQUIRE(snapshot.hot_keys.size() == 2);
+    REQUIRE(snapshot.hot_keys[0].key.payload == hz_client::message::data {1}.payload);
+    REQUIRE(snapshot.hot_keys[0].count == 3);
+    REQUIRE(snapshot.hot_keys[1].key.payload == hz_client::message::data {2}.payload);
+    REQUIRE(snapshot.hot_keys[1].count == 1);
+
+    // Taking over the slot of the least counted key of the two.
+    for (int i = 0; i < 3; ++i)
+        profiler.record_key(hz_client::message::data {3}, 42);
+
+    snapshot = profiler.snapshot();
+
+    REQUIRE(snapshot.hot_keys[0].key.payload == hz_client::message::data {3}.payload);
+    REQUIRE(snapshot.hot_keys[0].count == 4);
+    REQUIRE(snapshot.hot_keys[0].error == 1);
+    REQUIRE(snapshot.hot_keys[1].count == 3);
+}
+
+TEST_CASE("skew profiler samples periodic accesses evenly", "[profiler]")
+{
+    hz_client::skew_profiler profiler {{.sample_every = 8, .top_keys = 8}};
+
+    // Keys in turn with the period of the sampling, none hotter than the
+    // others.
+    for (int i = 0; i < 8000; ++i)
+        profiler.record_key(hz_client::message::data {i % 8}, i % 8);
+
+    auto snapshot = profiler.snapshot();
+
+    REQUIRE(snapshot.hot_keys.size() == 8);
+
+    for (auto& x : snapshot.hot_keys)
+    {
+        REQUIRE(x.error == 0);
+        REQUIRE(x.count > 60);
+        REQUIRE(x.count < 190);
+    }
+
+    int sampled {0};
+
+    for (int i = 0; i < 80000; ++i)
+        sampled += profiler.sample();
+
+    REQUIRE(sampled > 9000);
+    REQUIRE(sampled < 11000);
+}
+
+TEST_CASE("pn counter sends its increments as few adds", "[pn_counter]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::pn_counter_options options;
+
+    options.flush_interval   = std::chrono::seconds {10};
+    options.max_pending_adds = 100;
+
+    hz_client::pn_counter counter {conn, "counter", options};
+
+    std::int64_t value {0};
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            for (int i = 0; i < 1000; ++i)
+                counter.add(1);
+
+            counter.async_get(
+                [&](const error_code& err, std::int64_t)
+                {
+                    REQUIRE_FALSE(err);
+
+                    for (int i = 0; i < 5; ++i)
+                        counter.add(1);
+
+                    counter.async_get(
+                        [&](const error_code& err, std::int64_t x)
+                        {
+                            REQUIRE_FALSE(err);
+
+                            value = x;
+
+                            conn.close();
+                        }
+                    );
+                }
+            );
+        }
+    );
+
+    REQUIRE(value == 1005);
+    REQUIRE(member.pn_counter_adds() <= 12);
+
+    // Requests after the first one carry the timestamp of the replica.
+    REQUIRE(member.replica_timestamps_received() == 1);
+}
+
+TEST_CASE("pn counter stops sending once the connection is closed", "[pn_counter]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    hz_client::pn_counter_options options;
+
+    options.flush_interval = std::chrono::milliseconds {1};
+
+    hz_client::pn_counter counter {conn, "counter", options};
+
+    error_code first;
+    error_code second;
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            counter.add(5);
+
+            // Its add is still in the pending buffer when the connection
+            // is closed, along with the get waiting for the next one.
+            conn.hold_writes();
+
+            counter.async_get([&](const error_code& err, std::int64_t) { first = err; });
+            counter.async_get([&](const error_code& err, std::int64_t) { second = err; });
+
+            conn.close();
+
+            counter.add(1);
+        }
+    );
+
+    // The io_context ran out of work, nothing being sent over and over.
+    REQUIRE(first == hz_client::error::connection_closed);
+    REQUIRE(second == hz_client::error::connection_closed);
+    REQUIRE(member.pn_counter_adds() == 0);
+}
+
+TEST_CASE("pn counter sends again the delta of an add never written", "[pn_counter]")
+{
+    using namespace std::chrono_literals;
+
+    hz_client::reconnect_options reconnect;
+
+    reconnect.max_attempts = 0;
+
+    stand_in_member           member {271, 2};
+    boost::asio::io_context   ctx;
+    hz_client::connection     conn {ctx, reconnect};
+    hz_client::map            map {conn, "map"};
+    boost::asio::steady_timer check {ctx};
+
+    hz_client::pn_counter_options options;
+
+    options.flush_interval = 300ms;
+
+    hz_client::pn_counter counter {conn, "counter", options};
+
+    error_code first;
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            // The link goes down with the add still in the pending buffer.
+            member.drop_link_on(stand_in_member::MAP_GET_TYPE);
+            map.async_get(1, [](const error_code&, std::optional<hz_client::message::data>) {});
+
+            conn.hold_writes();
+
+            counter.add(5);
+            counter.async_get(
+                [&](const error_code& err, std::int64_t)
+                {
+                    first = err;
+
+                    conn.release_writes();
+                    conn.async_connect(
+                        member.endpoint(),
+                        [&](const error_code& err)
+                        {
+                            REQUIRE_FALSE(err);
+
+                            conn.async_authenticate(
+                                credentials(),
+                                [&](const error_code& err)
+                                {
+                                    REQUIRE_FALSE(err);
+
+                                    // Nothing else is added, the timer
+                                    // sends it.
+                                    check.expires_after(1s);
+                                    check.async_wait([&](const error_code&) { conn.close(); });
+                                }
+                            );
+                        }
+                    );
+                }
+            );
+        }
+    );
+
+    REQUIRE(first == hz_client::error::connection_lost);
+    REQUIRE(member.pn_counter_adds() == 1);
+    REQUIRE(counter.in_doubt() == 0);
+}
+
+TEST_CASE("pn counter accounts for the delta of an add lost once written", "[pn_counter]")
+{
+    hz_client::reconnect_options reconnect;
+
+    reconnect.max_attempts = 0;
+
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx, reconnect};
+    hz_client::pn_counter   counter {conn, "counter"};
+
+    error_code result;
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            member.drop_link_on(stand_in_member::PN_COUNTER_ADD_TYPE);
+
+            counter.add(5);
+            counter.async_get(
+                [&](const error_code& err, std::int64_t)
+                {
+                    result = err;
+
+                    conn.close();
+                }
+            );
+        }
+    );
+
+    REQUIRE(result == hz_client::error::connection_lost);
+    REQUIRE(counter.in_doubt() == 5);
+}
+
+TEST_CASE("atomic long resolves its group once", "[atomic_long]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+    hz_client::atomic_long  counter {conn, "counter"};
+
+    std::int64_t value {0};
+
+    with_session(
+        ctx,
+        conn,
+        member,
+        [&]
+        {
+            counter.async_add_and_get(5, [](const error_code& err, std::int64_t) { REQUIRE_FALSE(err); });
+            counter.async_add_and_get(
+                2,
+                [&](const error_code& err, std::int64_t)
+                {
+                    REQUIRE_FALSE(err);
+
+                    counter.async_get(
+                        [&](const error_code& err, std::int64_t x)
+                        {
+                            REQUIRE_FALSE(err);
+
+                            value = x;
+
+                            conn.close();
+                        }
+                    );
+                }
+            );
+        }
+    );
+
+    REQUIRE(value == 7);
+    REQUIRE(member.requests() == 1 + 1 + 3);
+}
+
+TEST_CASE("cluster starts once the partition table is loaded", "[cluster]")
+{
+    stand_in_member         first {7};
+    stand_in_member         second {7};
+    boost::asio::io_context ctx;
+
+    hz_client::cluster_options options;
+
+    options.members     = {first.endpoint(), second.endpoint()};
+    options.credentials = credentials();
+    options.proxies     = {{"a"}, {"b"}};
+
+    hz_client::cluster cluster {ctx, std::move(options)};
+
+    error_code result {hz_client::error::not_connected};
+
+    cluster.async_start(
+        [&](const error_code& err)
+        {
+            result = err;
+
+            cluster.close();
+        }
+    );
+
+    ctx.run();
+
+    REQUIRE_FALSE(result);
+    REQUIRE(cluster.partitions().owners.size() == 7);
+
+    // Either member may have been the first one, and so the owner of every
+    // partition and the one to create the proxies.
+    auto owner = cluster.partitions().owners[3];
+
+    REQUIRE((owner == first.uuid() || owner == second.uuid()));
+    REQUIRE(cluster.connection_for(3).member_uuid() == owner);
+    REQUIRE(first.requests() + second.requests() == 2 + 2);
+}
+
+TEST_CASE("cluster stripes partitions over the connections to their owner", "[cluster]")
+{
+    stand_in_member         first {7, 2};
+    stand_in_member         second {7, 2};
+    boost::asio::io_context ctx;
+
+    hz_client::cluster_options options;
+
+    options.members                = {first.endpoint(), second.endpoint()};
+    options.credentials            = credentials();
+    options.connections_per_member = 2;
+
+    hz_client::cluster cluster {ctx, std::move(options)};
+
+    error_code result {hz_client::error::not_connected};
+
+    cluster.async_start(
+        [&](const error_code& err)
+        {
+            result = err;
+
+            cluster.close();
+        }
+    );
+
+    ctx.run();
+
+    REQUIRE_FALSE(result);
+
+    auto owner = cluster.partitions().owners[3];
+
+    // Partitions of the same owner alternate between its two connections,
+    // each partition always going over the same one.
+    REQUIRE(cluster.connection_for(3).member_uuid() == owner);
+    REQUIRE(cluster.connection_for(4).member_uuid() == owner);
+    REQUIRE(&cluster.connection_for(3) != &cluster.connection_for(4));
+    REQUIRE(&cluster.connection_for(3) == &cluster.connection_for(5));
+
+    // Every connection authenticated, then the cluster view listener.
+    REQUIRE(first.requests() + second.requests() == 4 + 1);
+}
+
+TEST_CASE("cluster renews its cluster view listener after a reconnect", "[cluster]")
+{
+    using namespace std::chrono_literals;
+
+    stand_in_member         member {7, 2};
+    boost::asio::io_context ctx;
+
+    hz_client::cluster_options options;
+
+    options.members                   = {member.endpoint()};
+    options.credentials               = credentials();
+    options.reconnect.initial_backoff = 10ms;
+
+    hz_client::cluster cluster {ctx, std::move(options)};
+
+    error_code   result {hz_client::error::not_connected};
+    std::int32_t version {0};
+
+    cluster.async_start(
+        [&](const error_code& err)
+        {
+            if (err)
+            {
+                result = err;
+
+                return cluster.close();
+            }
+
+            member.drop_link_on(stand_in_member::MAP_GET_TYPE);
+
+            hz_client::message::request<hz_client::message::map_get> req;
+
+            req.entity = {"map", 42};
+
+            cluster.any_connection().invoke(
+                std::move(req),
+                [&](const error_code& err, std::vector<char>)
+                {
+                    result  = err;
+                    version = cluster.partitions().version;
+
+                    cluster.close();
+                }
+            );
+        }
+    );
+
+    ctx.run();
+
+    // The listener registered again on the new link, and was sent the view
+    // before the get was answered.
+    REQUIRE_FALSE(result);
+    REQUIRE(version == 2);
+}
+
+TEST_CASE("cluster routes backup acks to the invocation they are for", "[cluster]")
+{
+    using namespace std::chrono_literals;
+
+    stand_in_member         first {7};
+    stand_in_member         second {7};
+    boost::asio::io_context ctx;
+
+    // Whichever of them owns the partitions, their backups are on the
+    // other one.
+    first.ack_backups_through(second);
+    second.ack_backups_through(first);
+
+    hz_client::cluster_options options;
+
+    options.members            = {first.endpoint(), second.endpoint()};
+    options.credentials        = credentials();
+    options.backup_ack_timeout = 2s;
+
+    hz_client::cluster cluster {ctx, std::move(options)};
+
+    std::unique_ptr<hz_client::map> map;
+
+    error_code result {hz_client::error::not_connected};
+    int        completed {0};
+    auto       started = std::chrono::steady_clock::now();
+    auto       took    = std::chrono::steady_clock::duration {};
+
+    cluster.async_start(
+        [&](const error_code& err)
+        {
+            result = err;
+
+            if (err)
+                return cluster.close();
+
+            map     = std::make_unique<hz_client::map>(cluster.any_connection(), "map");
+            started = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < 10; ++i)
+            {
+                map->async_put(
+                    i,
+                    i,
+                    [&](const error_code& err, std::optional<hz_client::message::data>)
+                    {
+                        REQUIRE_FALSE(err);
+
+                        if (++completed < 10)
+                            return;
+
+                        took = std::chrono::steady_clock::now() - started;
+
+                        cluster.close();
+                    }
+                );
+            }
+        }
+    );
+
+    ctx.run();
+
+    REQUIRE_FALSE(result);
+    REQUIRE(completed == 10);
+
+    // Every put was acked over the other connection, none of them waited
+    // for its acks to time out.
+    REQUIRE(took < 1s);
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+    REQUIRE(cluster.any_connection().counters().backup_ack_timeouts == 0);
+#endif
+}
+
+#if defined(HZ_CLIENT_WITH_METRICS)
+
+// Upper bounds of what one steady state invocation may cost. They are meant
+// to be tightened as the hot path gets cheaper, never loosened silently.
+static inline constexpr double MAX_ALLOCATIONS_PER_GET      = 5.5;
+static inline constexpr double MAX_ALLOCATIONS_PER_GET_INTO = 3.5;
+static inline constexpr double MAX_BYTES_COPIED_PER_GET = 96;
+static inline constexpr double MAX_SOCKET_CALLS_PER_GET = 4;
+
+static inline constexpr std::int32_t MAP_GET_TYPE = 66048;
+
+TEST_CASE("steady state invocation cost", "[connection][metrics]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    static constexpr int N = 20000;
+
+    with_session(ctx, conn, member, [&] { run_gets(conn, 256, N); });
+
+    const auto& counters = conn.counters();
+    const auto& gets     = counters.by_type.at(MAP_GET_TYPE);
+
+    REQUIRE(gets.invocations == N);
+
+    auto allocations_per_get = double(gets.allocations) / N;
+    auto copied_per_get      = double(gets.bytes_copied) / N;
+    auto calls_per_get       = double(counters.read_calls + counters.write_calls) / N;
+
+    INFO("allocations per get: " << allocations_per_get);
+    INFO("bytes copied per get: " << copied_per_get);
+    INFO("socket calls per get: " << calls_per_get);
+    INFO("messages per write: " << counters.messages_per_write());
+    INFO("frames per read: " << counters.frames_per_read());
+
+    REQUIRE(allocations_per_get <= MAX_ALLOCATIONS_PER_GET);
+    REQUIRE(copied_per_get <= MAX_BYTES_COPIED_PER_GET);
+    REQUIRE(calls_per_get <= MAX_SOCKET_CALLS_PER_GET);
+}
+
+TEST_CASE("invoke_into steady state allocations", "[connection][metrics]")
+{
+    stand_in_member         member;
+    boost::asio::io_context ctx;
+    hz_client::connection   conn {ctx};
+
+    static constexpr int N = 20000;
+
+    hz_client::message::response<hz_client::message::map_get> res;
+
+    with_session(ctx, conn, member, [&] { run_gets_into(conn, res, N); });
+
+    const auto& gets = conn.counters().by_type.at(MAP_GET_TYPE);
+
+    auto allocations_per_get = double(gets.allocations) / N;
+
+    INFO("allocations per get: " << allocations_per_get);
+
+    REQUIRE(allocations_per_get <= MAX_ALLOCATIONS_PER_GET_INTO);
+}
+
+#endif
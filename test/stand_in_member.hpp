@@ -0,0 +1,919 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/endian/conversion.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/random_generator.hpp>
+
+#include <hz_client/message/data.hpp>
+#include <hz_client/message/frame_header.hpp>
+
+// Plays a member on a loopback port for a given number of client
+// connections, each one served on its own thread. It accepts
+// any credentials and answers every other request with an empty response,
+// i.e. an initial frame followed by a null frame. A cluster view listener
+// is sent a partition table with every partition owned by the member, and
+// a ringbuffer read is answered with as many items as it asks for at most,
+// each one the integer of its sequence, and a filter keeping the even
+// sequences only. A queue holds the integers offered to it, counting up
+// from zero, as drains take them. Flake id batches are consecutive,
+// the first one starting at zero. A backup-aware map put is told to have
+// one backup, acked to the local backup listener before the response for
+// even correlation ids and after it for odd ones, unless acks are dropped
+// or made to come from another member, over its own client connection.
+// A single PN counter and a single atomic long are kept, the counter being
+// its only replica, whose timestamp counts the adds. The link can be made
+// to drop on a request of a given type, authentications to go unanswered,
+// and responses to be held back for a while.
+//
+// Entry processors, predicate queries and scans run over a map of
+// `MAP_ENTRIES` integers, each key mapped to its double and owned by the
+// partition of the key modulo the partition count. Neither processors nor
+// predicates are evaluated: a processor on a key answers with the key, one
+// on several keys or entries with the processor, or the predicate if there
+// is one, as the result of every entry. Predicates match every entry, a
+// projection yields the keys and an aggregation their count.
+class stand_in_member
+{
+public:
+
+    static inline constexpr std::int32_t AUTHENTICATION_TYPE       = 256;
+    static inline constexpr std::int32_t BACKUP_LISTENER_TYPE      = 3840;
+    static inline constexpr std::int32_t BACKUP_EVENT_TYPE         = 3842;
+    static inline constexpr std::int32_t MAP_PUT_TYPE              = 65792;
+    static inline constexpr std::int32_t MAP_GET_TYPE              = 66048;
+    static inline constexpr std::int32_t CLUSTER_VIEW_LISTENER_TYPE = 768;
+    static inline constexpr std::int32_t PARTITIONS_VIEW_EVENT_TYPE = 771;
+    static inline constexpr std::int32_t RINGBUFFER_READ_MANY_TYPE  = 1509632;
+    static inline constexpr std::int32_t QUEUE_DRAIN_TO_TYPE        = 199168;
+    static inline constexpr std::int32_t FLAKE_ID_NEW_BATCH_TYPE    = 1835264;
+    static inline constexpr std::int32_t PN_COUNTER_GET_TYPE        = 1900800;
+    static inline constexpr std::int32_t PN_COUNTER_ADD_TYPE        = 1901056;
+    static inline constexpr std::int32_t CREATE_CP_GROUP_TYPE       = 1966336;
+    static inline constexpr std::int32_t ATOMIC_LONG_ADD_AND_GET_TYPE = 590592;
+    static inline constexpr std::int32_t ATOMIC_LONG_GET_TYPE       = 591104;
+    static inline constexpr std::int32_t EXECUTE_ON_KEY_TYPE        = 77312;
+    static inline constexpr std::int32_t EXECUTE_ON_KEYS_TYPE       = 78336;
+    static inline constexpr std::int32_t EXECUTE_ON_ALL_TYPE        = 77824;
+    static inline constexpr std::int32_t EXECUTE_WITH_PREDICATE_TYPE = 78080;
+    static inline constexpr std::int32_t KEY_SET_TYPE               = 75264;
+    static inline constexpr std::int32_t VALUES_TYPE                = 75520;
+    static inline constexpr std::int32_t ENTRY_SET_TYPE             = 75776;
+    static inline constexpr std::int32_t PROJECT_TYPE               = 80640;
+    static inline constexpr std::int32_t PROJECT_WITH_PREDICATE_TYPE = 80896;
+    static inline constexpr std::int32_t AGGREGATE_TYPE             = 80128;
+    static inline constexpr std::int32_t AGGREGATE_WITH_PREDICATE_TYPE = 80384;
+    static inline constexpr std::int32_t PAGED_KEYS_TYPE            = 78848;
+    static inline constexpr std::int32_t PAGED_VALUES_TYPE          = 79104;
+    static inline constexpr std::int32_t PAGED_ENTRIES_TYPE         = 79360;
+    static inline constexpr std::int32_t FETCH_KEYS_TYPE            = 79616;
+    static inline constexpr std::int32_t FETCH_ENTRIES_TYPE         = 79872;
+
+    static inline constexpr std::int32_t MAP_ENTRIES = 250;
+
+    explicit stand_in_member(std::int32_t partition_count = 271, std::size_t connections = 1)
+        :   m_acceptor {m_ctx, {boost::asio::ip::address_v4::loopback(), 0}}
+        ,   m_partition_count {partition_count}
+        ,   m_connections {connections}
+        ,   m_uuid {boost::uuids::random_generator()()}
+        ,   m_thread {[this] { serve(); }}
+    {}
+
+    // The client has to be disconnected by then.
+    ~stand_in_member()
+    {
+        boost::system::error_code ignored;
+
+        // Wakes the accepts up which no client connected to, with
+        // connections which are closed right away.
+        for (auto n = m_accepted.load(); n < m_connections; ++n)
+        {
+            boost::asio::ip::tcp::socket waker {m_ctx};
+
+            waker.connect(endpoint(), ignored);
+        }
+
+        m_thread.join();
+    }
+
+    boost::asio::ip::tcp::endpoint endpoint() const
+    {
+        return m_acceptor.local_endpoint();
+    }
+
+    std::uint64_t requests() const
+    {
+        return m_requests.load();
+    }
+
+    std::uint64_t pn_counter_adds() const
+    {
+        return m_pn_counter_adds.load();
+    }
+
+    // Of the last PN counter request.
+    std::size_t replica_timestamps_received() const
+    {
+        return m_replica_timestamps_received.load();
+    }
+
+    void drop_backup_acks()
+    {
+        m_ack_backups = false;
+    }
+
+    // Acks of backups are sent by `backup`, as the member holding them,
+    // over the client connection it accepted last.
+    void ack_backups_through(stand_in_member& backup)
+    {
+        m_backup_member = &backup;
+    }
+
+    // The views it sends leave the partitions with an odd id to `other`.
+    void share_partitions_with(const stand_in_member& other)
+    {
+        m_partner = &other;
+    }
+
+    // The next request of `type` closes its connection, the requests read
+    // along with it left unanswered.
+    void drop_link_on(std::int32_t type)
+    {
+        m_drop_on = type;
+    }
+
+    void ignore_authentications()
+    {
+        m_answer_authentications = false;
+    }
+
+    // Every batch of responses from now on is written `delay` after the
+    // requests were read.
+    void delay_responses(std::chrono::milliseconds delay)
+    {
+        m_response_delay = delay.count();
+    }
+
+    // Adds the next `count` integers to the queue.
+    void offer(std::int32_t count)
+    {
+        std::lock_guard<std::mutex> lock {m_mutex};
+
+        m_queue_tail += count;
+    }
+
+    // The last predicate a query or processor came with.
+    hz_client::message::data last_predicate() const
+    {
+        std::lock_guard<std::mutex> lock {m_mutex};
+
+        return m_last_predicate;
+    }
+
+    // As the client decodes it.
+    boost::uuids::uuid uuid() const
+    {
+        auto x = m_uuid;
+
+        std::reverse(std::begin(x.data), std::begin(x.data) + 8);
+        std::reverse(std::begin(x.data) + 8, std::end(x.data));
+
+        return x;
+    }
+
+private:
+
+    using frame_header = hz_client::message::frame_header;
+
+    struct frame_ref
+    {
+        std::size_t   content {0};
+        std::size_t   size {0};
+        std::uint16_t flags {0};
+    };
+
+    void serve()
+    {
+        std::vector<std::thread> threads;
+
+        for (std::size_t i = 0; i < m_connections; ++i)
+        {
+            boost::system::error_code err;
+
+            auto sck = m_acceptor.accept(err);
+
+            if (err)
+                break;
+
+            ++m_accepted;
+
+            threads.emplace_back(
+                [this, sck = std::move(sck)]() mutable
+                {
+                    {
+                        std::lock_guard<std::mutex> lock {m_write_mutex};
+
+                        m_client_socket = &sck;
+                    }
+
+                    serve(sck);
+
+                    std::lock_guard<std::mutex> lock {m_write_mutex};
+
+                    if (m_client_socket == &sck)
+                        m_client_socket = nullptr;
+                }
+            );
+        }
+
+        for (auto& t : threads)
+            t.join();
+    }
+
+    void serve(boost::asio::ip::tcp::socket& sck)
+    {
+        boost::system::error_code err;
+
+        char protocol[3];
+
+        boost::asio::read(sck, boost::asio::buffer(protocol), err);
+
+        std::vector<char> received;
+        std::vector<char> responses;
+        char              chunk[1 << 16];
+
+        while (!err)
+        {
+            auto n = sck.read_some(boost::asio::buffer(chunk), err);
+
+            received.insert(end(received), chunk, chunk + n);
+
+            std::size_t message_begin {0};
+            std::size_t pos {0};
+
+            while (received.size() - pos >= frame_header::HEADER_SIZE)
+            {
+                auto length = read<std::int32_t>(received, pos);
+                auto flags  = read<std::uint16_t>(received, pos + 4);
+
+                if (received.size() - pos < std::size_t(length))
+                    break;
+
+                pos += length;
+
+                if (!(flags & frame_header::IS_FINAL_FLAG))
+                    continue;
+
+                auto type = read<std::int32_t>(received, message_begin + 6);
+                auto drop = type;
+
+                if (m_drop_on.compare_exchange_strong(drop, 0))
+                {
+                    sck.close(err);
+
+                    return;
+                }
+
+                if (type != AUTHENTICATION_TYPE || m_answer_authentications)
+                    respond(received, message_begin, responses);
+
+                ++m_requests;
+                message_begin = pos;
+            }
+
+            received.erase(received.begin(), received.begin() + message_begin);
+
+            if (!responses.empty())
+            {
+                if (auto delay = m_response_delay.load())
+                    std::this_thread::sleep_for(std::chrono::milliseconds {delay});
+
+                std::lock_guard<std::mutex> lock {m_write_mutex};
+
+                boost::asio::write(sck, boost::asio::buffer(responses), err);
+            }
+
+            responses.clear();
+        }
+    }
+
+    void respond(
+        const std::vector<char>& request,
+        std::size_t offset,
+        std::vector<char>& out
+    )
+    {
+        auto type           = read<std::int32_t>(request, offset + 6);
+        auto flags          = read<std::uint16_t>(request, offset + 4);
+        auto correlation_id = read<std::uint64_t>(request, offset + 10);
+
+        bool backed_up = type == MAP_PUT_TYPE && (flags & frame_header::BACKUP_AWARE_FLAG);
+        bool ack       = backed_up && m_ack_backups;
+        auto backup    = m_backup_member.load();
+
+        if (ack && backup)
+        {
+            backup->send_backup_ack(correlation_id);
+
+            ack = false;
+        }
+
+        if (type == BACKUP_LISTENER_TYPE)
+            m_backup_listener_id = correlation_id;
+
+        if (ack && correlation_id % 2 == 0)
+            append_backup_ack(correlation_id, out);
+
+        std::vector<char> content;
+
+        // type, correlation id, backup acks
+        append(content, type + 1);
+        append(content, correlation_id);
+        append(content, std::uint8_t(backed_up ? 1 : 0));
+
+        if (type == AUTHENTICATION_TYPE)
+        {
+            // status, member uuid, serialization version, partition count,
+            // cluster id, failover support
+            append(content, std::uint8_t(0));
+            append(content, std::uint8_t(0));
+            content.insert(end(content), std::begin(m_uuid.data), std::end(m_uuid.data));
+            append(content, std::uint8_t(1));
+            append(content, m_partition_count);
+            append(content, std::uint8_t(1));
+            content.resize(content.size() + 16);
+            append(content, std::uint8_t(0));
+        }
+
+        if (type == FLAKE_ID_NEW_BATCH_TYPE)
+        {
+            auto count = read<std::int32_t>(request, offset + 22);
+
+            // base, increment, batch size
+            append(content, m_next_flake_id.fetch_add(count));
+            append(content, std::int64_t(1));
+            append(content, count);
+        }
+
+        if (type == PN_COUNTER_ADD_TYPE || type == PN_COUNTER_GET_TYPE)
+        {
+            if (type == PN_COUNTER_ADD_TYPE)
+            {
+                m_pn_counter += read<std::int64_t>(request, offset + 22);
+                ++m_pn_counter_adds;
+            }
+
+            // Past the initial frame and the name.
+            auto pos = offset + read<std::int32_t>(request, offset);
+
+            pos += read<std::int32_t>(request, pos);
+
+            m_replica_timestamps_received = (read<std::int32_t>(request, pos) - frame_header::HEADER_SIZE) / 25;
+
+            // value, replica count
+            append(content, m_pn_counter.load());
+            append(content, std::int32_t(1));
+
+            append(out, std::int32_t(frame_header::HEADER_SIZE + content.size()));
+            append(out, std::uint16_t(frame_header::UNFRAGMENTED_MESSAGE));
+            out.insert(end(out), begin(content), end(content));
+
+            // The timestamp of the only replica.
+            append(out, std::int32_t(frame_header::HEADER_SIZE + 25));
+            append(out, std::uint16_t(frame_header::IS_FINAL_FLAG));
+            append(out, std::uint8_t(0));
+            out.insert(end(out), std::begin(m_uuid.data), std::end(m_uuid.data));
+            append(out, std::int64_t(m_pn_counter_adds.load()));
+
+            return;
+        }
+
+        if (answers_from_map(type))
+        {
+            append(out, std::int32_t(frame_header::HEADER_SIZE + content.size()));
+            append(out, std::uint16_t(frame_header::UNFRAGMENTED_MESSAGE));
+            out.insert(end(out), begin(content), end(content));
+
+            return respond_from_map(type, request, offset, out);
+        }
+
+        if (type == ATOMIC_LONG_ADD_AND_GET_TYPE)
+            append(content, m_atomic_long += read<std::int64_t>(request, offset + 22));
+
+        if (type == ATOMIC_LONG_GET_TYPE)
+            append(content, m_atomic_long.load());
+
+        if (type == CREATE_CP_GROUP_TYPE)
+        {
+            append(out, std::int32_t(frame_header::HEADER_SIZE + content.size()));
+            append(out, std::uint16_t(frame_header::UNFRAGMENTED_MESSAGE));
+            out.insert(end(out), begin(content), end(content));
+
+            return append_default_group(out);
+        }
+
+        if (type == RINGBUFFER_READ_MANY_TYPE)
+        {
+            auto start = read<std::int64_t>(request, offset + 22);
+            auto count = read<std::int32_t>(request, offset + 34);
+
+            // The initial frame, the name, then the filter.
+            auto filtered = !(frames_of(request, offset)[2].flags & frame_header::IS_NULL_FLAG);
+            auto first    = filtered ? start + start % 2 : start;
+            auto step     = filtered ? 2 : 1;
+            auto next     = first + (count - 1) * step + 1;
+
+            // read count, next sequence
+            append(content, std::int32_t(next - start));
+            append(content, next);
+
+            append(out, std::int32_t(frame_header::HEADER_SIZE + content.size()));
+            append(out, std::uint16_t(frame_header::UNFRAGMENTED_MESSAGE));
+            out.insert(end(out), begin(content), end(content));
+
+            return append_items(first, count, step, out);
+        }
+
+        if (type == QUEUE_DRAIN_TO_TYPE)
+        {
+            auto max_size = read<std::int32_t>(request, offset + 22);
+
+            std::int32_t first;
+            std::int32_t count;
+
+            {
+                std::lock_guard<std::mutex> lock {m_mutex};
+
+                first = m_queue_head;
+                count = std::min(max_size, m_queue_tail - m_queue_head);
+
+                m_queue_head += count;
+            }
+
+            append(out, std::int32_t(frame_header::HEADER_SIZE + content.size()));
+            append(out, std::uint16_t(frame_header::UNFRAGMENTED_MESSAGE));
+            out.insert(end(out), begin(content), end(content));
+
+            append_marker(frame_header::BEGIN_DATA_STRUCTURE_FLAG, out);
+
+            for (auto i = first; i < first + count; ++i)
+                append_integer(i, 0, out);
+
+            return append_marker(frame_header::END_DATA_STRUCTURE_FLAG | frame_header::IS_FINAL_FLAG, out);
+        }
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE + content.size()));
+        append(out, std::uint16_t(frame_header::UNFRAGMENTED_MESSAGE));
+        out.insert(end(out), begin(content), end(content));
+
+        auto last = type == AUTHENTICATION_TYPE ?
+                        frame_header::END_DATA_STRUCTURE_FLAG :
+                        frame_header::IS_NULL_FLAG;
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, std::uint16_t(last | frame_header::IS_FINAL_FLAG));
+
+        if (type == CLUSTER_VIEW_LISTENER_TYPE)
+            append_partitions_view(correlation_id, out);
+
+        if (ack && correlation_id % 2 == 1)
+            append_backup_ack(correlation_id, out);
+    }
+
+    static bool answers_from_map(std::int32_t type)
+    {
+        switch (type)
+        {
+            case EXECUTE_ON_KEY_TYPE:
+            case EXECUTE_ON_KEYS_TYPE:
+            case EXECUTE_ON_ALL_TYPE:
+            case EXECUTE_WITH_PREDICATE_TYPE:
+            case KEY_SET_TYPE:
+            case VALUES_TYPE:
+            case ENTRY_SET_TYPE:
+            case PROJECT_TYPE:
+            case PROJECT_WITH_PREDICATE_TYPE:
+            case AGGREGATE_TYPE:
+            case AGGREGATE_WITH_PREDICATE_TYPE:
+            case PAGED_KEYS_TYPE:
+            case PAGED_VALUES_TYPE:
+            case PAGED_ENTRIES_TYPE:
+            case FETCH_KEYS_TYPE:
+            case FETCH_ENTRIES_TYPE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Appends what follows the initial frame of the response.
+    void respond_from_map(
+        std::int32_t type,
+        const std::vector<char>& request,
+        std::size_t offset,
+        std::vector<char>& out
+    )
+    {
+        auto frames = frames_of(request, offset);
+
+        // The entry processor, then either the key, the keys or the
+        // predicate.
+        if (type == EXECUTE_ON_KEY_TYPE)
+            return append_frame(request, frames[3], frame_header::IS_FINAL_FLAG, out);
+
+        if (type == EXECUTE_ON_KEYS_TYPE)
+        {
+            append_marker(frame_header::BEGIN_DATA_STRUCTURE_FLAG, out);
+
+            for (auto i = 4; !(frames[i].flags & frame_header::END_DATA_STRUCTURE_FLAG); ++i)
+            {
+                append_frame(request, frames[i], 0, out);
+                append_frame(request, frames[2], 0, out);
+            }
+
+            return append_marker(frame_header::END_DATA_STRUCTURE_FLAG | frame_header::IS_FINAL_FLAG, out);
+        }
+
+        if (type == EXECUTE_ON_ALL_TYPE || type == EXECUTE_WITH_PREDICATE_TYPE)
+        {
+            auto& result = type == EXECUTE_WITH_PREDICATE_TYPE ? frames[3] : frames[2];
+
+            if (type == EXECUTE_WITH_PREDICATE_TYPE)
+                keep_predicate(request, frames[3]);
+
+            append_marker(frame_header::BEGIN_DATA_STRUCTURE_FLAG, out);
+
+            for (std::int32_t key = 0; key < MAP_ENTRIES; ++key)
+            {
+                append_integer(key, 0, out);
+                append_frame(request, result, 0, out);
+            }
+
+            return append_marker(frame_header::END_DATA_STRUCTURE_FLAG | frame_header::IS_FINAL_FLAG, out);
+        }
+
+        // The predicate follows the projection or the aggregator, if any.
+        if (type == KEY_SET_TYPE || type == VALUES_TYPE || type == ENTRY_SET_TYPE)
+            keep_predicate(request, frames[2]);
+
+        if (type == PROJECT_WITH_PREDICATE_TYPE || type == AGGREGATE_WITH_PREDICATE_TYPE)
+            keep_predicate(request, frames[3]);
+
+        if (type == AGGREGATE_TYPE || type == AGGREGATE_WITH_PREDICATE_TYPE)
+            return append_integer(MAP_ENTRIES, frame_header::IS_FINAL_FLAG, out);
+
+        if (type == KEY_SET_TYPE || type == PROJECT_TYPE || type == PROJECT_WITH_PREDICATE_TYPE)
+            return append_entries(0, MAP_ENTRIES, true, false, frame_header::IS_FINAL_FLAG, out);
+
+        if (type == VALUES_TYPE)
+            return append_entries(0, MAP_ENTRIES, false, true, frame_header::IS_FINAL_FLAG, out);
+
+        if (type == ENTRY_SET_TYPE)
+            return append_entries(0, MAP_ENTRIES, true, true, frame_header::IS_FINAL_FLAG, out);
+
+        if (type == FETCH_KEYS_TYPE || type == FETCH_ENTRIES_TYPE)
+            return append_scan_batch(type, request, offset, frames[2], out);
+
+        // The holder's initial frame carries the page size and the page,
+        // its predicate follows the anchor list.
+        auto page_size = read<std::int32_t>(request, frames[3].content);
+        auto page      = read<std::int32_t>(request, frames[3].content + 4);
+
+        std::size_t i = 7;
+
+        while (!(frames[i].flags & frame_header::END_DATA_STRUCTURE_FLAG))
+            ++i;
+
+        if (!(frames[i + 2].flags & frame_header::IS_NULL_FLAG))
+            keep_predicate(request, frames[i + 2]);
+
+        auto first = std::min(page * page_size, MAP_ENTRIES);
+        auto last  = std::min(first + page_size, MAP_ENTRIES);
+
+        append_entries(first, last, type != PAGED_VALUES_TYPE, type != PAGED_KEYS_TYPE, 0, out);
+
+        // The anchor list, with the last entry of the page.
+        append_marker(frame_header::BEGIN_DATA_STRUCTURE_FLAG, out);
+        append(out, std::int32_t(frame_header::HEADER_SIZE + 4));
+        append(out, std::uint16_t(0));
+        append(out, page);
+
+        append_marker(frame_header::BEGIN_DATA_STRUCTURE_FLAG, out);
+
+        if (last > first)
+        {
+            append_integer(last - 1, 0, out);
+            append_integer(2 * (last - 1), 0, out);
+        }
+
+        append_marker(frame_header::END_DATA_STRUCTURE_FLAG, out);
+        append_marker(frame_header::END_DATA_STRUCTURE_FLAG | frame_header::IS_FINAL_FLAG, out);
+    }
+
+    // The keys of the partition, in key order from the index of the
+    // request's iteration pointer on.
+    void append_scan_batch(
+        std::int32_t type,
+        const std::vector<char>& request,
+        std::size_t offset,
+        const frame_ref& pointers,
+        std::vector<char>& out
+    )
+    {
+        auto partition_id = read<std::int32_t>(request, offset + 18);
+        auto batch        = read<std::int32_t>(request, offset + 22);
+        auto index        = read<std::int32_t>(request, pointers.content);
+
+        if (index == std::numeric_limits<std::int32_t>::max())
+            index = 0;
+
+        std::vector<std::int32_t> keys;
+
+        for (auto key = partition_id; key < MAP_ENTRIES; key += m_partition_count)
+            keys.push_back(key);
+
+        auto first = std::min(std::size_t(index), keys.size());
+        auto last  = std::min(first + std::size_t(batch), keys.size());
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE + 8));
+        append(out, std::uint16_t(0));
+        append(out, last < keys.size() ? std::int32_t(last) : std::int32_t(-1));
+        append(out, std::int32_t(keys.size()));
+
+        append_marker(frame_header::BEGIN_DATA_STRUCTURE_FLAG, out);
+
+        for (auto i = first; i < last; ++i)
+        {
+            append_integer(keys[i], 0, out);
+
+            if (type == FETCH_ENTRIES_TYPE)
+                append_integer(2 * keys[i], 0, out);
+        }
+
+        append_marker(frame_header::END_DATA_STRUCTURE_FLAG | frame_header::IS_FINAL_FLAG, out);
+    }
+
+    // A list of the keys, the values or both of [first, last).
+    static void append_entries(
+        std::int32_t first,
+        std::int32_t last,
+        bool keys,
+        bool values,
+        std::uint16_t flags,
+        std::vector<char>& out
+    )
+    {
+        append_marker(frame_header::BEGIN_DATA_STRUCTURE_FLAG, out);
+
+        for (auto key = first; key < last; ++key)
+        {
+            if (keys)
+                append_integer(key, 0, out);
+
+            if (values)
+                append_integer(2 * key, 0, out);
+        }
+
+        append_marker(frame_header::END_DATA_STRUCTURE_FLAG | flags, out);
+    }
+
+    void keep_predicate(const std::vector<char>& request, const frame_ref& frame)
+    {
+        std::lock_guard<std::mutex> lock {m_mutex};
+
+        m_last_predicate.type_id = boost::endian::big_to_native(read<std::int32_t>(request, frame.content + 4));
+        m_last_predicate.payload.assign(
+            request.begin() + frame.content + hz_client::message::data::DATA_OFFSET,
+            request.begin() + frame.content + frame.size
+        );
+    }
+
+    static std::vector<frame_ref> frames_of(const std::vector<char>& message, std::size_t offset)
+    {
+        std::vector<frame_ref> frames;
+
+        for (;;)
+        {
+            auto length = read<std::int32_t>(message, offset);
+            auto flags  = read<std::uint16_t>(message, offset + 4);
+
+            frames.push_back({
+                offset + frame_header::HEADER_SIZE,
+                std::size_t(length) - frame_header::HEADER_SIZE,
+                flags
+            });
+
+            offset += length;
+
+            if (flags & frame_header::IS_FINAL_FLAG)
+                return frames;
+        }
+    }
+
+    static void append_frame(
+        const std::vector<char>& message,
+        const frame_ref& frame,
+        std::uint16_t flags,
+        std::vector<char>& out
+    )
+    {
+        append(out, std::int32_t(frame_header::HEADER_SIZE + frame.size));
+        append(out, flags);
+        out.insert(end(out), message.begin() + frame.content, message.begin() + frame.content + frame.size);
+    }
+
+    static void append_marker(std::uint16_t flags, std::vector<char>& out)
+    {
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, flags);
+    }
+
+    // Partition hash and type id of an integer, then the integer, all of
+    // them big endian.
+    static void append_integer(std::int32_t value, std::uint16_t flags, std::vector<char>& out)
+    {
+        append(out, std::int32_t(frame_header::HEADER_SIZE + 12));
+        append(out, flags);
+        append(out, std::int32_t(0));
+        append(out, boost::endian::native_to_big(std::int32_t(-7)));
+        append(out, boost::endian::native_to_big(value));
+    }
+
+    void send_backup_ack(std::uint64_t source)
+    {
+        std::vector<char> event;
+
+        append_backup_ack(source, event);
+
+        std::lock_guard<std::mutex> lock {m_write_mutex};
+
+        boost::system::error_code ignored;
+
+        if (m_client_socket)
+            boost::asio::write(*m_client_socket, boost::asio::buffer(event), ignored);
+    }
+
+    void append_backup_ack(std::uint64_t source, std::vector<char>& out)
+    {
+        // type, correlation id, partition id, source correlation id
+        append(out, std::int32_t(frame_header::HEADER_SIZE + 24));
+        append(out, std::uint16_t(
+            frame_header::UNFRAGMENTED_MESSAGE |
+            frame_header::IS_FINAL_FLAG |
+            frame_header::IS_EVENT_FLAG |
+            frame_header::BACKUP_EVENT_FLAG
+        ));
+        append(out, BACKUP_EVENT_TYPE);
+        append(out, m_backup_listener_id.load());
+        append(out, std::int32_t(-1));
+        append(out, source);
+    }
+
+    void append_partitions_view(std::uint64_t correlation_id, std::vector<char>& out)
+    {
+        // type, correlation id, partition id, version
+        append(out, std::int32_t(frame_header::HEADER_SIZE + 20));
+        append(out, std::uint16_t(frame_header::UNFRAGMENTED_MESSAGE | frame_header::IS_EVENT_FLAG));
+        append(out, PARTITIONS_VIEW_EVENT_TYPE);
+        append(out, correlation_id);
+        append(out, std::int32_t(-1));
+        // Every registration is answered with a later view.
+        append(out, ++m_cluster_views);
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, std::uint16_t(frame_header::BEGIN_DATA_STRUCTURE_FLAG));
+
+        const stand_in_member* partner = m_partner;
+
+        // The partition ids of each owner, in the order of their uuids.
+        for (std::int32_t first = 0; first < (partner ? 2 : 1); ++first)
+        {
+            std::int32_t step  = partner ? 2 : 1;
+            std::int32_t count = (m_partition_count - first + step - 1) / step;
+
+            append(out, std::int32_t(frame_header::HEADER_SIZE + count * sizeof(std::int32_t)));
+            append(out, std::uint16_t(0));
+
+            for (std::int32_t id = first; id < m_partition_count; id += step)
+                append(out, id);
+        }
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, std::uint16_t(frame_header::END_DATA_STRUCTURE_FLAG));
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE + (partner ? 2 : 1) * 17));
+        append(out, std::uint16_t(frame_header::IS_FINAL_FLAG));
+        append(out, std::uint8_t(0));
+        out.insert(end(out), std::begin(m_uuid.data), std::end(m_uuid.data));
+
+        if (partner)
+        {
+            append(out, std::uint8_t(0));
+            out.insert(end(out), std::begin(partner->m_uuid.data), std::end(partner->m_uuid.data));
+        }
+    }
+
+    // The group id of the default CP group: seed, id, name.
+    static void append_default_group(std::vector<char>& out)
+    {
+        static constexpr char name[] = "default";
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, std::uint16_t(frame_header::BEGIN_DATA_STRUCTURE_FLAG));
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE + 16));
+        append(out, std::uint16_t(0));
+        append(out, std::int64_t(1));
+        append(out, std::int64_t(0));
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE + sizeof(name) - 1));
+        append(out, std::uint16_t(0));
+        out.insert(end(out), name, name + sizeof(name) - 1);
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, std::uint16_t(frame_header::END_DATA_STRUCTURE_FLAG | frame_header::IS_FINAL_FLAG));
+    }
+
+    // Items of `count` sequences from `start` on, then a null list of
+    // sequences to end the message.
+    static void append_items(
+        std::int64_t first,
+        std::int32_t count,
+        std::int64_t step,
+        std::vector<char>& out
+    )
+    {
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, std::uint16_t(frame_header::BEGIN_DATA_STRUCTURE_FLAG));
+
+        for (std::int32_t i = 0; i < count; ++i)
+            append_integer(std::int32_t(first + i * step), 0, out);
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, std::uint16_t(frame_header::END_DATA_STRUCTURE_FLAG));
+
+        append(out, std::int32_t(frame_header::HEADER_SIZE));
+        append(out, std::uint16_t(frame_header::IS_NULL_FLAG | frame_header::IS_FINAL_FLAG));
+    }
+
+    template<typename T>
+    static T read(const std::vector<char>& x, std::size_t offset)
+    {
+        T value;
+
+        std::memcpy(&value, x.data() + offset, sizeof(T));
+
+        return boost::endian::little_to_native(value);
+    }
+
+    template<typename T>
+    static void append(std::vector<char>& x, T value)
+    {
+        boost::endian::native_to_little_inplace(value);
+
+        auto p = reinterpret_cast<const char*>(&value);
+
+        x.insert(end(x), p, p + sizeof(T));
+    }
+
+    boost::asio::io_context        m_ctx;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    std::int32_t                   m_partition_count;
+    std::size_t                    m_connections;
+    std::atomic<std::size_t>       m_accepted {0};
+    boost::uuids::uuid             m_uuid;
+    std::atomic<std::uint64_t>     m_requests {0};
+    std::atomic<std::int64_t>      m_next_flake_id {0};
+    std::atomic<std::int64_t>      m_pn_counter {0};
+    std::atomic<std::uint64_t>     m_pn_counter_adds {0};
+    std::atomic<std::size_t>       m_replica_timestamps_received {0};
+    std::atomic<std::int64_t>      m_atomic_long {0};
+    std::atomic<std::uint64_t>     m_backup_listener_id {0};
+    std::atomic<bool>              m_ack_backups {true};
+    std::atomic<stand_in_member*>  m_backup_member {nullptr};
+    std::atomic<const stand_in_member*> m_partner {nullptr};
+    std::atomic<std::int32_t>      m_drop_on {0};
+    std::atomic<bool>              m_answer_authentications {true};
+    std::atomic<std::int32_t>      m_cluster_views {0};
+    std::atomic<std::int64_t>      m_response_delay {0};
+    mutable std::mutex             m_mutex;
+    hz_client::message::data       m_last_predicate;
+    std::int32_t                   m_queue_head {0};
+    std::int32_t                   m_queue_tail {0};
+    std::mutex                     m_write_mutex;
+    boost::asio::ip::tcp::socket*  m_client_socket {nullptr};
+    std::thread                    m_thread;
+};